@@ -1,3 +1,4 @@
+#include <limits>
 #include "kaguya/kaguya.hpp"
 
 #include "benchmark_function.hpp"
@@ -87,14 +88,56 @@ int main()
 	
 	ADD_BENCHMARK(kaguyaapi::call_native_function);
 	ADD_BENCHMARK(plain_api::call_native_function);
+	ADD_BENCHMARK(kaguyaapi::call_vector_overloaded_function);
+	ADD_BENCHMARK(kaguyaapi::call_vector_overloaded_function_check_first);
+	ADD_BENCHMARK(kaguyaapi::call_vector_argument_function);
+	ADD_BENCHMARK(kaguyaapi::call_typed_array_argument_function);
+	ADD_BENCHMARK(kaguyaapi::build_string_packet);
+	ADD_BENCHMARK(kaguyaapi::build_byte_buffer_packet);
+	ADD_BENCHMARK(kaguyaapi::call_nothrow_native_function);
+	ADD_BENCHMARK(kaguyaapi::call_overloaded_function);
+	ADD_BENCHMARK(kaguyaapi::call_nothrow_overloaded_function);
+	ADD_BENCHMARK(kaguyaapi::pcall_argument_error);
+	ADD_BENCHMARK(kaguyaapi::pcall_deferred_argument_error);
 	ADD_BENCHMARK(kaguyaapi::call_lua_function);
 	ADD_BENCHMARK(plain_api::call_lua_function);
 	ADD_BENCHMARK(kaguyaapi::call_lua_function_operator_functional);
+	ADD_BENCHMARK(kaguyaapi::call_lua_function_prepared);
+	ADD_BENCHMARK(kaguyaapi::call_lua_function_each);
+	ADD_BENCHMARK(kaguyaapi::coroutine_new_thread_per_call);
+	ADD_BENCHMARK(kaguyaapi::coroutine_thread_pool_per_call);
+	ADD_BENCHMARK(kaguyaapi::scheduler_context_switch);
+	ADD_BENCHMARK(plain_api::coroutine_resume_yield);
+	ADD_BENCHMARK(kaguyaapi::scheduler_sleep_timers);
+	ADD_BENCHMARK(kaguyaapi::serializer_encode);
+	ADD_BENCHMARK(kaguyaapi::serializer_decode);
+	ADD_BENCHMARK(kaguyaapi::serializer_transfer);
+#if KAGUYA_USE_CPP11
+	ADD_BENCHMARK(kaguyaapi::worker_pool_1_thread);
+	ADD_BENCHMARK(kaguyaapi::worker_pool_2_threads);
+	ADD_BENCHMARK(kaguyaapi::worker_pool_4_threads);
+	ADD_BENCHMARK(kaguyaapi::worker_pool_8_threads);
+	ADD_BENCHMARK(kaguyaapi::worker_pool_16_threads);
+	ADD_BENCHMARK(kaguyaapi::worker_pool_32_threads);
+	ADD_BENCHMARK(kaguyaapi::worker_pool_64_threads);
+	ADD_BENCHMARK(kaguyaapi::mutex_queue_1_pair);
+	ADD_BENCHMARK(kaguyaapi::mutex_queue_4_pairs);
+	ADD_BENCHMARK(kaguyaapi::mutex_queue_16_pairs);
+	ADD_BENCHMARK(kaguyaapi::channel_1_pair);
+	ADD_BENCHMARK(kaguyaapi::channel_4_pairs);
+	ADD_BENCHMARK(kaguyaapi::channel_16_pairs);
+	ADD_BENCHMARK(kaguyaapi::channel_lua_send_recv);
+#endif
 	ADD_BENCHMARK(kaguyaapi::lua_table_access);
 	ADD_BENCHMARK(plain_api::lua_table_access);
 	ADD_BENCHMARK(kaguyaapi::lua_table_bracket_operator_access);
 	ADD_BENCHMARK(kaguyaapi::lua_table_bracket_operator_assign);
 	ADD_BENCHMARK(kaguyaapi::lua_table_bracket_operator_get);
+	ADD_BENCHMARK(kaguyaapi::lua_table_nested_bracket_operator_get);
+	ADD_BENCHMARK(kaguyaapi::lua_path_get);
+	ADD_BENCHMARK(kaguyaapi::lua_ref_create_copy_destroy);
+	ADD_BENCHMARK(kaguyaapi::lua_ref_create_in_main_thread);
+	ADD_BENCHMARK(kaguyaapi::lua_ref_create_in_coroutine);
 	ADD_BENCHMARK(kaguyaapi::lua_table_bracket_const_operator_get);
 
 	ADD_BENCHMARK(kaguyaapi::lua_allocation);
@@ -102,9 +145,28 @@ int main()
 
 	ADD_BENCHMARK(kaguyaapi::table_to_vector);
 	ADD_BENCHMARK(kaguyaapi::table_to_vector_with_typecheck);
+	ADD_BENCHMARK(kaguyaapi::table_to_vector_traits);
+	ADD_BENCHMARK(plain_api::table_to_vector);
+	ADD_BENCHMARK(kaguyaapi::table_to_vector_traits_100k);
+	ADD_BENCHMARK(plain_api::table_to_vector_100k);
+	ADD_BENCHMARK(kaguyaapi::table_foreach_iteration);
+	ADD_BENCHMARK(kaguyaapi::table_pairs_iteration);
+	ADD_BENCHMARK(plain_api::table_next_iteration);
 	
 
 	ADD_BENCHMARK(kaguyaapi::vector_to_table);	
+	ADD_BENCHMARK(kaguyaapi::return_nested_container_function);
+	ADD_BENCHMARK(kaguyaapi::table_to_map);
+	ADD_BENCHMARK(kaguyaapi::map_to_table);
+#if KAGUYA_USE_CPP11
+	ADD_BENCHMARK(kaguyaapi::table_to_unordered_map);
+	ADD_BENCHMARK(kaguyaapi::unordered_map_to_table);
+#endif
+
+	ADD_BENCHMARK(kaguyaapi::class_registration);
+	ADD_BENCHMARK(kaguyaapi::static_class_registration);
+	ADD_BENCHMARK(kaguyaapi::lazy_class_registration);
+	ADD_BENCHMARK(kaguyaapi::binding_set_class_registration);
 
 	execute_benchmark(functionmap);
 
@@ -1,7 +1,11 @@
 #include "kaguya/kaguya.hpp"
+#include "kaguya/scheduler.hpp"
+#include "kaguya/worker_pool.hpp"
+#include "kaguya/channel.hpp"
 
 #define KAGUYA_BENCHMARK_COUNT 1000000
 #define KAGUYA_BENCHMARK_COUNT_STR "1000000"
+#define KAGUYA_REGISTRATION_BENCHMARK_COUNT 10000
 
 namespace
 {
@@ -14,6 +18,10 @@ namespace
 	{
 		return std::atoi(arg.c_str());
 	}
+	bool test_ref_function(const kaguya::LuaRef& arg)
+	{
+		return !arg.isNilref();
+	}
 	class SetGet
 	{
 	public:
@@ -485,6 +493,210 @@ namespace kaguyaapi
 		);
 	}
 
+	int vector_float_function(const std::vector<float>& v)
+	{
+		return static_cast<int>(v.size());
+	}
+	int vector_string_function(const std::vector<std::string>& v)
+	{
+		return -static_cast<int>(v.size());
+	}
+	void call_vector_overloaded_function(kaguya::State& state)
+	{
+		state["nativefun"] = kaguya::overload(&vector_string_function, &vector_float_function);
+		state(
+			"local t = {}\n"
+			"for i=1,1000 do t[i]=i end\n"
+			"local times = " KAGUYA_BENCHMARK_COUNT_STR " / 1000\n"
+			"for i=1,times do\n"
+			"local r = nativefun(t)\n"
+			"if(r ~= 1000)then\n"
+			"error('error')\n"
+			"end\n"
+			"end\n"
+		);
+	}
+	void call_vector_overloaded_function_check_first(kaguya::State& state)
+	{
+		state.setTableTypeCheck(kaguya::TableTypeCheck::CHECK_FIRST, 16);
+		call_vector_overloaded_function(state);
+	}
+
+	float vector_sum_function(const std::vector<float>& v)
+	{
+		float result = 0;
+		for (size_t i = 0; i < v.size(); ++i) { result += v[i]; }
+		return result;
+	}
+	float span_sum_function(kaguya::span<float> v)
+	{
+		float result = 0;
+		for (size_t i = 0; i < v.size(); ++i) { result += v[i]; }
+		return result;
+	}
+	void call_vector_argument_function(kaguya::State& state)
+	{
+		state["nativefun"] = &vector_sum_function;
+		state(
+			"local t = {}\n"
+			"for i=1,1000 do t[i]=1 end\n"
+			"local times = " KAGUYA_BENCHMARK_COUNT_STR " / 1000\n"
+			"for i=1,times do\n"
+			"local r = nativefun(t)\n"
+			"if(r ~= 1000)then\n"
+			"error('error')\n"
+			"end\n"
+			"end\n"
+		);
+	}
+	void call_typed_array_argument_function(kaguya::State& state)
+	{
+		state["nativefun"] = &span_sum_function;
+		state["FloatArray"] = kaguya::luacfunction(&kaguya::TypedArray<float>::create);
+		state(
+			"local t = FloatArray(1000):fill(1)\n"
+			"local times = " KAGUYA_BENCHMARK_COUNT_STR " / 1000\n"
+			"for i=1,times do\n"
+			"local r = nativefun(t)\n"
+			"if(r ~= 1000)then\n"
+			"error('error')\n"
+			"end\n"
+			"end\n"
+		);
+	}
+
+	size_t packet_size_function(const std::string& packet)
+	{
+		return packet.size();
+	}
+	size_t packet_bytes_function(kaguya::span<const unsigned char> packet)
+	{
+		return packet.size();
+	}
+	void build_string_packet(kaguya::State& state)
+	{
+		state["nativefun"] = &packet_size_function;
+		state(
+			"local char, floor, concat = string.char, math.floor, table.concat\n"
+			"local times = " KAGUYA_BENCHMARK_COUNT_STR " / 10000\n"
+			"for i=1,times do\n"
+			"local parts = {}\n"
+			"for v=1,16384 do\n"
+			"parts[v] = char(floor(v / 16777216) % 256, floor(v / 65536) % 256, floor(v / 256) % 256, v % 256)\n"
+			"end\n"
+			"if(nativefun(concat(parts)) ~= 65536)then\n"
+			"error('error')\n"
+			"end\n"
+			"end\n"
+		);
+	}
+	void build_byte_buffer_packet(kaguya::State& state)
+	{
+		state["nativefun"] = &packet_bytes_function;
+		state["ByteBuffer"] = kaguya::luacfunction(&kaguya::ByteBuffer::create);
+		state(
+			"local b = ByteBuffer(65536)\n"
+			"local times = " KAGUYA_BENCHMARK_COUNT_STR " / 10000\n"
+			"for i=1,times do\n"
+			"b:clear()\n"
+			"for v=1,16384 do\n"
+			"b:writeU32BE(v)\n"
+			"end\n"
+			"if(nativefun(b) ~= 65536)then\n"
+			"error('error')\n"
+			"end\n"
+			"end\n"
+		);
+	}
+
+	void call_nothrow_native_function(kaguya::State& state)
+	{
+		state["nativefun"] = kaguya::nothrow_function(&test_native_function);
+		state(
+			"local times = " KAGUYA_BENCHMARK_COUNT_STR "\n"
+			"for i=1,times do\n"
+			"local r = nativefun(i)\n"
+			"if(r ~= i)then\n"
+			"error('error')\n"
+			"end\n"
+			"end\n"
+		);
+	}
+
+	void call_nothrow_overloaded_function(kaguya::State& state)
+	{
+		state["nativefun"] = kaguya::nothrow_overload(&test_native_function2,&test_native_function);
+		state(
+			"local times = " KAGUYA_BENCHMARK_COUNT_STR "\n"
+			"for i=1,times do\n"
+			"local r = nativefun(i)\n"
+			"if(r ~= i)then\n"
+			"error('error')\n"
+			"end\n"
+			"end\n"
+		);
+	}
+
+	void pcall_argument_error(kaguya::State& state)
+	{
+		state["nativefun"] = kaguya::overload(&test_native_function2,&test_native_function);
+		state(
+			"local times = 100000\n"
+			"for i=1,times do\n"
+			"local ok = pcall(nativefun,{})\n"
+			"if(ok)then\n"
+			"error('error')\n"
+			"end\n"
+			"end\n"
+		);
+	}
+
+	void pcall_deferred_argument_error(kaguya::State& state)
+	{
+		state.setDeferredArgumentError(true);
+		pcall_argument_error(state);
+	}
+
+	void lua_ref_create_copy_destroy(kaguya::State& state)
+	{
+		state("value={}");
+		std::vector<kaguya::LuaRef> refs;
+		refs.reserve(64);
+		for (int i = 0; i < KAGUYA_BENCHMARK_COUNT / 64; i++)
+		{
+			kaguya::LuaRef value = state["value"];
+			for (int j = 0; j < 64; j++)
+			{
+				refs.push_back(value);
+			}
+			refs.clear();
+		}
+	}
+
+	void lua_ref_create_in_main_thread(kaguya::State& state)
+	{
+		state["reffun"] = &test_ref_function;
+		state(
+			"local times = " KAGUYA_BENCHMARK_COUNT_STR "\n"
+			"for i=1,times do\n"
+			"if not reffun(i) then error('error') end\n"
+			"end\n"
+		);
+	}
+
+	void lua_ref_create_in_coroutine(kaguya::State& state)
+	{
+		state["reffun"] = &test_ref_function;
+		state(
+			"local times = " KAGUYA_BENCHMARK_COUNT_STR "\n"
+			"coroutine.wrap(function()\n"
+			"for i=1,times do\n"
+			"if not reffun(i) then error('error') end\n"
+			"end\n"
+			"end)()\n"
+		);
+	}
+
 	void call_lua_function(kaguya::State& state)
 	{
 		state("lua_function=function(i)return i;end");
@@ -507,6 +719,140 @@ namespace kaguyaapi
 			if (r != i) { throw std::logic_error(""); }
 		}
 	}
+	void call_lua_function_prepared(kaguya::State& state)
+	{
+		state("lua_function=function(i)return i;end");
+
+		kaguya::PreparedCall<int(int)> lua_function = state["lua_function"];
+		for (int i = 0; i < KAGUYA_BENCHMARK_COUNT; i++)
+		{
+			int r = lua_function(i);
+			if (r != i) { throw std::logic_error(""); }
+		}
+	}
+	void call_lua_function_each(kaguya::State& state)
+	{
+		state("lua_function=function(i)return i;end");
+
+		kaguya::LuaFunction lua_function = state["lua_function"];
+		std::vector<int> args(KAGUYA_BENCHMARK_COUNT);
+		for (int i = 0; i < KAGUYA_BENCHMARK_COUNT; i++)
+		{
+			args[i] = i;
+		}
+		std::vector<int> results(KAGUYA_BENCHMARK_COUNT);
+		lua_function.callEach<int>(args.begin(), args.end(), results.begin());
+		if (results != args) { throw std::logic_error(""); }
+	}
+	void coroutine_new_thread_per_call(kaguya::State& state)
+	{
+		state("lua_function=function(i)return i;end");
+
+		kaguya::LuaFunction lua_function = state["lua_function"];
+		for (int i = 0; i < KAGUYA_BENCHMARK_COUNT; i++)
+		{
+			kaguya::LuaThread cor = state.newThread(lua_function);
+			int r = cor.resume<int>(i);
+			if (r != i) { throw std::logic_error(""); }
+		}
+	}
+	void coroutine_thread_pool_per_call(kaguya::State& state)
+	{
+		state("lua_function=function(i)return i;end");
+
+		kaguya::LuaFunction lua_function = state["lua_function"];
+		kaguya::ThreadPool pool(state.state());
+		for (int i = 0; i < KAGUYA_BENCHMARK_COUNT; i++)
+		{
+			kaguya::LuaThread cor = pool.acquire(lua_function);
+			int r = cor.resume<int>(i);
+			if (r != i) { throw std::logic_error(""); }
+			pool.release(cor);
+		}
+		if (pool.createdCount() != 1) { throw std::logic_error(""); }
+	}
+	void scheduler_context_switch(kaguya::State& state)
+	{
+		kaguya::Scheduler scheduler(state.state());
+		state["task"] = kaguya::NewTable();
+		scheduler.openLibrary(state["task"]);
+		state("switches = 0 "
+			"function worker(n) for i = 1, n do switches = switches + 1 task.yield() end end");
+
+		const int tasks = 1000;
+		for (int i = 0; i < tasks; i++)
+		{
+			scheduler.spawn(state["worker"], KAGUYA_BENCHMARK_COUNT / tasks);
+		}
+		while (!scheduler.empty())
+		{
+			scheduler.tick(0);
+		}
+		if (state["switches"] != KAGUYA_BENCHMARK_COUNT) { throw std::logic_error(""); }
+	}
+	void scheduler_sleep_timers(kaguya::State& state)
+	{
+		kaguya::Scheduler scheduler(state.state());
+		state["task"] = kaguya::NewTable();
+		scheduler.openLibrary(state["task"]);
+		state("wakes = 0 "
+			"function sleeper(ms) for i = 1, 10 do task.sleep(ms) wakes = wakes + 1 end end");
+
+		const int tasks = 100000;
+		for (int i = 0; i < tasks; i++)
+		{
+			scheduler.spawn(state["sleeper"], 1 + i % 97);
+		}
+		double now = 0;
+		while (!scheduler.empty())
+		{
+			scheduler.tick(now);
+			now += 1;
+		}
+		if (state["wakes"] != tasks * 10) { throw std::logic_error(""); }
+	}
+
+	// about 90KB message of records. encoded KAGUYA_BENCHMARK_COUNT / 1000 times
+	const char* serializer_payload =
+		"payload = {} "
+		"for i = 1, 1000 do payload[i] = {id = i, name = 'record' .. i, "
+		"score = i * 0.25, tags = {'red', 'green', 'blue'}, active = i % 2 == 0} end";
+	void serializer_encode(kaguya::State& state)
+	{
+		state(serializer_payload);
+		kaguya::LuaRef payload = state["payload"];
+		payload.push();
+		std::string buffer;
+		for (int i = 0; i < KAGUYA_BENCHMARK_COUNT / 1000; i++)
+		{
+			buffer.clear();
+			if (!kaguya::Serializer::encode(state.state(), -1, buffer)) { throw std::logic_error(""); }
+		}
+		lua_pop(state.state(), 1);
+	}
+	void serializer_decode(kaguya::State& state)
+	{
+		state(serializer_payload);
+		std::string buffer = kaguya::serialize(state["payload"]);
+		for (int i = 0; i < KAGUYA_BENCHMARK_COUNT / 1000; i++)
+		{
+			if (!kaguya::Serializer::decode(state.state(), buffer.data(), buffer.size())) { throw std::logic_error(""); }
+			lua_pop(state.state(), 1);
+		}
+	}
+	// encode in state and decode in another state, as messages between workers
+	void serializer_transfer(kaguya::State& state)
+	{
+		state(serializer_payload);
+		kaguya::State other;
+		kaguya::LuaRef payload = state["payload"];
+		for (int i = 0; i < KAGUYA_BENCHMARK_COUNT / 1000; i++)
+		{
+			kaguya::SerializedValue message = payload;
+			other["payload"] = message;
+		}
+		if (other["payload"][1000]["name"] != "record1000") { throw std::logic_error(""); }
+	}
 	
 	void lua_table_access(kaguya::State& state)
 	{
@@ -554,6 +900,27 @@ namespace kaguyaapi
 		}
 	}
 
+	void lua_table_nested_bracket_operator_get(kaguya::State& state)
+	{
+		state("config={net={timeout=0}}");
+		for (int i = 0; i < KAGUYA_BENCHMARK_COUNT; i++)
+		{
+			int v = state["config"]["net"]["timeout"];
+			if (v != 0) { throw std::logic_error(""); }
+		}
+	}
+
+	void lua_path_get(kaguya::State& state)
+	{
+		state("config={net={timeout=0}}");
+		kaguya::LuaPath timeout(state.globalTable(), "config.net.timeout");
+		for (int i = 0; i < KAGUYA_BENCHMARK_COUNT; i++)
+		{
+			int v = timeout.get<int>();
+			if (v != 0) { throw std::logic_error(""); }
+		}
+	}
+
 	void lua_table_bracket_const_operator_get(kaguya::State& state)
 	{
 		state("lua_table={value=0}");
@@ -592,6 +959,100 @@ namespace kaguyaapi
 			"end\n"
 			"");
 	}
+	void class_registration(kaguya::State&)
+	{
+		for (int i = 0; i < KAGUYA_REGISTRATION_BENCHMARK_COUNT; i++)
+		{
+			kaguya::State state(kaguya::NoLoadLib());
+			state["SetGet"].setClass(kaguya::UserdataMetatable<SetGet>()
+				.setConstructors<SetGet()>()
+				.addFunction("set", &SetGet::set)
+				.addFunction("setstr", &SetGet::setstr)
+				.addFunction("get", &SetGet::get)
+				.addProperty("a", &SetGet::a)
+			);
+			state["Vector3"].setClass(kaguya::UserdataMetatable<Vector3>()
+				.setConstructors<Vector3()>()
+				.addProperty("x", &Vector3::x)
+				.addProperty("y", &Vector3::y)
+				.addProperty("z", &Vector3::z)
+			);
+			state["ObjGetSet"].setClass(kaguya::UserdataMetatable<ObjGetSet>()
+				.setConstructors<ObjGetSet()>()
+				.addFunction("set", &ObjGetSet::set)
+				.addFunction("get", &ObjGetSet::get)
+				.addProperty("position", &ObjGetSet::position)
+			);
+		}
+	}
+
+	const kaguya::ClassMemberDescriptor setget_members[] = {
+		{ "new", &kaguya::static_constructor<SetGet()>::invoke, kaguya::CLASS_MEMBER_FUNCTION },
+		{ "set", KAGUYA_STATIC_FUNCTION(&SetGet::set), kaguya::CLASS_MEMBER_FUNCTION },
+		{ "setstr", KAGUYA_STATIC_FUNCTION(&SetGet::setstr), kaguya::CLASS_MEMBER_FUNCTION },
+		{ "get", KAGUYA_STATIC_FUNCTION(&SetGet::get), kaguya::CLASS_MEMBER_FUNCTION },
+		{ "a", KAGUYA_STATIC_FUNCTION(&SetGet::a), kaguya::CLASS_MEMBER_PROPERTY },
+	};
+	const kaguya::ClassMemberDescriptor vector3_members[] = {
+		{ "new", &kaguya::static_constructor<Vector3()>::invoke, kaguya::CLASS_MEMBER_FUNCTION },
+		{ "x", KAGUYA_STATIC_FUNCTION(&Vector3::x), kaguya::CLASS_MEMBER_PROPERTY },
+		{ "y", KAGUYA_STATIC_FUNCTION(&Vector3::y), kaguya::CLASS_MEMBER_PROPERTY },
+		{ "z", KAGUYA_STATIC_FUNCTION(&Vector3::z), kaguya::CLASS_MEMBER_PROPERTY },
+	};
+	const kaguya::ClassMemberDescriptor objgetset_members[] = {
+		{ "new", &kaguya::static_constructor<ObjGetSet()>::invoke, kaguya::CLASS_MEMBER_FUNCTION },
+		{ "set", KAGUYA_STATIC_FUNCTION(&ObjGetSet::set), kaguya::CLASS_MEMBER_FUNCTION },
+		{ "get", KAGUYA_STATIC_FUNCTION(&ObjGetSet::get), kaguya::CLASS_MEMBER_FUNCTION },
+		{ "position", KAGUYA_STATIC_FUNCTION(&ObjGetSet::position), kaguya::CLASS_MEMBER_PROPERTY },
+	};
+	void static_class_registration(kaguya::State&)
+	{
+		for (int i = 0; i < KAGUYA_REGISTRATION_BENCHMARK_COUNT; i++)
+		{
+			kaguya::State state(kaguya::NoLoadLib());
+			state["SetGet"].setClass(kaguya::StaticUserdataMetatable<SetGet>(setget_members));
+			state["Vector3"].setClass(kaguya::StaticUserdataMetatable<Vector3>(vector3_members));
+			state["ObjGetSet"].setClass(kaguya::StaticUserdataMetatable<ObjGetSet>(objgetset_members));
+		}
+	}
+
+	void lazy_class_registration(kaguya::State&)
+	{
+		for (int i = 0; i < KAGUYA_REGISTRATION_BENCHMARK_COUNT; i++)
+		{
+			kaguya::State state(kaguya::NoLoadLib());
+			state["SetGet"].setLazyClass(kaguya::StaticUserdataMetatable<SetGet>(setget_members));
+			state["Vector3"].setLazyClass(kaguya::StaticUserdataMetatable<Vector3>(vector3_members));
+			state["ObjGetSet"].setLazyClass(kaguya::StaticUserdataMetatable<ObjGetSet>(objgetset_members));
+		}
+	}
+
+	void binding_set_class_registration(kaguya::State&)
+	{
+		static const kaguya::BindingSet bindings = kaguya::BindingSet()
+			.addClass("SetGet", kaguya::UserdataMetatable<SetGet>()
+				.setConstructors<SetGet()>()
+				.addFunction("set", &SetGet::set)
+				.addFunction("setstr", &SetGet::setstr)
+				.addFunction("get", &SetGet::get)
+				.addProperty("a", &SetGet::a))
+			.addClass("Vector3", kaguya::UserdataMetatable<Vector3>()
+				.setConstructors<Vector3()>()
+				.addProperty("x", &Vector3::x)
+				.addProperty("y", &Vector3::y)
+				.addProperty("z", &Vector3::z))
+			.addClass("ObjGetSet", kaguya::UserdataMetatable<ObjGetSet>()
+				.setConstructors<ObjGetSet()>()
+				.addFunction("set", &ObjGetSet::set)
+				.addFunction("get", &ObjGetSet::get)
+				.addProperty("position", &ObjGetSet::position));
+		for (int i = 0; i < KAGUYA_REGISTRATION_BENCHMARK_COUNT; i++)
+		{
+			kaguya::State state(kaguya::NoLoadLib());
+			bindings.install(state.state());
+		}
+	}
+
 	void lua_allocation(kaguya::State& state)
 	{
 		state("lua_table = { } "
@@ -621,6 +1082,58 @@ namespace kaguyaapi
 			std::vector<double> r = lua_table.values<double>();
 		}
 	}
+	void table_to_vector_traits(kaguya::State& state)
+	{
+		state("lua_table={4,2,3,4,4,23,32,34,23,34,4,245,235,432,6,7,76,37,64,5}");
+		kaguya::LuaRef lua_table = state["lua_table"];
+		for (int i = 0; i < KAGUYA_BENCHMARK_COUNT; i++)
+		{
+			std::vector<double> r = lua_table.get<std::vector<double> >();
+		}
+	}
+	void table_to_vector_traits_100k(kaguya::State& state)
+	{
+		state("lua_table={} for i=1,100000 do lua_table[i]=i end");
+		kaguya::LuaRef lua_table = state["lua_table"];
+		for (int i = 0; i < KAGUYA_BENCHMARK_COUNT / 10000; i++)
+		{
+			std::vector<double> r = lua_table.get<std::vector<double> >();
+		}
+	}
+	struct sum_table_functor
+	{
+		double& sum;
+		sum_table_functor(double& s) :sum(s) {}
+		void operator()(int k, int v) { sum += k + v; }
+	};
+	void table_foreach_iteration(kaguya::State& state)
+	{
+		state("lua_table={} for i=1," KAGUYA_BENCHMARK_COUNT_STR " do lua_table[i]=i end");
+		kaguya::LuaTable lua_table = state["lua_table"];
+		for (int n = 0; n < 5; n++)
+		{
+			double sum = 0;
+			lua_table.foreach_table<int, int>(sum_table_functor(sum));
+			if (sum != 2.0 * KAGUYA_BENCHMARK_COUNT * (KAGUYA_BENCHMARK_COUNT + 1) / 2) { throw std::logic_error("error"); }
+		}
+	}
+	void table_pairs_iteration(kaguya::State& state)
+	{
+		state("lua_table={} for i=1," KAGUYA_BENCHMARK_COUNT_STR " do lua_table[i]=i end");
+		kaguya::LuaTable lua_table = state["lua_table"];
+		typedef kaguya::TablePairs<int, int> range_type;
+		for (int n = 0; n < 5; n++)
+		{
+			double sum = 0;
+			range_type range = lua_table.pairs<int, int>();
+			for (range_type::iterator it = range.begin(); it != range.end(); ++it)
+			{
+				range_type::value_type kv = *it;
+				sum += kv.first + kv.second;
+			}
+			if (sum != 2.0 * KAGUYA_BENCHMARK_COUNT * (KAGUYA_BENCHMARK_COUNT + 1) / 2) { throw std::logic_error("error"); }
+		}
+	}
 	void vector_to_table(kaguya::State& state)
 	{
 		std::vector<double> v;
@@ -634,6 +1147,188 @@ namespace kaguyaapi
 			state.popFromStack();
 		}
 	}
+	struct Record
+	{
+		Record() :samples(64, 1.0) {}
+		std::vector<double> samples;
+	};
+	std::map<std::string, std::vector<Record> > nested_container_function()
+	{
+		std::map<std::string, std::vector<Record> > result;
+		for (int i = 0; i < 10; i++)
+		{
+			result[std::string("key") + char('a' + i)] = std::vector<Record>(10);
+		}
+		return result;
+	}
+	void return_nested_container_function(kaguya::State& state)
+	{
+		state["Record"].setClass(kaguya::UserdataMetatable<Record>());
+		state["nativefun"] = &nested_container_function;
+		state(
+			"local times = " KAGUYA_BENCHMARK_COUNT_STR " / 100\n"
+			"for i=1,times do\n"
+			"local r = nativefun()\n"
+			"if(#r.keyj ~= 10)then\n"
+			"error('error')\n"
+			"end\n"
+			"end\n"
+		);
+	}
+	void table_to_map(kaguya::State& state)
+	{
+		state("lua_table={} for i=1,20 do lua_table['key'..i]=i end");
+		kaguya::LuaRef lua_table = state["lua_table"];
+		for (int i = 0; i < KAGUYA_BENCHMARK_COUNT / 10; i++)
+		{
+			std::map<std::string, int> r = lua_table.get<std::map<std::string, int> >();
+		}
+	}
+	void map_to_table(kaguya::State& state)
+	{
+		std::map<std::string, int> m;
+		for (int i = 0; i < 20; i++)
+		{
+			m[std::string("key") + char('a' + i)] = i;
+		}
+		for (int i = 0; i < KAGUYA_BENCHMARK_COUNT / 10; i++)
+		{
+			state.pushToStack(m);
+			state.popFromStack();
+		}
+	}
+#if KAGUYA_USE_CPP11
+	void table_to_unordered_map(kaguya::State& state)
+	{
+		state("lua_table={} for i=1,20 do lua_table['key'..i]=i end");
+		kaguya::LuaRef lua_table = state["lua_table"];
+		for (int i = 0; i < KAGUYA_BENCHMARK_COUNT / 10; i++)
+		{
+			std::unordered_map<std::string, int> r = lua_table.get<std::unordered_map<std::string, int> >();
+		}
+	}
+	void unordered_map_to_table(kaguya::State& state)
+	{
+		std::unordered_map<std::string, int> m;
+		for (int i = 0; i < 20; i++)
+		{
+			m[std::string("key") + char('a' + i)] = i;
+		}
+		for (int i = 0; i < KAGUYA_BENCHMARK_COUNT / 10; i++)
+		{
+			state.pushToStack(m);
+			state.popFromStack();
+		}
+	}
+
+	void setup_worker_pool_state(kaguya::State& state)
+	{
+		state("function work(n) local x = 0 for i = 1, n do x = x + i end return x end");
+	}
+	// same total work for any number of threads
+	void run_worker_pool_jobs(size_t threads)
+	{
+		kaguya::WorkerPool pool(threads, &setup_worker_pool_state);
+		const int jobs = KAGUYA_BENCHMARK_COUNT / 100;
+		std::vector<std::future<int> > results;
+		results.reserve(jobs);
+		for (int i = 0; i < jobs; i++)
+		{
+			results.push_back(pool.submit<int>("work", 1000));
+		}
+		for (int i = 0; i < jobs; i++)
+		{
+			if (results[i].get() != 500500) { throw std::logic_error(""); }
+		}
+	}
+	void worker_pool_1_thread(kaguya::State&) { run_worker_pool_jobs(1); }
+	void worker_pool_2_threads(kaguya::State&) { run_worker_pool_jobs(2); }
+	void worker_pool_4_threads(kaguya::State&) { run_worker_pool_jobs(4); }
+	void worker_pool_8_threads(kaguya::State&) { run_worker_pool_jobs(8); }
+	void worker_pool_16_threads(kaguya::State&) { run_worker_pool_jobs(16); }
+	void worker_pool_32_threads(kaguya::State&) { run_worker_pool_jobs(32); }
+	void worker_pool_64_threads(kaguya::State&) { run_worker_pool_jobs(64); }
+
+	// bounded mutex and condition variable queue, as baseline of kaguya::BasicChannel
+	class locked_int_queue
+	{
+	public:
+		explicit locked_int_queue(size_t capacity) : capacity_(capacity), closed_(false) {}
+		bool send(int value)
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			not_full_.wait(lock, [this] { return closed_ || queue_.size() < capacity_; });
+			if (closed_) { return false; }
+			queue_.push_back(value);
+			not_empty_.notify_one();
+			return true;
+		}
+		bool recv(int& value)
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			not_empty_.wait(lock, [this] { return closed_ || !queue_.empty(); });
+			if (queue_.empty()) { return false; }
+			value = queue_.front();
+			queue_.pop_front();
+			not_full_.notify_one();
+			return true;
+		}
+		void close()
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			closed_ = true;
+			not_empty_.notify_all();
+			not_full_.notify_all();
+		}
+	private:
+		size_t capacity_;
+		bool closed_;
+		std::deque<int> queue_;
+		std::mutex mutex_;
+		std::condition_variable not_empty_;
+		std::condition_variable not_full_;
+	};
+	// same number of messages for any number of producer and consumer pairs
+	template<class Queue>
+	void run_int_channel(int pairs)
+	{
+		Queue queue(1024);
+		const int messages = KAGUYA_BENCHMARK_COUNT / pairs;
+		std::atomic<long long> sum(0);
+		std::vector<std::thread> producers;
+		std::vector<std::thread> consumers;
+		for (int i = 0; i < pairs; i++)
+		{
+			producers.push_back(std::thread([&queue, messages] {
+				for (int v = 1; v <= messages; v++) { queue.send(v); }
+			}));
+			consumers.push_back(std::thread([&queue, &sum] {
+				long long local = 0;
+				int v;
+				while (queue.recv(v)) { local += v; }
+				sum += local;
+			}));
+		}
+		for (size_t i = 0; i < producers.size(); i++) { producers[i].join(); }
+		queue.close();
+		for (size_t i = 0; i < consumers.size(); i++) { consumers[i].join(); }
+		if (sum != 1LL * pairs * messages * (messages + 1) / 2) { throw std::logic_error(""); }
+	}
+	void mutex_queue_1_pair(kaguya::State&) { run_int_channel<locked_int_queue>(1); }
+	void mutex_queue_4_pairs(kaguya::State&) { run_int_channel<locked_int_queue>(4); }
+	void mutex_queue_16_pairs(kaguya::State&) { run_int_channel<locked_int_queue>(16); }
+	void channel_1_pair(kaguya::State&) { run_int_channel<kaguya::BasicChannel<int> >(1); }
+	void channel_4_pairs(kaguya::State&) { run_int_channel<kaguya::BasicChannel<int> >(4); }
+	void channel_16_pairs(kaguya::State&) { run_int_channel<kaguya::BasicChannel<int> >(16); }
+	void channel_lua_send_recv(kaguya::State& state)
+	{
+		state["Channel"].setClass(kaguya::Channel::metatable());
+		state["ch"] = kaguya::Channel(16);
+		state("for i = 1, " KAGUYA_BENCHMARK_COUNT_STR " do "
+			"ch:send(i) "
+			"if ch:try_recv() ~= i then error('') end end");
+	}
+#endif
 }
 
 
@@ -780,6 +1475,85 @@ namespace plain_api
 		luaL_unref(s, LUA_REGISTRYINDEX, table_ref);
 		lua_close(s);
 	}
+	void table_to_vector_impl(const char* script, int count)
+	{
+		lua_State* s = luaL_newstate();
+		luaL_openlibs(s);
+		luaL_dostring(s, script);
+
+		lua_getglobal(s, "lua_table");
+		int table_ref = luaL_ref(s, LUA_REGISTRYINDEX);//get lua_table reference
+		for (int i = 0; i < count; i++)
+		{
+			lua_rawgeti(s, LUA_REGISTRYINDEX, table_ref);
+#if LUA_VERSION_NUM < 502
+			size_t size = lua_objlen(s, -1);
+#else
+			size_t size = lua_rawlen(s, -1);
+#endif
+			std::vector<double> r;
+			r.reserve(size);
+			for (size_t n = 1; n <= size; ++n)
+			{
+				lua_rawgeti(s, -1, static_cast<int>(n));
+				r.push_back(lua_tonumber(s, -1));
+				lua_pop(s, 1);
+			}
+			lua_settop(s, 0);
+		}
+		luaL_unref(s, LUA_REGISTRYINDEX, table_ref);
+		lua_close(s);
+	}
+	void table_to_vector(kaguya::State& )
+	{
+		table_to_vector_impl("lua_table={4,2,3,4,4,23,32,34,23,34,4,245,235,432,6,7,76,37,64,5}", KAGUYA_BENCHMARK_COUNT);
+	}
+	void table_to_vector_100k(kaguya::State& )
+	{
+		table_to_vector_impl("lua_table={} for i=1,100000 do lua_table[i]=i end", KAGUYA_BENCHMARK_COUNT / 10000);
+	}
+	void table_next_iteration(kaguya::State& )
+	{
+		lua_State* s = luaL_newstate();
+		luaL_openlibs(s);
+		luaL_dostring(s, "lua_table={} for i=1," KAGUYA_BENCHMARK_COUNT_STR " do lua_table[i]=i end");
+
+		lua_getglobal(s, "lua_table");
+		int table_ref = luaL_ref(s, LUA_REGISTRYINDEX);//get lua_table reference
+		for (int n = 0; n < 5; n++)
+		{
+			double sum = 0;
+			lua_rawgeti(s, LUA_REGISTRYINDEX, table_ref);
+			lua_pushnil(s);
+			while (lua_next(s, -2) != 0)
+			{
+				sum += lua_tointeger(s, -2) + lua_tointeger(s, -1);
+				lua_pop(s, 1);
+			}
+			lua_settop(s, 0);
+			if (sum != 2.0 * KAGUYA_BENCHMARK_COUNT * (KAGUYA_BENCHMARK_COUNT + 1) / 2) { throw std::logic_error("error"); }
+		}
+		luaL_unref(s, LUA_REGISTRYINDEX, table_ref);
+		lua_close(s);
+	}
+	void coroutine_resume_yield(kaguya::State& )
+	{
+		lua_State* s = luaL_newstate();
+		luaL_openlibs(s);
+		luaL_dostring(s, "function worker() while true do coroutine.yield() end end");
+		lua_State* co = lua_newthread(s);
+		lua_getglobal(co, "worker");
+		for (int i = 0; i < KAGUYA_BENCHMARK_COUNT; i++)
+		{
+#if LUA_VERSION_NUM >= 502
+			int status = lua_resume(co, s, 0);
+#else
+			int status = lua_resume(co, 0);
+#endif
+			if (status != LUA_YIELD) { throw std::logic_error(""); }
+		}
+		lua_close(s);
+	}
 	void lua_allocation(kaguya::State& )
 	{
 		lua_State* s = luaL_newstate();
@@ -26,20 +26,74 @@ namespace kaguyaapi
 	
 	void call_native_function(kaguya::State& state);
 	void call_overloaded_function(kaguya::State& state);
+	void call_vector_overloaded_function(kaguya::State& state);
+	void call_vector_overloaded_function_check_first(kaguya::State& state);
+	void call_vector_argument_function(kaguya::State& state);
+	void call_typed_array_argument_function(kaguya::State& state);
+	void build_string_packet(kaguya::State& state);
+	void build_byte_buffer_packet(kaguya::State& state);
+	void call_nothrow_native_function(kaguya::State& state);
+	void call_nothrow_overloaded_function(kaguya::State& state);
+	void pcall_argument_error(kaguya::State& state);
+	void pcall_deferred_argument_error(kaguya::State& state);
+	void lua_ref_create_copy_destroy(kaguya::State& state);
+	void lua_ref_create_in_main_thread(kaguya::State& state);
+	void lua_ref_create_in_coroutine(kaguya::State& state);
 
 	void call_lua_function(kaguya::State& state);
 	void call_lua_function_operator_functional(kaguya::State& state);
+	void call_lua_function_prepared(kaguya::State& state);
+	void call_lua_function_each(kaguya::State& state);
+	void coroutine_new_thread_per_call(kaguya::State& state);
+	void coroutine_thread_pool_per_call(kaguya::State& state);
+	void scheduler_context_switch(kaguya::State& state);
+	void scheduler_sleep_timers(kaguya::State& state);
+	void serializer_encode(kaguya::State& state);
+	void serializer_decode(kaguya::State& state);
+	void serializer_transfer(kaguya::State& state);
+#if KAGUYA_USE_CPP11
+	void worker_pool_1_thread(kaguya::State& state);
+	void worker_pool_2_threads(kaguya::State& state);
+	void worker_pool_4_threads(kaguya::State& state);
+	void worker_pool_8_threads(kaguya::State& state);
+	void worker_pool_16_threads(kaguya::State& state);
+	void worker_pool_32_threads(kaguya::State& state);
+	void worker_pool_64_threads(kaguya::State& state);
+	void mutex_queue_1_pair(kaguya::State& state);
+	void mutex_queue_4_pairs(kaguya::State& state);
+	void mutex_queue_16_pairs(kaguya::State& state);
+	void channel_1_pair(kaguya::State& state);
+	void channel_4_pairs(kaguya::State& state);
+	void channel_16_pairs(kaguya::State& state);
+	void channel_lua_send_recv(kaguya::State& state);
+#endif
 	void lua_table_access(kaguya::State& state);
 	void lua_table_bracket_operator_access(kaguya::State& state);
 	void lua_table_bracket_operator_assign(kaguya::State& state);
 	void lua_table_bracket_operator_get(kaguya::State& state);
+	void lua_table_nested_bracket_operator_get(kaguya::State& state);
+	void lua_path_get(kaguya::State& state);
 	void lua_table_bracket_const_operator_get(kaguya::State& state);
 	
 	void property_access(kaguya::State& state);
 
 	void table_to_vector(kaguya::State& state);
 	void table_to_vector_with_typecheck(kaguya::State& state);
+	void table_to_vector_traits(kaguya::State& state);
+	void table_to_vector_traits_100k(kaguya::State& state);
+	void table_foreach_iteration(kaguya::State& state);
+	void table_pairs_iteration(kaguya::State& state);
 	void vector_to_table(kaguya::State& state);
+	void return_nested_container_function(kaguya::State& state);
+	void table_to_map(kaguya::State& state);
+	void map_to_table(kaguya::State& state);
+	void table_to_unordered_map(kaguya::State& state);
+	void unordered_map_to_table(kaguya::State& state);
+
+	void class_registration(kaguya::State& state);
+	void static_class_registration(kaguya::State& state);
+	void lazy_class_registration(kaguya::State& state);
+	void binding_set_class_registration(kaguya::State& state);
 	
 
 	void lua_allocation(kaguya::State& state);
@@ -53,4 +107,8 @@ namespace plain_api
 	void call_lua_function(kaguya::State& state);
 	void lua_table_access(kaguya::State& state);
 	void lua_allocation(kaguya::State& state);
+	void table_to_vector(kaguya::State& state);
+	void table_to_vector_100k(kaguya::State& state);
+	void table_next_iteration(kaguya::State& state);
+	void coroutine_resume_yield(kaguya::State& state);
 }
\ No newline at end of file
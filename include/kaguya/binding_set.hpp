@@ -0,0 +1,135 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "kaguya/config.hpp"
+#include "kaguya/metatable.hpp"
+
+#if KAGUYA_USE_CPP11
+#include <chrono>
+#else
+#include <ctime>
+#endif
+
+namespace kaguya {
+namespace detail {
+struct ClassInstallerBase {
+  virtual ~ClassInstallerBase() {}
+  virtual void push(lua_State *state) const = 0;
+};
+template <typename Pushable> struct ClassInstaller : ClassInstallerBase {
+  ClassInstaller(const Pushable &v) : value(v) {}
+  virtual void push(lua_State *state) const { util::one_push(state, value); }
+  Pushable value;
+};
+}
+
+/// @brief Class bindings built once and installed into many states.
+/// e.g.
+/// @code
+/// static const kaguya::BindingSet bindings = kaguya::BindingSet()
+///   .addClass("Foo", kaguya::UserdataMetatable<Foo>().addFunction(...))
+///   .addLazyClass("Bar", kaguya::UserdataMetatable<Bar>()...);
+/// kaguya::State state;
+/// kaguya::BindingSet::InstallStats stats = bindings.install(state.state());
+/// @endcode
+class BindingSet {
+public:
+  /// @brief result of install
+  struct InstallStats {
+    InstallStats() : class_count(0), elapsed_seconds(0) {}
+    size_t class_count;     //!< installed class count
+    double elapsed_seconds; //!< time taken by install
+  };
+
+  /// @brief add class. metatable is created at install
+  template <typename T, typename P>
+  BindingSet &addClass(const std::string &name,
+                       const UserdataMetatable<T, P> &meta) {
+    return add(name, PreparedUserdataMetatable<T, P>(meta));
+  }
+  /// @brief add class. metatable is created at install
+  template <typename T, typename P>
+  BindingSet &addClass(const std::string &name,
+                       const StaticUserdataMetatable<T, P> &meta) {
+    return add(name, meta);
+  }
+
+  /// @brief add class. metatable is created when first used in the state.
+  /// see TableKeyReferenceProxy::setLazyClass
+  template <typename T, typename P>
+  BindingSet &addLazyClass(const std::string &name,
+                           const UserdataMetatable<T, P> &meta) {
+    return add(name, lazyClass(meta));
+  }
+  /// @brief add class. metatable is created when first used in the state.
+  template <typename T, typename P>
+  BindingSet &addLazyClass(const std::string &name,
+                           const StaticUserdataMetatable<T, P> &meta) {
+    return add(name,
+               LazyUserdataMetatable<T, StaticUserdataMetatable<T, P> >(meta));
+  }
+
+  /// @brief install all classes to global table of state
+  InstallStats install(lua_State *state) const {
+    util::ScopedSavedStack save(state);
+    lua_pushglobaltable(state);
+    return install(state, lua_gettop(state));
+  }
+
+  /// @brief install all classes to table
+  InstallStats install(const LuaTable &table) const {
+    lua_State *state = table.state();
+    util::ScopedSavedStack save(state);
+    table.push(state);
+    return install(state, lua_gettop(state));
+  }
+
+  size_t size() const { return entries_.size(); }
+
+private:
+  template <typename Pushable>
+  BindingSet &add(const std::string &name, const Pushable &value) {
+    entries_.push_back(
+        entry_type(name, installer_ptr(new detail::ClassInstaller<Pushable>(
+                             value))));
+    return *this;
+  }
+
+  InstallStats install(lua_State *state, int table_index) const {
+#if KAGUYA_USE_CPP11
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+#else
+    std::clock_t start = std::clock();
+#endif
+    lua_checkstack(state, 3);
+    for (std::vector<entry_type>::const_iterator it = entries_.begin();
+         it != entries_.end(); ++it) {
+      lua_pushlstring(state, it->first.data(), it->first.size());
+      it->second->push(state);
+      lua_settable(state, table_index);
+    }
+    InstallStats stats;
+    stats.class_count = entries_.size();
+#if KAGUYA_USE_CPP11
+    stats.elapsed_seconds = std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - start)
+                                .count();
+#else
+    stats.elapsed_seconds = double(std::clock() - start) / CLOCKS_PER_SEC;
+#endif
+    return stats;
+  }
+
+  typedef standard::shared_ptr<const detail::ClassInstallerBase> installer_ptr;
+  typedef std::pair<std::string, installer_ptr> entry_type;
+  std::vector<entry_type> entries_;
+};
+}
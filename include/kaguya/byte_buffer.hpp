@@ -0,0 +1,465 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "kaguya/config.hpp"
+#if KAGUYA_USE_STRING_VIEW
+#include <string_view>
+#endif
+#include "kaguya/type.hpp"
+#include "kaguya/typed_array.hpp"
+
+namespace kaguya {
+namespace detail {
+// memory shared by buffer and its slices
+struct byte_buffer_block {
+  unsigned char *data;
+  size_t size;
+  size_t capacity;
+  int refcount;
+};
+struct byte_buffer_storage {
+  byte_buffer_block *block;
+  size_t offset;
+  size_t length;
+  bool view;
+};
+}
+
+/// @brief Growable byte buffer userdata for binary data.
+/// Slice is view of the buffer, and it is valid even if the buffer grows.
+/// In Lua, buffer supports #buf and methods size(), reserve(n), clear(),
+/// append(...), slice([pos [,len]]), tostring(),
+/// readXX([pos]) -> value, next_pos and writeXX(value [,pos]).
+/// XX is U8, I8, U16LE, U16BE, I16LE, I16BE, U32LE, U32BE, I32LE, I32BE,
+/// F32LE, F32BE, F64LE, F64BE, and I64LE, I64BE on Lua 5.3 or later.
+/// Positions are 1 origin like string.unpack. writeXX appends by default.
+/// e.g.
+/// @code
+/// state["ByteBuffer"] = kaguya::luacfunction(&kaguya::ByteBuffer::create);
+/// state("local b = ByteBuffer() b:writeU16BE(#body):append(body)");
+/// @endcode
+class ByteBuffer {
+  typedef detail::byte_buffer_block block_type;
+  typedef detail::byte_buffer_storage storage_type;
+
+public:
+  /// @brief push new buffer with copy of data
+  static void push(lua_State *state, const void *data = 0, size_t size = 0) {
+    storage_type *storage = new_buffer(state, size);
+    if (size > 0) {
+      std::memcpy(storage->block->data, data, size);
+      storage->block->size = size;
+    }
+  }
+  /// @brief true if value at index is ByteBuffer
+  static bool isBuffer(lua_State *state, int index) {
+    if (!lua_getmetatable(state, index)) {
+      return false;
+    }
+    luaL_getmetatable(state, metatable_name());
+    bool result = lua_rawequal(state, -1, -2) != 0;
+    lua_pop(state, 2);
+    return result;
+  }
+  /// @brief get view of buffer bytes. return empty span if not ByteBuffer.
+  /// view is invalidated when the buffer grows.
+  static span<unsigned char> get(lua_State *state, int index) {
+    if (!isBuffer(state, index)) {
+      return span<unsigned char>();
+    }
+    size_t size = 0;
+    unsigned char *data = bytes(
+        static_cast<storage_type *>(lua_touserdata(state, index)), size);
+    return span<unsigned char>(data, size);
+  }
+
+  /// @brief lua_CFunction constructor. create([capacity or string])
+  static int create(lua_State *state) {
+    if (lua_type(state, 1) == LUA_TSTRING) {
+      size_t size = 0;
+      const char *data = lua_tolstring(state, 1, &size);
+      push(state, data, size);
+      return 1;
+    }
+    lua_Integer capacity = luaL_optinteger(state, 1, 0);
+    if (capacity < 0) {
+      return luaL_argerror(state, 1, "invalid capacity");
+    }
+    new_buffer(state, static_cast<size_t>(capacity));
+    return 1;
+  }
+
+private:
+  static const char *metatable_name() { return "kaguya::ByteBuffer"; }
+
+  static storage_type *new_buffer(lua_State *state, size_t capacity) {
+    storage_type *storage = static_cast<storage_type *>(
+        lua_newuserdata(state, sizeof(storage_type)));
+    storage->block = 0;
+    storage->offset = 0;
+    storage->length = 0;
+    storage->view = false;
+    setmetatable(state);
+    block_type *block =
+        static_cast<block_type *>(std::malloc(sizeof(block_type)));
+    if (!block) {
+      luaL_error(state, "not enough memory");
+      return 0;
+    }
+    block->data = 0;
+    block->size = 0;
+    block->capacity = 0;
+    block->refcount = 1;
+    storage->block = block;
+    reserve(state, block, capacity);
+    return storage;
+  }
+  static void setmetatable(lua_State *state) {
+    if (luaL_newmetatable(state, metatable_name())) {
+      init_metatable(state);
+    }
+    lua_setmetatable(state, -2);
+  }
+  static void add_function(lua_State *state, int metatable, int table,
+                           const char *name, lua_CFunction f) {
+    lua_pushvalue(state, metatable);
+    lua_pushcclosure(state, f, 1);
+    lua_setfield(state, table, name);
+  }
+  template <typename V, bool BigEndian>
+  static void add_accessor(lua_State *state, int metatable, int methods,
+                           const std::string &name) {
+    add_function(state, metatable, methods, ("read" + name).c_str(),
+                 &read_function<V, BigEndian>);
+    add_function(state, metatable, methods, ("write" + name).c_str(),
+                 &write_function<V, BigEndian>);
+  }
+  template <typename V>
+  static void add_accessors(lua_State *state, int metatable, int methods,
+                            const std::string &name) {
+    add_accessor<V, false>(state, metatable, methods, name + "LE");
+    add_accessor<V, true>(state, metatable, methods, name + "BE");
+  }
+  static void init_metatable(lua_State *state) {
+    int metatable = lua_gettop(state);
+    lua_createtable(state, 0, 40);
+    int methods = lua_gettop(state);
+    add_function(state, metatable, methods, "size", &size_function);
+    add_function(state, metatable, methods, "reserve", &reserve_function);
+    add_function(state, metatable, methods, "clear", &clear_function);
+    add_function(state, metatable, methods, "append", &append_function);
+    add_function(state, metatable, methods, "slice", &slice_function);
+    add_function(state, metatable, methods, "tostring", &tostring_function);
+    add_accessor<unsigned char, false>(state, metatable, methods, "U8");
+    add_accessor<signed char, false>(state, metatable, methods, "I8");
+    add_accessors<unsigned short>(state, metatable, methods, "U16");
+    add_accessors<short>(state, metatable, methods, "I16");
+    add_accessors<unsigned int>(state, metatable, methods, "U32");
+    add_accessors<int>(state, metatable, methods, "I32");
+    add_accessors<float>(state, metatable, methods, "F32");
+    add_accessors<double>(state, metatable, methods, "F64");
+#if LUA_VERSION_NUM >= 503
+    add_accessors<lua_Integer>(state, metatable, methods, "I64");
+#endif
+    lua_setfield(state, metatable, "__index");
+    add_function(state, metatable, metatable, "__len", &size_function);
+    add_function(state, metatable, metatable, "__gc", &gc_function);
+    lua_pushstring(state, metatable_name());
+    lua_setfield(state, metatable, "__name");
+    lua_settop(state, metatable);
+  }
+
+  // methods hold metatable as upvalue 1
+  static storage_type *check(lua_State *state, int index) {
+    if (lua_getmetatable(state, index)) {
+      bool same = lua_rawequal(state, -1, lua_upvalueindex(1)) != 0;
+      lua_pop(state, 1);
+      if (same) {
+        return static_cast<storage_type *>(lua_touserdata(state, index));
+      }
+    }
+    luaL_argerror(state, index,
+                  lua_pushfstring(state, "%s expected", metatable_name()));
+    return 0;
+  }
+  static storage_type *check_growable(lua_State *state, int index) {
+    storage_type *self = check(state, index);
+    if (self->view) {
+      luaL_argerror(state, index, "slice is not growable");
+    }
+    return self;
+  }
+  static unsigned char *bytes(storage_type *self, size_t &size) {
+    block_type *block = self->block;
+    if (!self->view) {
+      size = block->size;
+      return block->data;
+    }
+    size = self->offset < block->size
+               ? (std::min)(self->length, block->size - self->offset)
+               : 0;
+    return block->data + self->offset;
+  }
+  static void reserve(lua_State *state, block_type *block, size_t capacity) {
+    if (capacity <= block->capacity) {
+      return;
+    }
+    size_t new_capacity = (std::max)(capacity, block->capacity * 2);
+    void *data = std::realloc(block->data, new_capacity);
+    if (!data) {
+      luaL_error(state, "not enough memory");
+      return;
+    }
+    block->data = static_cast<unsigned char *>(data);
+    block->capacity = new_capacity;
+  }
+  // 1 origin position argument to offset in range [0, size]
+  static size_t check_position(lua_State *state, int index, size_t size,
+                               size_t default_pos) {
+    lua_Integer pos =
+        luaL_optinteger(state, index, static_cast<lua_Integer>(default_pos));
+    if (pos < 1 || static_cast<size_t>(pos) > size + 1) {
+      luaL_argerror(state, index, "position out of range");
+    }
+    return static_cast<size_t>(pos) - 1;
+  }
+
+  static bool host_is_big_endian() {
+    const unsigned int one = 1;
+    return *reinterpret_cast<const unsigned char *>(&one) == 0;
+  }
+  template <typename V>
+  static typename traits::enable_if<traits::is_floating_point<V>::value,
+                                    V>::type
+  check_value(lua_State *state, int index) {
+    return static_cast<V>(luaL_checknumber(state, index));
+  }
+  template <typename V>
+  static typename traits::enable_if<!traits::is_floating_point<V>::value,
+                                    V>::type
+  check_value(lua_State *state, int index) {
+    return static_cast<V>(luaL_checkinteger(state, index));
+  }
+  template <typename V, bool BigEndian>
+  static void encode(unsigned char *dest, V value) {
+    std::memcpy(dest, &value, sizeof(V));
+    if (BigEndian != host_is_big_endian()) {
+      std::reverse(dest, dest + sizeof(V));
+    }
+  }
+  template <typename V, bool BigEndian>
+  static V decode(const unsigned char *src) {
+    unsigned char buffer[sizeof(V)];
+    std::memcpy(buffer, src, sizeof(V));
+    if (BigEndian != host_is_big_endian()) {
+      std::reverse(buffer, buffer + sizeof(V));
+    }
+    V value;
+    std::memcpy(&value, buffer, sizeof(V));
+    return value;
+  }
+
+  template <typename V, bool BigEndian>
+  static int read_function(lua_State *state) {
+    storage_type *self = check(state, 1);
+    size_t size = 0;
+    const unsigned char *data = bytes(self, size);
+    size_t pos = check_position(state, 2, size, 1);
+    if (sizeof(V) > size - pos) {
+      return luaL_argerror(state, 2, "position out of range");
+    }
+    lua_type_traits<V>::push(state, decode<V, BigEndian>(data + pos));
+    lua_pushinteger(state, static_cast<lua_Integer>(pos + sizeof(V) + 1));
+    return 2;
+  }
+  template <typename V, bool BigEndian>
+  static int write_function(lua_State *state) {
+    storage_type *self = check(state, 1);
+    V value = check_value<V>(state, 2);
+    size_t size = 0;
+    unsigned char *data = bytes(self, size);
+    size_t pos = check_position(state, 3, size, size + 1);
+    if (sizeof(V) > size - pos) {
+      if (self->view) {
+        return luaL_argerror(state, 3, "slice is not growable");
+      }
+      reserve(state, self->block, pos + sizeof(V));
+      self->block->size = pos + sizeof(V);
+      data = self->block->data;
+    }
+    encode<V, BigEndian>(data + pos, value);
+    lua_settop(state, 1);
+    return 1;
+  }
+
+  static int size_function(lua_State *state) {
+    size_t size = 0;
+    bytes(check(state, 1), size);
+    lua_pushinteger(state, static_cast<lua_Integer>(size));
+    return 1;
+  }
+  static int reserve_function(lua_State *state) {
+    storage_type *self = check_growable(state, 1);
+    lua_Integer capacity = luaL_checkinteger(state, 2);
+    if (capacity > 0) {
+      reserve(state, self->block, static_cast<size_t>(capacity));
+    }
+    lua_settop(state, 1);
+    return 1;
+  }
+  static int clear_function(lua_State *state) {
+    check_growable(state, 1)->block->size = 0;
+    lua_settop(state, 1);
+    return 1;
+  }
+  // append(...) strings and buffers
+  static int append_function(lua_State *state) {
+    storage_type *self = check_growable(state, 1);
+    int top = lua_gettop(state);
+    for (int i = 2; i <= top; ++i) {
+      size_t size = 0;
+      if (lua_type(state, i) == LUA_TSTRING) {
+        lua_tolstring(state, i, &size);
+      } else {
+        bytes(check(state, i), size);
+      }
+      block_type *block = self->block;
+      reserve(state, block, block->size + size);
+      // source pointer is taken after reserve, source may be this buffer
+      const void *src = lua_type(state, i) == LUA_TSTRING
+                            ? static_cast<const void *>(lua_tostring(state, i))
+                            : bytes(check(state, i), size);
+      if (size > 0) {
+        std::memcpy(block->data + block->size, src, size);
+      }
+      block->size += size;
+    }
+    lua_settop(state, 1);
+    return 1;
+  }
+  // slice([pos [,len]])
+  static int slice_function(lua_State *state) {
+    storage_type *self = check(state, 1);
+    size_t size = 0;
+    bytes(self, size);
+    size_t pos = check_position(state, 2, size, 1);
+    lua_Integer length = luaL_optinteger(
+        state, 3, static_cast<lua_Integer>(size - pos));
+    if (length < 0 || static_cast<size_t>(length) > size - pos) {
+      return luaL_argerror(state, 3, "length out of range");
+    }
+    storage_type *slice = static_cast<storage_type *>(
+        lua_newuserdata(state, sizeof(storage_type)));
+    slice->block = self->block;
+    slice->offset = self->offset + pos;
+    slice->length = static_cast<size_t>(length);
+    slice->view = true;
+    ++slice->block->refcount;
+    lua_pushvalue(state, lua_upvalueindex(1));
+    lua_setmetatable(state, -2);
+    return 1;
+  }
+  static int tostring_function(lua_State *state) {
+    size_t size = 0;
+    const unsigned char *data = bytes(check(state, 1), size);
+    lua_pushlstring(state, reinterpret_cast<const char *>(data), size);
+    return 1;
+  }
+  static int gc_function(lua_State *state) {
+    storage_type *self = check(state, 1);
+    block_type *block = self->block;
+    self->block = 0;
+    if (block && --block->refcount == 0) {
+      std::free(block->data);
+      std::free(block);
+    }
+    return 0;
+  }
+};
+
+/// @ingroup lua_type_traits
+/// @brief lua_type_traits for span<const unsigned char>. gets bytes of
+/// ByteBuffer, TypedArray<unsigned char> or string without copy.
+/// pushed as string.
+template <> struct lua_type_traits<span<const unsigned char> > {
+  typedef span<const unsigned char> get_type;
+  typedef const span<const unsigned char> &push_type;
+
+  static bool strictCheckType(lua_State *l, int index) {
+    return lua_type(l, index) == LUA_TSTRING ||
+           ByteBuffer::isBuffer(l, index) ||
+           TypedArray<unsigned char>::isArray(l, index);
+  }
+  static bool checkType(lua_State *l, int index) {
+    return strictCheckType(l, index);
+  }
+  static get_type get(lua_State *l, int index) {
+    if (lua_type(l, index) == LUA_TSTRING) {
+      size_t size = 0;
+      const char *data = lua_tolstring(l, index, &size);
+      return get_type(reinterpret_cast<const unsigned char *>(data), size);
+    }
+    span<unsigned char> bytes;
+    if (ByteBuffer::isBuffer(l, index)) {
+      bytes = ByteBuffer::get(l, index);
+    } else if (TypedArray<unsigned char>::isArray(l, index)) {
+      bytes = TypedArray<unsigned char>::get(l, index);
+    } else {
+      KAGUYA_THROW(LuaTypeMismatch());
+    }
+    return get_type(bytes.data(), bytes.size());
+  }
+  static int push(lua_State *l, push_type s) {
+    lua_pushlstring(l, reinterpret_cast<const char *>(s.data()), s.size());
+    return 1;
+  }
+};
+template <>
+struct lua_type_traits<const span<const unsigned char> &>
+    : lua_type_traits<span<const unsigned char> > {};
+
+#if KAGUYA_USE_STRING_VIEW
+/// @ingroup lua_type_traits
+/// @brief lua_type_traits for std::string_view. gets bytes of string or
+/// ByteBuffer without copy.
+template <> struct lua_type_traits<std::string_view> {
+  typedef std::string_view get_type;
+  typedef std::string_view push_type;
+
+  static bool strictCheckType(lua_State *l, int index) {
+    return lua_type(l, index) == LUA_TSTRING || ByteBuffer::isBuffer(l, index);
+  }
+  static bool checkType(lua_State *l, int index) {
+    return lua_isstring(l, index) != 0 || ByteBuffer::isBuffer(l, index);
+  }
+  static get_type get(lua_State *l, int index) {
+    if (ByteBuffer::isBuffer(l, index)) {
+      span<unsigned char> bytes = ByteBuffer::get(l, index);
+      return get_type(reinterpret_cast<const char *>(bytes.data()),
+                      bytes.size());
+    }
+    size_t size = 0;
+    const char *data = lua_tolstring(l, index, &size);
+    if (!data) {
+      KAGUYA_THROW(LuaTypeMismatch());
+    }
+    return get_type(data, size);
+  }
+  static int push(lua_State *l, push_type s) {
+    lua_pushlstring(l, s.data(), s.size());
+    return 1;
+  }
+};
+template <>
+struct lua_type_traits<const std::string_view &>
+    : lua_type_traits<std::string_view> {};
+#endif
+}
@@ -0,0 +1,452 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "kaguya/config.hpp"
+
+#if KAGUYA_USE_CPP11
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include "kaguya/metatable.hpp"
+#include "kaguya/scheduler.hpp"
+#include "kaguya/serializer.hpp"
+
+namespace kaguya {
+namespace detail {
+// Bounded multi producer multi consumer queue by Dmitry Vyukov.
+// The sequence number of a cell tells whether it is writable or readable
+// for a position, so threads synchronize on cells instead of a lock.
+// close sets the top bit of the enqueue position, so no push can claim a
+// cell after close, and the last position is known to consumers.
+template <typename T> class mpmc_ring {
+  typedef std::uint64_t position_type;
+  static const position_type closed_bit = position_type(1) << 63;
+
+public:
+  explicit mpmc_ring(size_t capacity)
+      : mask_(round_capacity(capacity) - 1), cells_(new cell[mask_ + 1]) {
+    for (size_t i = 0; i <= mask_; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    enqueue_.value.store(0, std::memory_order_relaxed);
+    dequeue_.value.store(0, std::memory_order_relaxed);
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+  // approximate while other threads push or pop
+  size_t size() const {
+    position_type dequeue = dequeue_.value.load(std::memory_order_relaxed);
+    position_type enqueue =
+        enqueue_.value.load(std::memory_order_relaxed) & ~closed_bit;
+    return enqueue > dequeue
+               ? static_cast<size_t>((std::min)(
+                     enqueue - dequeue, static_cast<position_type>(mask_ + 1)))
+               : 0;
+  }
+
+  void close() {
+    enqueue_.value.fetch_or(closed_bit, std::memory_order_acq_rel);
+  }
+  bool closed() const {
+    return (enqueue_.value.load(std::memory_order_acquire) & closed_bit) != 0;
+  }
+  // closed, and every value pushed before close is popped
+  bool drained() const {
+    position_type enqueue = enqueue_.value.load(std::memory_order_acquire);
+    if (!(enqueue & closed_bit)) {
+      return false;
+    }
+    return dequeue_.value.load(std::memory_order_acquire) >=
+           (enqueue & ~closed_bit);
+  }
+
+  // move value into the queue. value is unchanged if the queue is full or
+  // closed.
+  bool push(T &value) {
+    cell *c;
+    position_type pos = enqueue_.value.load(std::memory_order_relaxed);
+    for (;;) {
+      if (pos & closed_bit) {
+        return false;
+      }
+      c = &cells_[pos & mask_];
+      position_type seq = c->sequence.load(std::memory_order_acquire);
+      std::int64_t dif = static_cast<std::int64_t>(seq - pos);
+      if (dif == 0) {
+        if (enqueue_.value.compare_exchange_weak(pos, pos + 1,
+                                                 std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (dif < 0) {
+        return false;
+      } else {
+        pos = enqueue_.value.load(std::memory_order_relaxed);
+      }
+    }
+    c->value = std::move(value);
+    c->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+  bool pop(T &value) {
+    cell *c;
+    position_type pos = dequeue_.value.load(std::memory_order_relaxed);
+    for (;;) {
+      c = &cells_[pos & mask_];
+      position_type seq = c->sequence.load(std::memory_order_acquire);
+      std::int64_t dif = static_cast<std::int64_t>(seq - (pos + 1));
+      if (dif == 0) {
+        if (dequeue_.value.compare_exchange_weak(pos, pos + 1,
+                                                 std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (dif < 0) {
+        return false;
+      } else {
+        pos = dequeue_.value.load(std::memory_order_relaxed);
+      }
+    }
+    value = std::move(c->value);
+    c->value = T(); // release payload memory now, not on next lap
+    c->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  struct cell {
+    std::atomic<position_type> sequence;
+    T value;
+  };
+  // positions are on their own cache lines, producers and consumers do
+  // not invalidate each other
+  struct padded_position {
+    char pad[64];
+    std::atomic<position_type> value;
+  };
+  // capacity from script can be any size_t, e.g. -1 as SIZE_MAX. larger
+  // than the largest power of two would loop forever
+  static size_t round_capacity(size_t capacity) {
+    if (capacity == 0 || capacity > (~size_t(0) >> 1) + 1) {
+      KAGUYA_THROW(std::length_error("channel capacity out of range"));
+    }
+    size_t n = 2;
+    while (n < capacity) {
+      n <<= 1;
+    }
+    return n;
+  }
+
+  mpmc_ring(const mpmc_ring &);
+  mpmc_ring &operator=(const mpmc_ring &);
+
+  const size_t mask_;
+  std::unique_ptr<cell[]> cells_;
+  padded_position enqueue_;
+  padded_position dequeue_;
+};
+
+// spin, then yield, then sleep while waiting for a channel
+class channel_backoff {
+public:
+  channel_backoff() : count_(0) {}
+  void wait() {
+    if (count_ < 16) {
+      ++count_;
+    } else if (count_ < 32) {
+      ++count_;
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+
+private:
+  unsigned int count_;
+};
+}
+
+/// @brief Bounded lock-free channel of values between threads.
+///
+/// Copies of a channel refer to the same queue. trySend and tryRecv never
+/// block or take a lock. send and recv spin, then yield and sleep while
+/// the queue is full or empty. After close, sends fail and recv returns
+/// false once all values sent before close are received.
+/// T must be default constructible and movable.
+template <typename T> class BasicChannel {
+public:
+  typedef T value_type;
+
+  /// @param capacity rounded up to power of two. 0 and values above the
+  /// largest power of two of size_t throw std::length_error
+  explicit BasicChannel(size_t capacity = 1024)
+      : impl_(std::make_shared<impl>(capacity)) {}
+
+  bool trySend(const T &value) {
+    T copy(value);
+    return trySend(std::move(copy));
+  }
+  /// @brief value is moved only if it is sent
+  bool trySend(T &&value) { return impl_->ring.push(value); }
+  /// @brief wait for space. false if closed
+  bool send(T value) {
+    detail::channel_backoff backoff;
+    while (!impl_->ring.push(value)) {
+      if (closed()) {
+        return false;
+      }
+      backoff.wait();
+    }
+    return true;
+  }
+
+  bool tryRecv(T &value) { return impl_->ring.pop(value); }
+  /// @brief wait for value. false if closed and drained
+  bool recv(T &value) {
+    detail::channel_backoff backoff;
+    while (!impl_->ring.pop(value)) {
+      if (drained()) {
+        return false;
+      }
+      backoff.wait();
+    }
+    return true;
+  }
+
+  void close() { impl_->ring.close(); }
+  bool closed() const { return impl_->ring.closed(); }
+  /// @brief true if closed and all values sent before close are received
+  bool drained() const { return impl_->ring.drained(); }
+  /// @brief number of queued values. approximate while in use
+  size_t size() const { return impl_->ring.size(); }
+  size_t capacity() const { return impl_->ring.capacity(); }
+
+  bool operator==(const BasicChannel &other) const {
+    return impl_ == other.impl_;
+  }
+  bool operator!=(const BasicChannel &other) const {
+    return impl_ != other.impl_;
+  }
+
+private:
+  struct impl {
+    explicit impl(size_t capacity) : ring(capacity) {}
+    detail::mpmc_ring<T> ring;
+  };
+  std::shared_ptr<impl> impl_;
+};
+
+/// @brief Channel of Lua values copied by Serializer, bound to Lua.
+///
+/// Register with setClass(kaguya::Channel::metatable()) in each State and
+/// set the same channel to them. Lua methods:
+/// Channel.new([capacity]), send(v), try_send(v), recv(), try_recv(),
+/// close(), closed(), size(), capacity().
+/// send and try_send return false if the channel is closed or full.
+/// recv and try_recv return value, true, or nil, false if there is no value.
+/// In a task of Scheduler, send and recv park the task until the channel is
+/// ready. Elsewhere, including plain coroutines, they block the OS thread
+/// with spin, yield and sleep. Coroutines driven by other schedulers should
+/// use try_send and try_recv and yield by themselves.
+/// @code
+///   kaguya::Channel jobs(256);
+///   producer["Channel"].setClass(kaguya::Channel::metatable());
+///   consumer["Channel"].setClass(kaguya::Channel::metatable());
+///   producer["jobs"] = jobs;
+///   consumer["jobs"] = jobs;
+/// @endcode
+/// This header is not included by kaguya.hpp. Link with the thread library.
+class Channel : public BasicChannel<SerializedValue> {
+public:
+  explicit Channel(size_t capacity = 1024)
+      : BasicChannel<SerializedValue>(capacity) {}
+
+  /// @brief class binding of Channel
+  static UserdataMetatable<Channel> metatable() {
+    return UserdataMetatable<Channel>()
+        .setConstructors<Channel(), Channel(size_t)>()
+        .addStaticField("send", luacfunction(&send_function))
+        .addStaticField("try_send", luacfunction(&try_send_function))
+        .addStaticField("recv", luacfunction(&recv_function))
+        .addStaticField("try_recv", luacfunction(&try_recv_function))
+        .addStaticField("close", luacfunction(&close_function))
+        .addStaticField("closed", luacfunction(&closed_function))
+        .addStaticField("size", luacfunction(&size_function))
+        .addStaticField("capacity", luacfunction(&capacity_function));
+  }
+
+private:
+  class SendAwaitable : public Awaitable {
+  public:
+    SendAwaitable(const BasicChannel<SerializedValue> &channel,
+                  SerializedValue &&value)
+        : channel_(channel), value_(std::move(value)), sent_(false) {}
+    virtual bool ready() {
+      if (channel_.closed()) {
+        return true;
+      }
+      sent_ = channel_.trySend(std::move(value_));
+      return sent_;
+    }
+    virtual int push(lua_State *state) {
+      lua_pushboolean(state, sent_);
+      return 1;
+    }
+
+  private:
+    BasicChannel<SerializedValue> channel_;
+    SerializedValue value_;
+    bool sent_;
+  };
+  class RecvAwaitable : public Awaitable {
+  public:
+    explicit RecvAwaitable(const BasicChannel<SerializedValue> &channel)
+        : channel_(channel), received_(false) {}
+    virtual bool ready() {
+      received_ = channel_.tryRecv(value_);
+      return received_ || channel_.drained();
+    }
+    virtual int push(lua_State *state) {
+      if (!received_) {
+        lua_pushnil(state);
+        lua_pushboolean(state, 0);
+        return 2;
+      }
+      lua_type_traits<SerializedValue>::push(state, value_);
+      lua_pushboolean(state, 1);
+      return 2;
+    }
+
+  private:
+    BasicChannel<SerializedValue> channel_;
+    SerializedValue value_;
+    bool received_;
+  };
+
+  static Channel *check(lua_State *state) {
+    Channel *self = get_pointer(state, 1, types::typetag<Channel>());
+    if (!self) {
+      luaL_argerror(state, 1, "kaguya::Channel expected");
+    }
+    return self;
+  }
+
+  // Lua errors and yields do not unwind C++ objects. Helpers below return
+  // the number of results, or -1 with error message, and hand over
+  // awaitable to wait in a task. Callers raise or yield after they return.
+  static bool encode(lua_State *state, SerializedValue &value) {
+    std::string data;
+    if (Serializer::encode_status(state, 2, data) != 0) {
+      return false;
+    }
+    value.swap(data);
+    return true;
+  }
+  static int push_value(lua_State *state, const SerializedValue &value) {
+    if (value.empty()) {
+      lua_pushnil(state);
+    } else if (Serializer::decode_status(state, value.data().data(),
+                                         value.size()) != 0) {
+      return -1;
+    }
+    lua_pushboolean(state, 1);
+    return 2;
+  }
+  static int send_value(lua_State *state, Channel &self, bool wait,
+                        Awaitable *&waiting) {
+    SerializedValue value;
+    if (!encode(state, value)) {
+      return -1;
+    }
+    bool sent = self.trySend(std::move(value));
+    if (!sent && wait && !self.closed()) {
+      if (Scheduler::inTask(state)) {
+        waiting = new SendAwaitable(self, std::move(value));
+        return 0;
+      }
+      sent = self.send(std::move(value));
+    }
+    lua_pushboolean(state, sent);
+    return 1;
+  }
+  static int recv_value(lua_State *state, Channel &self, bool wait,
+                        Awaitable *&waiting) {
+    SerializedValue value;
+    bool received = self.tryRecv(value);
+    if (!received && wait) {
+      if (Scheduler::inTask(state) && !self.drained()) {
+        waiting = new RecvAwaitable(self);
+        return 0;
+      }
+      received = self.recv(value);
+    }
+    if (!received) {
+      lua_pushnil(state);
+      lua_pushboolean(state, 0);
+      return 2;
+    }
+    return push_value(state, value);
+  }
+  static int finish(lua_State *state, int result, Awaitable *waiting) {
+    if (result < 0) {
+      return lua_error(state);
+    }
+    if (waiting) {
+      return Scheduler::await(state, waiting);
+    }
+    return result;
+  }
+
+  static int send_function(lua_State *state) {
+    Channel *self = check(state);
+    lua_settop(state, 2);
+    Awaitable *waiting = 0;
+    int result = send_value(state, *self, true, waiting);
+    return finish(state, result, waiting);
+  }
+  static int try_send_function(lua_State *state) {
+    Channel *self = check(state);
+    lua_settop(state, 2);
+    Awaitable *waiting = 0;
+    int result = send_value(state, *self, false, waiting);
+    return finish(state, result, waiting);
+  }
+  static int recv_function(lua_State *state) {
+    Channel *self = check(state);
+    Awaitable *waiting = 0;
+    int result = recv_value(state, *self, true, waiting);
+    return finish(state, result, waiting);
+  }
+  static int try_recv_function(lua_State *state) {
+    Channel *self = check(state);
+    Awaitable *waiting = 0;
+    int result = recv_value(state, *self, false, waiting);
+    return finish(state, result, waiting);
+  }
+  static int close_function(lua_State *state) {
+    check(state)->close();
+    return 0;
+  }
+  static int closed_function(lua_State *state) {
+    lua_pushboolean(state, check(state)->closed());
+    return 1;
+  }
+  static int size_function(lua_State *state) {
+    lua_pushinteger(state, static_cast<lua_Integer>(check(state)->size()));
+    return 1;
+  }
+  static int capacity_function(lua_State *state) {
+    lua_pushinteger(state,
+                    static_cast<lua_Integer>(check(state)->capacity()));
+    return 1;
+  }
+};
+}
+#endif
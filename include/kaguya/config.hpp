@@ -20,6 +20,14 @@ extern "C" {
 #endif
 #endif
 
+#ifndef KAGUYA_USE_STRING_VIEW
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#define KAGUYA_USE_STRING_VIEW 1
+#else
+#define KAGUYA_USE_STRING_VIEW 0
+#endif
+#endif
+
 #if KAGUYA_USE_CPP11
 #include <functional>
 #include <tuple>
@@ -63,6 +71,7 @@ extern "C" {
 #ifdef KAGUYA_NO_VECTOR_AND_MAP_TO_TABLE
 #define KAGUYA_NO_STD_VECTOR_TO_TABLE
 #define KAGUYA_NO_STD_MAP_TO_TABLE
+#define KAGUYA_NO_STD_CONTAINER_TO_TABLE
 #endif
 
 #if !KAGUYA_USE_CPP11
@@ -98,6 +107,77 @@ extern "C" {
 #define KAGUYA_USE_SHARED_LUAREF 0
 #endif
 
+#ifndef KAGUYA_USE_MAIN_THREAD_CACHE
+///! if 1, toMainThread on Lua 5.1 and LuaJIT looks up main thread in a
+///! process wide table keyed by registry address. see
+///! util::MainThreadCache
+#if KAGUYA_USE_CPP11 && !KAGUYA_SUPPORT_MULTIPLE_SHARED_LIBRARY
+#define KAGUYA_USE_MAIN_THREAD_CACHE 1
+#else
+#define KAGUYA_USE_MAIN_THREAD_CACHE 0
+#endif
+#endif
+
+#ifndef KAGUYA_USE_REF_STORE
+///! if 1, LuaRef holds value in per state reference store instead of
+///! luaL_ref. see Ref::RefStore
+#define KAGUYA_USE_REF_STORE 0
+#endif
+
+#ifndef KAGUYA_NO_EXCEPTIONS
+///! if 1, bound function dispatch checks arguments before call and reports
+///! mismatch by lua_error without try/catch.
+#if (defined(__GNUC__) && !defined(__EXCEPTIONS)) ||                          \
+    (defined(_MSC_VER) && !defined(_CPPUNWIND))
+#define KAGUYA_NO_EXCEPTIONS 1
+#else
+#define KAGUYA_NO_EXCEPTIONS 0
+#endif
+#endif
+
+#ifndef KAGUYA_THROW
+#if KAGUYA_NO_EXCEPTIONS
+///! without exceptions, errors that would be thrown are written to stderr
+///! and abort the program. define KAGUYA_THROW(exception) to change it.
+#define KAGUYA_THROW(exception) ::kaguya::detail::throw_disabled(exception)
+#else
+#define KAGUYA_THROW(exception) throw exception
+#endif
+#endif
+
+#if KAGUYA_NO_EXCEPTIONS
+///! try/catch for macro bodies. the handler is never run
+#define KAGUYA_TRY if (true)
+#define KAGUYA_CATCH_ALL else
+#define KAGUYA_RETHROW
+#else
+#define KAGUYA_TRY try
+#define KAGUYA_CATCH_ALL catch (...)
+#define KAGUYA_RETHROW throw
+#endif
+
+#if KAGUYA_NO_EXCEPTIONS
+#include <cstdio>
+#include <cstdlib>
+#if defined(_MSC_VER)
+#define KAGUYA_NORETURN __declspec(noreturn)
+#elif defined(__GNUC__) || defined(__clang__)
+#define KAGUYA_NORETURN __attribute__((noreturn))
+#else
+#define KAGUYA_NORETURN
+#endif
+namespace kaguya {
+namespace detail {
+template <typename Exception>
+KAGUYA_NORETURN void throw_disabled(const Exception &e) {
+  std::fprintf(stderr, "kaguya: %s\n", e.what());
+  std::fflush(stderr);
+  std::abort();
+}
+}
+}
+#endif
+
 #ifndef KAGUYA_NOEXCEPT
 #if KAGUYA_USE_CPP11 && (!defined(_MSC_VER) || _MSC_VER >= 1900)
 #define KAGUYA_NOEXCEPT noexcept
@@ -106,6 +186,20 @@ extern "C" {
 #endif
 #endif
 
+#ifndef KAGUYA_USE_CPP20_COROUTINE
+///! if 1, kaguya::Task and the C++20 coroutine bridge are available.
+///! task errors are exceptions, so it is off without exceptions.
+#if !KAGUYA_NO_EXCEPTIONS && defined(__cpp_impl_coroutine) &&                \
+    __cpp_impl_coroutine >= 201902L && defined(__has_include)
+#if __has_include(<coroutine>)
+#define KAGUYA_USE_CPP20_COROUTINE 1
+#endif
+#endif
+#endif
+#ifndef KAGUYA_USE_CPP20_COROUTINE
+#define KAGUYA_USE_CPP20_COROUTINE 0
+#endif
+
 #ifndef KAGUYA_DEPRECATED_FEATURE
 #if __cplusplus >= 201402L && defined(__has_cpp_attribute)
 #if __has_cpp_attribute(deprecated)
@@ -0,0 +1,571 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "kaguya/config.hpp"
+
+#if KAGUYA_USE_CPP20_COROUTINE
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "kaguya/utility.hpp"
+#include "kaguya/error_handler.hpp"
+#include "kaguya/exception.hpp"
+#include "kaguya/lua_ref.hpp"
+#include "kaguya/native_function.hpp"
+#include "kaguya/lua_ref_function.hpp"
+#include "kaguya/scheduler.hpp"
+
+namespace kaguya {
+template <typename T = void> class Task;
+
+namespace detail {
+struct TaskPromiseBase {
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<Promise> handle) const noexcept {
+      std::coroutine_handle<> next = handle.promise().continuation;
+      return next ? next : std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+  };
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+  void unhandled_exception() noexcept { exception = std::current_exception(); }
+  void rethrow() const {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+
+  std::coroutine_handle<> continuation;
+  std::exception_ptr exception;
+};
+
+template <typename T> struct TaskPromise : TaskPromiseBase {
+  Task<T> get_return_object() noexcept;
+  template <typename U> void return_value(U &&v) {
+    value.emplace(std::forward<U>(v));
+  }
+  T result() {
+    rethrow();
+    return std::move(*value);
+  }
+
+  std::optional<T> value;
+};
+template <> struct TaskPromise<void> : TaskPromiseBase {
+  Task<void> get_return_object() noexcept;
+  void return_void() const noexcept {}
+  void result() const { rethrow(); }
+};
+}
+
+/// @brief Lazily started C++20 coroutine returning T.
+///
+/// A task starts when it is co_awaited or resumed. A function bound to Lua
+/// can return a Task: the task is started immediately, and if it suspends,
+/// the calling Lua thread is yielded until the task finishes. The task
+/// result is then returned to Lua as the result of the call.
+/// @code
+///   kaguya::Task<std::string> read(std::string path) {
+///     co_return co_await loop.readFile(path);
+///   }
+///   state["read"] = kaguya::function(&read);
+///   // in a Lua coroutine: local text = read("a.txt")
+/// @endcode
+/// Errors thrown by the task are raised in the Lua thread. On Lua 5.1 the
+/// call returns nil and the error message instead.
+template <typename T> class Task {
+public:
+  typedef detail::TaskPromise<T> promise_type;
+  typedef std::coroutine_handle<promise_type> handle_type;
+
+  Task() noexcept : handle_() {}
+  explicit Task(handle_type handle) noexcept : handle_(handle) {}
+  Task(Task &&src) noexcept : handle_(std::exchange(src.handle_, nullptr)) {}
+  Task &operator=(Task &&src) noexcept {
+    if (this != &src) {
+      reset();
+      handle_ = std::exchange(src.handle_, nullptr);
+    }
+    return *this;
+  }
+  ~Task() { reset(); }
+
+  Task(const Task &) = delete;
+  Task &operator=(const Task &) = delete;
+
+  /// @brief return true if task has a coroutine
+  bool valid() const noexcept { return bool(handle_); }
+  /// @brief return true if task is finished or empty
+  bool done() const noexcept { return !handle_ || handle_.done(); }
+
+  /// @brief start or continue task from non coroutine code
+  void resume() {
+    if (!done()) {
+      handle_.resume();
+    }
+  }
+
+  /// @brief result of finished task. rethrow the exception of task.
+  T get() {
+    if (!handle_ || !handle_.done()) {
+      KAGUYA_THROW(std::logic_error("kaguya::Task is not finished"));
+    }
+    return handle_.promise().result();
+  }
+
+  class Awaiter {
+  public:
+    explicit Awaiter(handle_type handle) noexcept : handle_(handle) {}
+    bool await_ready() const noexcept { return !handle_ || handle_.done(); }
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<> awaiting) noexcept {
+      handle_.promise().continuation = awaiting;
+      return handle_;
+    }
+    T await_resume() {
+      if (!handle_) {
+        KAGUYA_THROW(std::logic_error("kaguya::Task is empty"));
+      }
+      return handle_.promise().result();
+    }
+
+  private:
+    handle_type handle_;
+  };
+  Awaiter operator co_await() const noexcept { return Awaiter(handle_); }
+
+private:
+  void reset() {
+    if (handle_) {
+      handle_.destroy();
+      handle_ = nullptr;
+    }
+  }
+
+  handle_type handle_;
+};
+
+namespace detail {
+template <typename T> Task<T> TaskPromise<T>::get_return_object() noexcept {
+  return Task<T>(Task<T>::handle_type::from_promise(*this));
+}
+inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+  return Task<void>(Task<void>::handle_type::from_promise(*this));
+}
+
+/// coroutine started eagerly and destroyed on completion
+struct DetachedCoroutine {
+  struct promise_type {
+    DetachedCoroutine get_return_object() const noexcept { return {}; }
+    std::suspend_never initial_suspend() const noexcept { return {}; }
+    std::suspend_never final_suspend() const noexcept { return {}; }
+    void return_void() const noexcept {}
+    void unhandled_exception() const noexcept { std::terminate(); }
+  };
+};
+
+/// Connects a Task returned from a bound function to the Lua thread that
+/// called it. A pending bridge is registered per thread, so resumeAsync can
+/// tell a task wait from a plain yield. In a task of Scheduler, the bridge
+/// hands the result to the scheduler instead of resuming the thread.
+class TaskBridge {
+public:
+  explicit TaskBridge(lua_State *thread)
+      : thread_(thread), function_(0), yielded_(false), completed_(false),
+        handed_off_(false), result_count_(0), waiting_status_(0) {}
+
+  /// @brief pending bridge of suspended thread, or null
+  static TaskBridge *pending(lua_State *thread) {
+    TaskBridge *bridge = registered(thread);
+    if (bridge && !bridge->suspendedHere()) {
+      return 0;
+    }
+    return bridge;
+  }
+
+  /// @brief state to push the task result on, or null if abandoned
+  lua_State *resultState() {
+    if (yielded_ && thread_ && !handed_off_ && !suspendedHere()) {
+      // the yield failed, and the thread went on without this call
+      if (registered(thread_) == this) {
+        set_pending(thread_, 0);
+      }
+      thread_ = 0;
+    }
+    return thread_;
+  }
+
+  /// @brief return true if the task finished before the first suspension
+  bool completed() const { return completed_; }
+
+  /// @brief take result of the task finished without suspension.
+  /// this is deleted.
+  int takeResult() {
+    int count = result_count_;
+    std::exception_ptr error = error_;
+    delete this;
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    return count;
+  }
+
+  /// @brief the calling thread is going to yield
+  void suspend() {
+    yielded_ = true;
+#if LUA_VERSION_NUM < 503
+    function_ = running_function(thread_);
+#endif
+    set_pending(thread_, this);
+  }
+
+  /// @brief the calling thread is going to yield in a task of Scheduler,
+  /// and the scheduler resumes it after finished()
+  void handOff() {
+    yielded_ = true;
+    handed_off_ = true;
+  }
+  /// @brief result of handed off task is pushed to the thread
+  bool finished() const { return completed_; }
+  /// @brief number of values to resume the thread with after finished()
+  int resumeCount() const { return result_count_; }
+
+  /// @brief caller can not yield. the result of the task is discarded.
+  void abandon() {
+    yielded_ = true;
+    thread_ = 0;
+  }
+
+  /// @brief resume awaiting when the thread yields again or returns.
+  void setWaiting(std::coroutine_handle<> awaiting, int *status) {
+    waiting_ = awaiting;
+    waiting_status_ = status;
+  }
+
+  /// @brief task finished with result_count values pushed to resultState().
+  void complete(int result_count) {
+    if (!yielded_) {
+      completed_ = true;
+      result_count_ = result_count;
+      return;
+    }
+    if (!resultState()) {
+      delete this;
+      return;
+    }
+#if LUA_VERSION_NUM >= 502
+    lua_pushinteger(thread_, result_count);
+    ++result_count;
+#endif
+    resumeThread(result_count);
+  }
+
+  /// @brief task finished by exception
+  void fail(std::exception_ptr error) {
+    if (!yielded_) {
+      completed_ = true;
+      error_ = error;
+      return;
+    }
+    if (!resultState()) {
+      delete this;
+      return;
+    }
+    const char *message = "Unknown exception";
+    try {
+      std::rethrow_exception(error);
+    } catch (std::exception &e) {
+      lua_pushstring(thread_, e.what());
+      message = 0;
+    } catch (...) {
+    }
+    if (message) {
+      lua_pushstring(thread_, message);
+    }
+#if LUA_VERSION_NUM >= 502
+    lua_pushinteger(thread_, -1);
+#else
+    lua_pushnil(thread_);
+    lua_insert(thread_, -2);
+#endif
+    resumeThread(2);
+  }
+
+private:
+  void resumeThread(int argnum) {
+    if (handed_off_) {
+      completed_ = true;
+      result_count_ = argnum;
+      return;
+    }
+    lua_State *thread = thread_;
+    set_pending(thread, 0);
+    int status = lua_resume(thread, 0, argnum);
+    std::coroutine_handle<> awaiting = waiting_;
+    TaskBridge *next = status == LUA_YIELD ? pending(thread) : 0;
+    if (next) {
+      next->setWaiting(waiting_, waiting_status_);
+      awaiting = nullptr;
+    } else if (awaiting) {
+      *waiting_status_ = status;
+    } else if (status != 0 && status != LUA_YIELD) {
+      ErrorHandler::handle(status, thread);
+    }
+    delete this;
+    if (awaiting) {
+      awaiting.resume();
+    }
+  }
+
+  static TaskBridge *registered(lua_State *thread) {
+    util::ScopedSavedStack save(thread);
+    if (!push_pending_table(thread, false)) {
+      return 0;
+    }
+    lua_pushthread(thread);
+    lua_rawget(thread, -2);
+    return static_cast<TaskBridge *>(lua_touserdata(thread, -1));
+  }
+  static const void *running_function(lua_State *thread) {
+    lua_Debug ar;
+    if (!lua_getstack(thread, 0, &ar)) {
+      return 0;
+    }
+    util::ScopedSavedStack save(thread);
+    lua_getinfo(thread, "f", &ar);
+    return lua_topointer(thread, -1);
+  }
+  // Lua 5.1 and 5.2 can not tell before lua_yield whether the call is
+  // across a C-call boundary, e.g. under pcall. If that yield failed, the
+  // thread is not suspended in the function that registered this bridge.
+  bool suspendedHere() const {
+#if LUA_VERSION_NUM >= 503
+    return true;
+#else
+    return lua_status(thread_) == LUA_YIELD && registered(thread_) == this &&
+           running_function(thread_) == function_;
+#endif
+  }
+
+#if KAGUYA_SUPPORT_MULTIPLE_SHARED_LIBRARY
+  static void push_registry_key(lua_State *state) {
+    lua_pushstring(state, "\x80KAGUYA_PENDING_TASK_REGISTRY_KEY");
+  }
+#else
+  static void push_registry_key(lua_State *state) {
+    static int key;
+    lua_pushlightuserdata(state, &key);
+  }
+#endif
+  // table of thread to pending bridge. keeps waiting threads alive
+  static bool push_pending_table(lua_State *state, bool create) {
+    push_registry_key(state);
+    lua_rawget(state, LUA_REGISTRYINDEX);
+    if (lua_type(state, -1) == LUA_TTABLE) {
+      return true;
+    }
+    lua_pop(state, 1);
+    if (!create) {
+      return false;
+    }
+    lua_newtable(state);
+    push_registry_key(state);
+    lua_pushvalue(state, -2);
+    lua_rawset(state, LUA_REGISTRYINDEX);
+    return true;
+  }
+  static void set_pending(lua_State *thread, TaskBridge *bridge) {
+    util::ScopedSavedStack save(thread);
+    push_pending_table(thread, true);
+    lua_pushthread(thread);
+    if (bridge) {
+      lua_pushlightuserdata(thread, bridge);
+    } else {
+      lua_pushnil(thread);
+    }
+    lua_rawset(thread, -3);
+  }
+
+  lua_State *thread_;
+  const void *function_;
+  bool yielded_;
+  bool completed_;
+  bool handed_off_;
+  int result_count_;
+  std::exception_ptr error_;
+  std::coroutine_handle<> waiting_;
+  int *waiting_status_;
+};
+
+/// parks a task of Scheduler until the handed off bridge finishes
+class TaskBridgeAwaitable : public Awaitable {
+public:
+  explicit TaskBridgeAwaitable(TaskBridge *bridge) : bridge_(bridge) {}
+  ~TaskBridgeAwaitable() {
+    if (bridge_->finished()) {
+      delete bridge_;
+    } else {
+      bridge_->abandon(); // deleted when the task finishes
+    }
+  }
+  virtual bool ready() { return bridge_->finished(); }
+  // results are already pushed by the bridge
+  virtual int push(lua_State *) { return bridge_->resumeCount(); }
+
+private:
+  TaskBridge *bridge_;
+};
+
+template <typename T>
+DetachedCoroutine run_task(Task<T> task, TaskBridge *bridge) {
+  int count = 0;
+  std::exception_ptr error;
+  try {
+    if constexpr (std::is_void<T>::value) {
+      co_await task;
+    } else {
+      T value = co_await task;
+      if (lua_State *state = bridge->resultState()) {
+        count = util::push_args(state, std::move(value));
+      }
+    }
+  } catch (...) {
+    error = std::current_exception();
+  }
+  if (error) {
+    bridge->fail(error);
+  } else {
+    bridge->complete(count);
+  }
+}
+
+inline bool is_yieldable(lua_State *state) {
+#if LUA_VERSION_NUM >= 503
+  return lua_isyieldable(state) != 0;
+#else
+  bool main_thread = lua_pushthread(state) == 1;
+  lua_pop(state, 1);
+  return !main_thread;
+#endif
+}
+
+template <typename T> int push_task(lua_State *state, Task<T> &&task) {
+  if (!task.valid()) {
+    return 0;
+  }
+  TaskBridge *bridge = new TaskBridge(state);
+  run_task(std::move(task), bridge);
+  if (bridge->completed()) {
+    return bridge->takeResult();
+  }
+  if (!is_yieldable(state)) {
+    bridge->abandon();
+    KAGUYA_THROW(std::runtime_error(
+        "attempt to wait kaguya::Task from outside a coroutine"));
+  }
+  if (Scheduler::inTask(state)) {
+    bridge->handOff();
+    Scheduler::park(state, new TaskBridgeAwaitable(bridge));
+  } else {
+    bridge->suspend();
+  }
+  lua_pushlightuserdata(state, pending_task_marker());
+  return 1;
+}
+}
+
+/// @brief co_await result of LuaThread::resumeAsync
+template <class Result> class ResumeAwaiter {
+public:
+  ResumeAwaiter()
+      : state_(0), thread_(0), argnum_(0), status_(0), pending_(0) {}
+  ResumeAwaiter(lua_State *state, lua_State *thread, const LuaRef &keep,
+                int argnum)
+      : state_(state), thread_(thread), keep_(keep), argnum_(argnum),
+        status_(0), pending_(0) {}
+
+  bool await_ready() {
+    if (!thread_) {
+      return true;
+    }
+    status_ = lua_resume(thread_, state_, argnum_);
+    pending_ = status_ == LUA_YIELD ? detail::TaskBridge::pending(thread_) : 0;
+    return !pending_;
+  }
+  void await_suspend(std::coroutine_handle<> awaiting) {
+    pending_->setWaiting(awaiting, &status_);
+  }
+  Result await_resume() {
+    if (!thread_) {
+      except::typeMismatchError(state_, "not thread");
+      return Result();
+    }
+    except::checkErrorAndThrow(status_, thread_);
+    return detail::FunctionResultProxy::ReturnValue(thread_, status_, 1,
+                                                    types::typetag<Result>());
+  }
+
+private:
+  lua_State *state_;
+  lua_State *thread_;
+  LuaRef keep_;
+  int argnum_;
+  int status_;
+  detail::TaskBridge *pending_;
+};
+
+namespace detail {
+template <typename Derived>
+template <class Result, class... Args>
+ResumeAwaiter<Result> LuaThreadImpl<Derived>::resumeAsync(Args &&... args) {
+  lua_State *state = state_();
+  if (!state) {
+    except::typeMismatchError(state, "attempt to call nil value");
+    return ResumeAwaiter<Result>();
+  }
+  util::ScopedSavedStack save(state);
+  int corStackIndex = pushStackIndex_(state);
+  lua_State *thread = lua_tothread(state, corStackIndex);
+  if (!thread) {
+    except::typeMismatchError(state, "not thread");
+    return ResumeAwaiter<Result>();
+  }
+  lua_pushvalue(state, corStackIndex);
+  LuaRef keep(state, StackTop());
+  int argstart = 1; // exist function in stack at first resume.
+  if (lua_status(thread) == LUA_YIELD) {
+    argstart = 0;
+  }
+  util::push_args(thread, std::forward<Args>(args)...);
+  int argnum = lua_gettop(thread) - argstart;
+  if (argnum < 0) {
+    argnum = 0;
+  }
+  return ResumeAwaiter<Result>(state, thread, keep, argnum);
+}
+}
+
+/// @ingroup lua_type_traits
+/// @brief lua_type_traits for Task. Only for return value of bound
+/// function.
+template <typename T> struct lua_type_traits<Task<T> > {
+  typedef Task<T> &&push_type;
+
+  static int push(lua_State *state, Task<T> &&task) {
+    return detail::push_task(state, std::move(task));
+  }
+};
+}
+#endif
@@ -7,6 +7,7 @@
 
 #include <vector>
 #include <map>
+#include <string>
 #include <cassert>
 #include <algorithm>
 #include <ostream>
@@ -20,6 +21,10 @@ class LuaTable;
 class LuaFunction;
 
 class FunctionResults;
+class LuaStackRef;
+#if KAGUYA_USE_CPP20_COROUTINE
+template <class Result> class ResumeAwaiter;
+#endif
 
 /**
 * status of coroutine
@@ -31,7 +36,78 @@ enum coroutine_status {
   COSTAT_DEAD       //!< coroutine is dead
 };
 
+/// @brief error of one element in LuaFunction::callEach
+struct CallEachError {
+  size_t index;        //!< position of the element in the input range
+  int status;          //!< status code of lua_pcall
+  std::string message; //!< error message
+};
+
+/// @brief collect errors of LuaFunction::callEach per element instead of
+/// reporting them to the error handler.
+class CallEachErrors {
+public:
+  /// @param stop_on_error if true, stop the batch at the first error.
+  explicit CallEachErrors(bool stop_on_error = false)
+      : stop_on_error_(stop_on_error) {}
+
+  bool stopOnError() const { return stop_on_error_; }
+  bool empty() const { return errors_.empty(); }
+  size_t size() const { return errors_.size(); }
+  const CallEachError &operator[](size_t index) const {
+    return errors_[index];
+  }
+  const std::vector<CallEachError> &errors() const { return errors_; }
+  void clear() { errors_.clear(); }
+
+  void add(size_t index, int status, const char *message) {
+    CallEachError error;
+    error.index = index;
+    error.status = status;
+    error.message = message;
+    errors_.push_back(error);
+  }
+
+private:
+  bool stop_on_error_;
+  std::vector<CallEachError> errors_;
+};
+
 namespace detail {
+/// @brief number of values requested from lua_pcall for call<RetType>.
+/// LUA_MULTRET only for results that keep every value on the stack.
+template <typename RetType> struct function_result_count {
+  static const int value = 1;
+};
+template <> struct function_result_count<void> {
+  static const int value = 0;
+};
+template <> struct function_result_count<FunctionResults> {
+  static const int value = LUA_MULTRET;
+};
+template <> struct function_result_count<LuaStackRef> {
+  static const int value = LUA_MULTRET;
+};
+#if KAGUYA_USE_CPP11
+template <typename... TYPES>
+struct function_result_count<standard::tuple<TYPES...> > {
+  static const int value = sizeof...(TYPES);
+};
+#else
+template <> struct function_result_count<standard::tuple<> > {
+  static const int value = 0;
+};
+#define KAGUYA_FUNCTION_RESULT_COUNT_DEF(N)                                    \
+  template <KAGUYA_PP_TEMPLATE_DEF_REPEAT(N)>                                  \
+  struct function_result_count<                                                \
+      standard::tuple<KAGUYA_PP_TEMPLATE_ARG_REPEAT(N)> > {                    \
+    static const int value = N;                                                \
+  };
+KAGUYA_PP_REPEAT_DEF(KAGUYA_FUNCTION_MAX_TUPLE_SIZE,
+                     KAGUYA_FUNCTION_RESULT_COUNT_DEF)
+#undef KAGUYA_FUNCTION_RESULT_COUNT_DEF
+#endif
+
 class FunctionResultProxy {
 public:
   template <typename RetType>
@@ -40,10 +116,64 @@ public:
   static FunctionResults ReturnValue(lua_State *state, int restatus,
                                      int retindex,
                                      types::typetag<FunctionResults> tag);
+  static LuaStackRef ReturnValue(lua_State *state, int restatus, int retindex,
+                                 types::typetag<LuaStackRef> tag);
   static void ReturnValue(lua_State *state, int restatus, int retindex,
                           types::typetag<void> tag);
 };
 
+template <class Result, class OutputIterator>
+inline void call_each_store(lua_State *state, int retindex,
+                            OutputIterator &out, types::typetag<Result> tag) {
+  *out = FunctionResultProxy::ReturnValue(state, 0, retindex, tag);
+  ++out;
+}
+template <class OutputIterator>
+inline void call_each_store(lua_State *state, int retindex, OutputIterator &,
+                            types::typetag<void>) {
+  lua_settop(state, retindex - 1);
+}
+
+/// @brief call function at funcindex for each element of [first, last).
+/// extranum values above funcindex are passed after the element.
+/// @return number of succeeded calls
+template <class Result, class InputIterator, class OutputIterator>
+size_t call_each(lua_State *state, int funcindex, int extranum,
+                 InputIterator first, InputIterator last, OutputIterator &out,
+                 CallEachErrors *errors) {
+  if (!lua_checkstack(state, extranum + 2)) {
+    except::OtherError(state, "stack overflow");
+    return 0;
+  }
+  int top = lua_gettop(state);
+  size_t index = 0;
+  size_t called = 0;
+  for (; first != last; ++first, ++index) {
+    lua_pushvalue(state, funcindex);
+    int argnum = util::push_args(state, *first);
+    for (int i = 1; i <= extranum; ++i) {
+      lua_pushvalue(state, funcindex + i);
+    }
+    int status = lua_pcall_wrap(state, argnum + extranum,
+                                function_result_count<Result>::value);
+    if (status != 0) {
+      if (!errors) {
+        ErrorHandler::handle(status, state);
+        break;
+      }
+      errors->add(index, status, get_error_message(state));
+      lua_settop(state, top);
+      if (errors->stopOnError()) {
+        break;
+      }
+      continue;
+    }
+    call_each_store(state, top + 1, out, types::typetag<Result>());
+    ++called;
+  }
+  return called;
+}
+
 template <typename Derived> class LuaFunctionImpl {
 private:
   lua_State *state_() const {
@@ -80,13 +210,72 @@ public:
     int argstart = lua_gettop(state) + 1;
     push_(state);
     int argnum = util::push_args(state, std::forward<Args>(args)...);
-    int result = lua_pcall_wrap(state, argnum, LUA_MULTRET);
+    int result = lua_pcall_wrap(
+        state, argnum, detail::function_result_count<Result>::value);
     except::checkErrorAndThrow(result, state);
     return detail::FunctionResultProxy::ReturnValue(state, result, argstart,
                                                     types::typetag<Result>());
   }
 
+  /// @brief call function for each element of [first, last) with extra
+  /// arguments. The first error is reported to the error handler and stops
+  /// the batch.
+  /// @return number of succeeded calls
+  template <class InputIterator, class... Args>
+  size_t callEach(InputIterator first, InputIterator last, Args &&... args) {
+    int out = 0;
+    return callEach_<void>(first, last, out, 0, std::forward<Args>(args)...);
+  }
+  /// @brief callEach with errors collected per element
+  template <class InputIterator, class... Args>
+  size_t callEach(InputIterator first, InputIterator last,
+                  CallEachErrors &errors, Args &&... args) {
+    int out = 0;
+    return callEach_<void>(first, last, out, &errors,
+                           std::forward<Args>(args)...);
+  }
+  /// @brief callEach with results written to out.
+  /// Result must be a value type, not FunctionResults or LuaStackRef.
+  template <class Result, class InputIterator, class OutputIterator,
+            class... Args>
+  OutputIterator callEach(InputIterator first, InputIterator last,
+                          OutputIterator out, Args &&... args) {
+    callEach_<Result>(first, last, out, 0, std::forward<Args>(args)...);
+    return out;
+  }
+  /// @brief callEach with results written to out and errors collected per
+  /// element. Nothing is written for failed elements.
+  template <class Result, class InputIterator, class OutputIterator,
+            class... Args>
+  OutputIterator callEach(InputIterator first, InputIterator last,
+                          OutputIterator out, CallEachErrors &errors,
+                          Args &&... args) {
+    callEach_<Result>(first, last, out, &errors, std::forward<Args>(args)...);
+    return out;
+  }
+
   template <class... Args> FunctionResults operator()(Args &&... args);
+
+private:
+  template <class Result, class InputIterator, class OutputIterator,
+            class... Args>
+  size_t callEach_(InputIterator first, InputIterator last,
+                   OutputIterator &out, CallEachErrors *errors,
+                   Args &&... args) {
+    lua_State *state = state_();
+    if (!state) {
+      except::typeMismatchError(state, "nil");
+      return 0;
+    }
+    util::ScopedSavedStack save(state);
+    int funcindex = lua_gettop(state) + 1;
+    push_(state);
+    int extranum = util::push_args(state, std::forward<Args>(args)...);
+    return call_each<Result>(state, funcindex, extranum, first, last, out,
+                             errors);
+  }
+
+public:
 #else
 
 #define KAGUYA_CALL_DEF(N)                                                     \
@@ -100,7 +289,8 @@ public:
     int argstart = lua_gettop(state) + 1;                                      \
     push_(state);                                                              \
     int argnum = util::push_args(state KAGUYA_PP_ARG_REPEAT_CONCAT(N));        \
-    int result = lua_pcall_wrap(state, argnum, LUA_MULTRET);                   \
+    int result = lua_pcall_wrap(                                               \
+        state, argnum, detail::function_result_count<Result>::value);          \
     except::checkErrorAndThrow(result, state);                                 \
     return detail::FunctionResultProxy::ReturnValue(state, result, argstart,   \
                                                     types::typetag<Result>()); \
@@ -109,6 +299,70 @@ public:
   KAGUYA_CALL_DEF(0)
   KAGUYA_PP_REPEAT_DEF(KAGUYA_FUNCTION_MAX_ARGS, KAGUYA_CALL_DEF)
 
+#define KAGUYA_CALL_EACH_DEF(N)                                                \
+  template <class InputIterator KAGUYA_PP_TEMPLATE_DEF_REPEAT_CONCAT(N)>       \
+  size_t callEach(InputIterator first,                                         \
+                  InputIterator last KAGUYA_PP_ARG_CR_DEF_REPEAT_CONCAT(N)) {  \
+    int out = 0;                                                               \
+    return callEach_<void>(first, last, out,                                   \
+                           0 KAGUYA_PP_ARG_REPEAT_CONCAT(N));                  \
+  }                                                                            \
+  template <class InputIterator KAGUYA_PP_TEMPLATE_DEF_REPEAT_CONCAT(N)>       \
+  size_t callEach(                                                             \
+      InputIterator first, InputIterator last,                                 \
+      CallEachErrors &errors KAGUYA_PP_ARG_CR_DEF_REPEAT_CONCAT(N)) {          \
+    int out = 0;                                                               \
+    return callEach_<void>(first, last, out,                                   \
+                           &errors KAGUYA_PP_ARG_REPEAT_CONCAT(N));            \
+  }                                                                            \
+  template <class Result, class InputIterator,                                 \
+            class OutputIterator KAGUYA_PP_TEMPLATE_DEF_REPEAT_CONCAT(N)>      \
+  OutputIterator callEach(                                                     \
+      InputIterator first, InputIterator last,                                 \
+      OutputIterator out KAGUYA_PP_ARG_CR_DEF_REPEAT_CONCAT(N)) {              \
+    callEach_<Result>(first, last, out, 0 KAGUYA_PP_ARG_REPEAT_CONCAT(N));     \
+    return out;                                                                \
+  }                                                                            \
+  template <class Result, class InputIterator,                                 \
+            class OutputIterator KAGUYA_PP_TEMPLATE_DEF_REPEAT_CONCAT(N)>      \
+  OutputIterator callEach(                                                     \
+      InputIterator first, InputIterator last, OutputIterator out,             \
+      CallEachErrors &errors KAGUYA_PP_ARG_CR_DEF_REPEAT_CONCAT(N)) {          \
+    callEach_<Result>(first, last, out,                                        \
+                      &errors KAGUYA_PP_ARG_REPEAT_CONCAT(N));                 \
+    return out;                                                                \
+  }
+
+  KAGUYA_CALL_EACH_DEF(0)
+  KAGUYA_PP_REPEAT_DEF(KAGUYA_FUNCTION_MAX_ARGS, KAGUYA_CALL_EACH_DEF)
+#undef KAGUYA_CALL_EACH_DEF
+
+private:
+#define KAGUYA_CALL_EACH_IMPL_DEF(N)                                           \
+  template <class Result, class InputIterator,                                 \
+            class OutputIterator KAGUYA_PP_TEMPLATE_DEF_REPEAT_CONCAT(N)>      \
+  size_t callEach_(                                                            \
+      InputIterator first, InputIterator last, OutputIterator &out,            \
+      CallEachErrors *errors KAGUYA_PP_ARG_CR_DEF_REPEAT_CONCAT(N)) {          \
+    lua_State *state = state_();                                               \
+    if (!state) {                                                              \
+      except::typeMismatchError(state, "nil");                                 \
+      return 0;                                                                \
+    }                                                                          \
+    util::ScopedSavedStack save(state);                                        \
+    int funcindex = lua_gettop(state) + 1;                                     \
+    push_(state);                                                              \
+    int extranum = util::push_args(state KAGUYA_PP_ARG_REPEAT_CONCAT(N));      \
+    return call_each<Result>(state, funcindex, extranum, first, last, out,     \
+                             errors);                                          \
+  }
+
+  KAGUYA_CALL_EACH_IMPL_DEF(0)
+  KAGUYA_PP_REPEAT_DEF(KAGUYA_FUNCTION_MAX_ARGS, KAGUYA_CALL_EACH_IMPL_DEF)
+#undef KAGUYA_CALL_EACH_IMPL_DEF
+
+public:
+
 #undef KAGUYA_RESUME_DEF
 
   inline FunctionResults operator()();
@@ -168,6 +422,15 @@ public:
                                                     types::typetag<Result>());
   }
   template <class... Args> FunctionResults operator()(Args &&... args);
+#if KAGUYA_USE_CPP20_COROUTINE
+  /// @brief resume thread from a C++20 coroutine.
+  /// co_await the result to get the values of the next yield or return.
+  /// If the thread is waiting on a kaguya::Task returned from a bound
+  /// function, the awaiting coroutine stays suspended until the task
+  /// finishes and the thread yields again or returns.
+  template <class Result = FunctionResults, class... Args>
+  ResumeAwaiter<Result> resumeAsync(Args &&... args);
+#endif
 #else
 
 #define KAGUYA_RESUME_DEF(N)                                                   \
@@ -14,6 +14,7 @@
 #include "kaguya/error_handler.hpp"
 #include "kaguya/type.hpp"
 #include "kaguya/utility.hpp"
+#include "kaguya/detail/lua_ref_store.hpp"
 
 namespace kaguya {
 /// @brief StackTop tag type
@@ -107,7 +108,80 @@ public:
 /// @brief Reference to Lua value. Retain reference by LUA_REGISTRYINDEX
 class RegistoryRef {
 public:
-#if KAGUYA_USE_SHARED_LUAREF
+#if KAGUYA_USE_REF_STORE
+  struct RefHolder {
+    RefHolder(lua_State *L, int ref)
+        : state_(L), store_(0), slot_(LUA_REFNIL), ref_(ref), generation_(0) {
+      assert(ref == LUA_REFNIL);
+    }
+    RefHolder(lua_State *L, RefStore *store, int slot)
+        : state_(L), store_(store), slot_(slot), ref_(LUA_REFNIL),
+          generation_(0) {
+      if (slot_ != LUA_REFNIL) {
+        ref_ = store_->registry_ref(slot_);
+        generation_ = store_->generation(slot_);
+      }
+    }
+    RefHolder(const RefHolder &src)
+        : state_(src.state_), store_(src.store_), slot_(src.slot_),
+          ref_(src.ref_), generation_(src.generation_) {
+      if (slot_ != LUA_REFNIL) {
+        store_->addref(slot_);
+      }
+    }
+    RefHolder &operator=(const RefHolder &src) {
+      RefHolder copy(src);
+      swap(copy);
+      return *this;
+    }
+#if KAGUYA_USE_RVALUE_REFERENCE
+    RefHolder(RefHolder &&src) throw()
+        : state_(src.state_), store_(src.store_), slot_(src.slot_),
+          ref_(src.ref_), generation_(src.generation_) {
+      src.slot_ = LUA_REFNIL;
+      src.ref_ = LUA_REFNIL;
+    }
+    RefHolder &operator=(RefHolder &&src) throw() {
+      swap(src);
+      return *this;
+    }
+#endif
+    void swap(RefHolder &other) throw() {
+      std::swap(state_, other.state_);
+      std::swap(store_, other.store_);
+      std::swap(slot_, other.slot_);
+      std::swap(ref_, other.ref_);
+      std::swap(generation_, other.generation_);
+    }
+    int ref() const {
+      if (state_) {
+        return ref_;
+      }
+      return LUA_REFNIL;
+    }
+    void push(lua_State *state) const {
+      assert(store_->generation(slot_) == generation_);
+      lua_rawgeti(state, LUA_REGISTRYINDEX, ref_);
+    }
+    void reset() {
+      if (slot_ != LUA_REFNIL && state_) {
+        store_->release(state_, slot_);
+        slot_ = LUA_REFNIL;
+        ref_ = LUA_REFNIL;
+      }
+    }
+    ~RefHolder() { reset(); }
+
+    lua_State *state() const { return state_; }
+
+  private:
+    lua_State *state_;
+    RefStore *store_;
+    int slot_; // slot in store
+    int ref_;  // registry key of slot
+    unsigned int generation_;
+  };
+#elif KAGUYA_USE_SHARED_LUAREF
   struct RefHolder {
     struct RefDeleter {
       RefDeleter(lua_State *L) : state_(L) {}
@@ -143,6 +217,9 @@ public:
       }
       return LUA_REFNIL;
     }
+    void push(lua_State *state) const {
+      lua_rawgeti(state, LUA_REGISTRYINDEX, *ref_);
+    }
     void reset() { ref_.reset(); }
     lua_State *state() const { return state_; }
 
@@ -189,6 +266,9 @@ public:
       }
       return LUA_REFNIL;
     }
+    void push(lua_State *state) const {
+      lua_rawgeti(state, LUA_REGISTRYINDEX, ref_);
+    }
     void reset() {
       if (ref_ != LUA_REFNIL && state_) {
         luaL_unref(state_, LUA_REGISTRYINDEX, ref_);
@@ -219,6 +299,18 @@ public:
       return LUA_REFNIL;
     }
   }
+  // pop stack top of state and hold it by holder_state
+  static RefHolder make_holder(lua_State *holder_state, lua_State *state) {
+#if KAGUYA_USE_REF_STORE
+    if (!state) {
+      return RefHolder(holder_state, LUA_REFNIL);
+    }
+    RefStore *store = RefStore::get(state);
+    return RefHolder(holder_state, store, store->acquire(state));
+#else
+    return RefHolder(holder_state, ref_from_stacktop(state));
+#endif
+  }
 #if KAGUYA_USE_RVALUE_REFERENCE
   RegistoryRef(RegistoryRef &&src) throw() : ref_(0, LUA_REFNIL) { swap(src); }
   RegistoryRef &operator=(RegistoryRef &&src) throw() {
@@ -231,10 +323,10 @@ public:
   RegistoryRef(lua_State *state) : ref_(state, LUA_REFNIL) {}
 
   RegistoryRef(lua_State *state, StackTop, NoMainCheck)
-      : ref_(state, ref_from_stacktop(state)) {}
+      : ref_(make_holder(state, state)) {}
 
   RegistoryRef(lua_State *state, StackTop)
-      : ref_(util::toMainThread(state), ref_from_stacktop(state)) {}
+      : ref_(make_holder(util::toMainThread(state), state)) {}
 
   void swap(RegistoryRef &other) throw() { ref_.swap(other.ref_); }
 
@@ -246,7 +338,7 @@ public:
     }
     util::ScopedSavedStack save(state);
     util::one_push(state, v);
-    ref_ = RefHolder(state, ref_from_stacktop(state));
+    ref_ = make_holder(state, state);
   }
   template <typename T>
   RegistoryRef(lua_State *state, const T &v) : ref_(0, LUA_REFNIL) {
@@ -255,7 +347,7 @@ public:
     }
     util::ScopedSavedStack save(state);
     util::one_push(state, v);
-    ref_ = RefHolder(util::toMainThread(state), ref_from_stacktop(state));
+    ref_ = make_holder(util::toMainThread(state), state);
   }
 #if KAGUYA_USE_CPP11
   template <typename T>
@@ -265,7 +357,7 @@ public:
     }
     util::ScopedSavedStack save(state);
     util::one_push(state, standard::forward<T>(v));
-    ref_ = RefHolder(state, ref_from_stacktop(state));
+    ref_ = make_holder(state, state);
   }
   template <typename T>
   RegistoryRef(lua_State *state, T &&v) : ref_(0, LUA_REFNIL) {
@@ -274,14 +366,18 @@ public:
     }
     util::ScopedSavedStack save(state);
     util::one_push(state, standard::forward<T>(v));
-    ref_ = RefHolder(util::toMainThread(state), ref_from_stacktop(state));
+    ref_ = make_holder(util::toMainThread(state), state);
   }
 #endif
   ~RegistoryRef() {
+#if KAGUYA_NO_EXCEPTIONS
+    unref();
+#else
     try {
       unref();
     } catch (...) {
     } // can't throw at Destructor
+#endif
   }
 
   /// @brief push to Lua stack
@@ -297,7 +393,7 @@ public:
       assert(util::toMainThread(state) == util::toMainThread(ref_.state()));
     }
 #endif
-    lua_rawgeti(state, LUA_REGISTRYINDEX, ref_.ref());
+    ref_.push(state);
     return 1;
   }
 
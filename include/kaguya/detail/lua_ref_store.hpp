@@ -0,0 +1,184 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <vector>
+#include <cassert>
+#include "kaguya/config.hpp"
+
+namespace kaguya {
+namespace Ref {
+/// @brief Per state reference store.
+/// Each slot owns a registry key reserved by luaL_ref once, and released
+/// slots are reused by C++ free-list without luaL_ref/luaL_unref. A released
+/// key holds false, so luaL_ref never hands it out again.
+/// A slot is shared by copied references and is counted in C++, so copy and
+/// destroy do not touch Lua until the last reference is released.
+/// The store outlives lua_close while references to it remain.
+class RefStore {
+public:
+  /// @brief live reference statistics
+  struct Stats {
+    Stats() : live_refs(0), live_handles(0), capacity(0), peak_refs(0) {}
+    size_t live_refs;    //!< slots holding a value
+    size_t live_handles; //!< references (including copies) to the slots
+    size_t capacity;     //!< allocated slots
+    size_t peak_refs;    //!< maximum of live_refs
+  };
+
+  /// @brief get store for state. create if not exists.
+  static RefStore *get(lua_State *state) {
+    RefStore *store = find(state);
+    if (!store) {
+      store = create(state);
+    }
+    return store;
+  }
+  /// @brief get store for state. return null if not exists
+  static RefStore *find(lua_State *state) {
+    push_registry_key(state);
+    lua_rawget(state, LUA_REGISTRYINDEX);
+    RefStore **holder = static_cast<RefStore **>(lua_touserdata(state, -1));
+    lua_pop(state, 1);
+    return holder ? *holder : 0;
+  }
+  /// @brief statistics of store for state
+  static Stats stats(lua_State *state) {
+    RefStore *store = find(state);
+    return store ? store->stats() : Stats();
+  }
+
+  /// @brief pop stack top value and store it.
+  /// @return slot index. LUA_REFNIL if value is nil
+  int acquire(lua_State *state) {
+    if (lua_isnil(state, -1)) {
+      lua_pop(state, 1);
+      return LUA_REFNIL;
+    }
+    int slot = free_head_;
+    if (slot != 0) {
+      Slot &s = slots_[slot - 1];
+      free_head_ = s.next_free;
+      lua_rawseti(state, LUA_REGISTRYINDEX, s.registry_ref);
+    } else {
+      Slot s;
+      s.registry_ref = luaL_ref(state, LUA_REGISTRYINDEX);
+      slots_.push_back(s);
+      slot = static_cast<int>(slots_.size());
+    }
+    Slot &s = slots_[slot - 1];
+    s.refcount = 1;
+    s.next_free = 0;
+
+    ++stats_.live_refs;
+    ++stats_.live_handles;
+    if (stats_.peak_refs < stats_.live_refs) {
+      stats_.peak_refs = stats_.live_refs;
+    }
+    return slot;
+  }
+  /// @brief add reference to slot
+  void addref(int slot) {
+    assert(slot > 0 && slots_[slot - 1].refcount > 0);
+    ++slots_[slot - 1].refcount;
+    ++stats_.live_handles;
+  }
+  /// @brief release reference to slot. value is removed from table when last
+  /// reference is released. store is deleted if it is closed and unused.
+  void release(lua_State *state, int slot) {
+    assert(slot > 0 && slots_[slot - 1].refcount > 0);
+    Slot &s = slots_[slot - 1];
+    --stats_.live_handles;
+    if (--s.refcount == 0) {
+      if (!closed_) {
+        lua_pushboolean(state, 0);
+        lua_rawseti(state, LUA_REGISTRYINDEX, s.registry_ref);
+      }
+      ++s.generation;
+      s.next_free = free_head_;
+      free_head_ = slot;
+      --stats_.live_refs;
+    }
+    if (closed_ && stats_.live_handles == 0) {
+      delete this;
+    }
+  }
+  /// @brief registry key of slot
+  int registry_ref(int slot) const { return slots_[slot - 1].registry_ref; }
+  /// @brief push slot value
+  void push(lua_State *state, int slot) const {
+    lua_rawgeti(state, LUA_REGISTRYINDEX, registry_ref(slot));
+  }
+  /// @brief generation of slot. incremented when slot is released
+  unsigned int generation(int slot) const {
+    return slots_[slot - 1].generation;
+  }
+  bool closed() const { return closed_; }
+  Stats stats() const {
+    Stats result = stats_;
+    result.capacity = slots_.size();
+    return result;
+  }
+
+private:
+  struct Slot {
+    Slot()
+        : registry_ref(LUA_NOREF), refcount(0), generation(0), next_free(0) {}
+    int registry_ref;
+    int refcount;
+    unsigned int generation;
+    int next_free;
+  };
+
+  RefStore() : free_head_(0), closed_(false) {}
+  RefStore(const RefStore &);
+  RefStore &operator=(const RefStore &);
+
+#if KAGUYA_SUPPORT_MULTIPLE_SHARED_LIBRARY
+  static void push_registry_key(lua_State *state) {
+    lua_pushstring(state, "\x80KAGUYA_REF_STORE_REGISTRY_KEY");
+  }
+#else
+  static void push_registry_key(lua_State *state) {
+    static int key;
+    lua_pushlightuserdata(state, &key);
+  }
+#endif
+
+  static RefStore *create(lua_State *state) {
+    RefStore *store = new RefStore();
+    push_registry_key(state);
+    RefStore **holder =
+        static_cast<RefStore **>(lua_newuserdata(state, sizeof(RefStore *)));
+    *holder = store;
+    lua_createtable(state, 0, 1);
+    lua_pushcclosure(state, &close_store, 0);
+    lua_setfield(state, -2, "__gc");
+    lua_setmetatable(state, -2);
+    lua_rawset(state, LUA_REGISTRYINDEX);
+    return store;
+  }
+
+  static int close_store(lua_State *state) {
+    RefStore **holder = static_cast<RefStore **>(lua_touserdata(state, 1));
+    if (holder && *holder) {
+      RefStore *store = *holder;
+      *holder = 0;
+      store->closed_ = true;
+      if (store->stats_.live_handles == 0) {
+        delete store;
+      }
+    }
+    return 0;
+  }
+
+  std::vector<Slot> slots_;
+  int free_head_;
+  bool closed_;
+  Stats stats_;
+};
+}
+}
@@ -20,6 +20,9 @@ class LuaTable;
 template <typename KEY> class TableKeyReferenceProxy;
 class MemberFunctionBinder;
 
+template <typename K, typename V> class TablePairs;
+template <typename V> class TableIPairs;
+
 namespace detail {
 
 struct table_proxy {
@@ -364,6 +367,12 @@ public:
     }
   }
 
+  /// @brief range of table fields for range-based for.
+  /// lighter than foreach_table, no reference is created for each field.
+  template <typename K, typename V> TablePairs<K, V> pairs() const;
+  /// @brief range of sequence table values for range-based for.
+  template <typename V> TableIPairs<V> ipairs() const;
+
   /// @brief If type is table or userdata, return keys.
   /// @return field keys
   template <typename K, typename A> std::vector<K, A> keys() const {
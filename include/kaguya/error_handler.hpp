@@ -11,13 +11,60 @@
 #include "kaguya/type.hpp"
 
 namespace kaguya {
+namespace detail {
+/// registry key of metatable of nativefunction::DeferredArgumentError
+inline void *deferred_argument_error_key() {
+  static int key = 0;
+  return &key;
+}
+/// true if value at index has metatable of DeferredArgumentError
+inline bool is_deferred_argument_error(lua_State *state, int index) {
+  if (!lua_getmetatable(state, index)) {
+    return false;
+  }
+  lua_rawgetp_rtype(state, LUA_REGISTRYINDEX, deferred_argument_error_key());
+  bool result = lua_rawequal(state, -1, -2) != 0;
+  lua_pop(state, 2);
+  return result;
+}
+inline int error_object_tostring(lua_State *state) {
+  if (luaL_callmeta(state, 1, "__tostring") &&
+      lua_type(state, -1) == LUA_TSTRING) {
+    return 1;
+  }
+  return 0;
+}
+}
+
 inline const char *get_error_message(lua_State *state) {
   if (lua_type(state, -1) == LUA_TSTRING) {
     const char *message = lua_tostring(state, -1);
     return message ? message : "unknown error";
+  }
+  if (luaL_getmetafield(state, -1, "__tostring")) {
+    lua_pop(state, 1);
   } else {
     return "unknown error";
   }
+  // error object with __tostring. replace it by message.
+  // __tostring of script can raise error, so it is called in protected mode
+  // unless it is DeferredArgumentError of kaguya
+  if (detail::is_deferred_argument_error(state, -1)) {
+    luaL_callmeta(state, -1, "__tostring");
+  } else {
+    lua_pushcfunction(state, &detail::error_object_tostring);
+    lua_pushvalue(state, -2);
+    if (lua_pcall(state, 1, 1, 0) != 0) {
+      lua_pushnil(state);
+      lua_replace(state, -2);
+    }
+  }
+  if (lua_type(state, -1) == LUA_TSTRING) {
+    lua_replace(state, -2);
+    return lua_tostring(state, -1);
+  }
+  lua_pop(state, 1);
+  return "unknown error";
 }
 inline int lua_pcall_wrap(lua_State *state, int argnum, int retnum) {
   int result = lua_pcall(state, argnum, retnum, 0);
@@ -60,6 +107,12 @@ struct ErrorHandler {
     return function_type();
   }
 
+  /// @brief handler storage of the state, or null if never registered.
+  /// The storage stays at the same address until the state is closed.
+  static function_type *getHandlerPointer(lua_State *state) {
+    return getFunctionPointer(state);
+  }
+
   static void unregisterHandler(lua_State *state) {
     if (state) {
       function_type *funptr = getFunctionPointer(state);
@@ -99,27 +152,27 @@ struct ErrorHandler {
   static void throwDefaultError(int status, const char *message = 0) {
     switch (status) {
     case LUA_ERRSYNTAX:
-      throw LuaSyntaxError(
-          status, message ? std::string(message) : "unknown syntax error");
+      KAGUYA_THROW(LuaSyntaxError(
+          status, message ? std::string(message) : "unknown syntax error"));
     case LUA_ERRRUN:
-      throw LuaRuntimeError(
-          status, message ? std::string(message) : "unknown runtime error");
+      KAGUYA_THROW(LuaRuntimeError(
+          status, message ? std::string(message) : "unknown runtime error"));
     case LUA_ERRMEM:
-      throw LuaMemoryError(status,
+      KAGUYA_THROW(LuaMemoryError(status,
                            message ? std::string(message)
-                                   : "lua memory allocation error");
+                                   : "lua memory allocation error"));
     case LUA_ERRERR:
-      throw LuaErrorRunningError(status,
+      KAGUYA_THROW(LuaErrorRunningError(status,
                                  message ? std::string(message)
-                                         : "unknown error running error");
+                                         : "unknown error running error"));
 #if LUA_VERSION_NUM >= 502
     case LUA_ERRGCMM:
-      throw LuaGCError(status,
-                       message ? std::string(message) : "unknown gc error");
+      KAGUYA_THROW(LuaGCError(status,
+                       message ? std::string(message) : "unknown gc error"));
 #endif
     default:
-      throw LuaUnknownError(
-          status, message ? std::string(message) : "lua unknown error");
+      KAGUYA_THROW(LuaUnknownError(
+          status, message ? std::string(message) : "lua unknown error"));
     }
   }
 
@@ -161,6 +214,41 @@ private:
   }
 };
 
+namespace detail {
+#if KAGUYA_SUPPORT_MULTIPLE_SHARED_LIBRARY
+inline void push_deferred_argument_error_key(lua_State *state) {
+  lua_pushstring(state, "\x80KAGUYA_DEFERRED_ARGUMENT_ERROR_KEY");
+}
+#else
+inline void push_deferred_argument_error_key(lua_State *state) {
+  static int key;
+  lua_pushlightuserdata(state, &key);
+}
+#endif
+}
+
+/// @brief enable or disable deferred argument error mode.
+/// In this mode, argument mismatch of bound function raise lightweight error
+/// object. Error message is built when converted by tostring.
+inline void set_deferred_argument_error(lua_State *state, bool enable) {
+  util::ScopedSavedStack save(state);
+  detail::push_deferred_argument_error_key(state);
+  if (enable) {
+    lua_pushboolean(state, 1);
+  } else {
+    lua_pushnil(state);
+  }
+  lua_rawset(state, LUA_REGISTRYINDEX);
+}
+/// @brief return true if deferred argument error mode is enabled
+inline bool is_deferred_argument_error(lua_State *state) {
+  detail::push_deferred_argument_error_key(state);
+  lua_rawget(state, LUA_REGISTRYINDEX);
+  bool enabled = lua_toboolean(state, -1) != 0;
+  lua_pop(state, 1);
+  return enabled;
+}
+
 namespace except {
 inline void OtherError(lua_State *state, const std::string &message) {
   if (ErrorHandler::handle(message.c_str(), state)) {
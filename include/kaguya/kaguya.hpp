@@ -11,4 +11,12 @@
 #include "kaguya/state.hpp"
 #include "kaguya/lua_ref_table.hpp"
 #include "kaguya/lua_ref_function.hpp"
+#include "kaguya/lua_path.hpp"
+#include "kaguya/prepared_call.hpp"
+#include "kaguya/thread_pool.hpp"
+#include "kaguya/coroutine.hpp"
+#include "kaguya/typed_array.hpp"
+#include "kaguya/byte_buffer.hpp"
+#include "kaguya/serializer.hpp"
 #include "kaguya/ref_tuple.hpp"
+#include "kaguya/binding_set.hpp"
@@ -0,0 +1,177 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "kaguya/config.hpp"
+#include "kaguya/lua_ref.hpp"
+
+namespace kaguya {
+/// @brief Compiled path of nested table keys.
+/// Root table and key strings are kept in one table reference, and the path
+/// is resolved by lua_rawget without metamethods.
+/// e.g.
+/// @code
+/// kaguya::LuaPath timeout(state.globalTable(), "config.net.timeout");
+/// int value = timeout.get<int>(); // config.net.timeout
+/// @endcode
+/// Every access resolves from root, so replaced intermediate tables are
+/// always followed.
+class LuaPath {
+public:
+  /// @brief construct path from dot separated keys. e.g. "config.net.timeout"
+  LuaPath(const LuaTable &root, const std::string &path) : depth_(0) {
+    std::vector<std::string> keys;
+    std::string::size_type begin = 0;
+    while (true) {
+      std::string::size_type end = path.find('.', begin);
+      keys.push_back(path.substr(begin, end - begin));
+      if (end == std::string::npos) {
+        break;
+      }
+      begin = end + 1;
+    }
+    init(root, keys);
+  }
+  /// @brief construct path from key sequence.
+  LuaPath(const LuaTable &root, const std::vector<std::string> &keys)
+      : depth_(0) {
+    init(root, keys);
+  }
+  LuaPath() : depth_(0) {}
+
+  lua_State *state() const { return keys_.state(); }
+  /// @brief number of keys
+  size_t depth() const { return static_cast<size_t>(depth_); }
+
+  /// @brief push leaf value. push nil if path is not reachable
+  int push(lua_State *state) const {
+    if (!state) {
+      return 0;
+    }
+    int top = lua_gettop(state);
+    if (!resolve(state)) {
+      lua_pushnil(state);
+    }
+    lua_replace(state, top + 1);
+    lua_settop(state, top + 1);
+    return 1;
+  }
+  int push() const { return push(state()); }
+
+  /// @brief get leaf value
+  template <typename T> typename lua_type_traits<T>::get_type get() const {
+    lua_State *state = this->state();
+    typedef typename lua_type_traits<T>::get_type get_type;
+    if (!state) {
+      except::typeMismatchError(state, "is nil");
+      return get_type();
+    }
+    util::ScopedSavedStack save(state);
+    if (!resolve(state)) {
+      lua_pushnil(state);
+    }
+    return lua_type_traits<T>::get(state, -1);
+  }
+
+  /// @brief set leaf value. return false if path is not reachable
+  template <typename T> bool set(const T &value) const {
+    lua_State *state = this->state();
+    if (!state || depth_ == 0) {
+      return false;
+    }
+    util::ScopedSavedStack save(state);
+    if (!lua_checkstack(state, 4)) {
+      return false;
+    }
+    int keys = keys_.pushStackIndex(state);
+    if (!push_parent(state, keys)) {
+      return false;
+    }
+    lua_rawgeti(state, keys, depth_ + 1);
+    util::one_push(state, value);
+    lua_rawset(state, -3);
+    return true;
+  }
+
+  /// @brief true if leaf value is nil or path is not reachable
+  bool isNilref() const {
+    lua_State *state = this->state();
+    if (!state) {
+      return true;
+    }
+    util::ScopedSavedStack save(state);
+    return !resolve(state) || lua_isnil(state, -1);
+  }
+
+private:
+  // keys_ table layout
+  // [1] root table, [2...depth+1] keys
+  void init(const LuaTable &root, const std::vector<std::string> &keys) {
+    lua_State *state = root.state();
+    if (!state) {
+      return;
+    }
+    if (root.type() != LUA_TTABLE) {
+      except::typeMismatchError(state, "root is not table");
+      return;
+    }
+    util::ScopedSavedStack save(state);
+    depth_ = static_cast<int>(keys.size());
+    lua_createtable(state, depth_ + 1, 0);
+    root.push(state);
+    lua_rawseti(state, -2, 1);
+    for (int i = 0; i < depth_; ++i) {
+      lua_pushlstring(state, keys[i].data(), keys[i].size());
+      lua_rawseti(state, -2, i + 2);
+    }
+    keys_ = LuaRef(state, StackTop());
+  }
+
+  // push leaf value on top. leaves keys, parent and leaf on stack, caller
+  // restores top.
+  bool resolve(lua_State *state) const {
+    if (depth_ == 0 || !lua_checkstack(state, 4)) {
+      return false;
+    }
+    int keys = keys_.pushStackIndex(state);
+    if (!push_parent(state, keys)) {
+      return false;
+    }
+    lua_rawgeti(state, keys, depth_ + 1);
+    lua_rawget(state, -2);
+    return true;
+  }
+
+  // push table that holds leaf. each level replaces its parent, so one value
+  // is pushed regardless of depth. return false if not reachable
+  bool push_parent(lua_State *state, int keys) const {
+    lua_rawgeti(state, keys, 1);
+    for (int i = 1; i < depth_; ++i) {
+      lua_rawgeti(state, keys, i + 1);
+      lua_rawget(state, -2);
+      lua_replace(state, -2);
+      if (!lua_istable(state, -1)) {
+        return false;
+      }
+    }
+    return lua_istable(state, -1) != 0;
+  }
+
+  LuaRef keys_;
+  int depth_;
+};
+
+/// @ingroup lua_type_traits
+/// @brief lua_type_traits for LuaPath. push leaf value
+template <> struct lua_type_traits<LuaPath> {
+  typedef const LuaPath &push_type;
+  static int push(lua_State *l, push_type path) { return path.push(l); }
+};
+template <>
+struct lua_type_traits<const LuaPath &> : lua_type_traits<LuaPath> {};
+}
@@ -126,14 +126,14 @@ public:
   template <typename T>
   typename lua_type_traits<T>::get_type result_at(size_t index) const {
     if (index >= result_size()) {
-      throw std::out_of_range("function result out of range");
+      KAGUYA_THROW(std::out_of_range("function result out of range"));
     }
     return lua_type_traits<T>::get(state_,
                                    stack_index_ + static_cast<int>(index));
   }
   reference result_at(size_t index) const {
     if (index >= result_size()) {
-      throw std::out_of_range("function result out of range");
+      KAGUYA_THROW(std::out_of_range("function result out of range"));
     }
     return reference(state_, stack_index_ + static_cast<int>(index));
   }
@@ -158,8 +158,15 @@ template <typename RetType>
 inline RetType FunctionResultProxy::ReturnValue(lua_State *state,
                                                 int return_status, int retindex,
                                                 types::typetag<RetType>) {
+  KAGUYA_UNUSED(return_status);
+  util::ScopedSavedStack save(state, retindex - 1);
+  return util::get_result<RetType>(state, retindex);
+}
+inline LuaStackRef
+FunctionResultProxy::ReturnValue(lua_State *state, int return_status,
+                                 int retindex, types::typetag<LuaStackRef>) {
   return FunctionResults(state, return_status, retindex)
-      .get_result(types::typetag<RetType>());
+      .get_result(types::typetag<LuaStackRef>());
 }
 inline FunctionResults
 FunctionResultProxy::ReturnValue(lua_State *state, int return_status,
@@ -7,9 +7,16 @@
 
 #include <vector>
 #include <map>
+#include <deque>
+#include <set>
 #include "kaguya/config.hpp"
+#if KAGUYA_USE_CPP11
+#include <unordered_map>
+#include <unordered_set>
+#endif
 #include "kaguya/lua_ref.hpp"
 #include "kaguya/push_any.hpp"
+#include "kaguya/table_type_check.hpp"
 #include "kaguya/detail/lua_ref_impl.hpp"
 #include "kaguya/detail/lua_table_def.hpp"
 
@@ -66,6 +73,35 @@ public:
     set_class(reg);
   }
 
+  //! register class metatable from static descriptors and set to table
+  template <typename T, typename P>
+  void setClass(const StaticUserdataMetatable<T, P> &reg) {
+    detail::table_proxy::set(state_, table_index_, key_, reg);
+  }
+
+  //! set class table to table. class metatable is registered on first use.
+  //! reg is copied for each call. use lazyClass to share one copy among
+  //! many states
+  template <typename T, typename P>
+  void setLazyClass(const UserdataMetatable<T, P> &reg) {
+    detail::table_proxy::set(state_, table_index_, key_, lazyClass(reg));
+  }
+
+  //! set class table to table. class metatable is registered on first use.
+  //! the prepared metatable is shared, not copied
+  template <typename T, typename M>
+  void setLazyClass(const LazyUserdataMetatable<T, M> &reg) {
+    detail::table_proxy::set(state_, table_index_, key_, reg);
+  }
+
+  //! set class table to table. class metatable is registered on first use
+  template <typename T, typename P>
+  void setLazyClass(const StaticUserdataMetatable<T, P> &reg) {
+    detail::table_proxy::set(
+        state_, table_index_, key_,
+        LazyUserdataMetatable<T, StaticUserdataMetatable<T, P> >(reg));
+  }
+
   //! set function
   template <typename T> void setFunction(T f) {
     detail::table_proxy::set(state_, table_index_, key_, kaguya::function(f));
@@ -301,6 +337,206 @@ template <typename T> std::vector<LuaRef> LuaTableImpl<T>::keys() const {
 template <typename T> std::map<LuaRef, LuaRef> LuaTableImpl<T>::map() const {
   return map<LuaRef, LuaRef>();
 }
+}
+
+/// @brief Range of table fields for range-based for. Key and value are kept
+/// on the stack top and converted by lua_type_traits on dereference.
+/// Loop body must keep the stack balanced.
+/// e.g.
+/// @code
+/// for (auto kv : table.pairs<std::string, int>()) {
+///   std::cout << kv.first << ":" << kv.second << std::endl;
+/// }
+/// @endcode
+template <typename K, typename V> class TablePairs {
+public:
+  typedef typename lua_type_traits<K>::get_type key_type;
+  typedef typename lua_type_traits<V>::get_type mapped_type;
+  typedef std::pair<key_type, mapped_type> value_type;
+
+  struct iterator {
+    iterator() : state_(0), base_(0), key_(0) {}
+    iterator(lua_State *state, int base)
+        : state_(state), base_(base), key_(0) {
+      next();
+    }
+
+    value_type operator*() const {
+      return value_type(lua_type_traits<K>::get(state_, key_),
+                        lua_type_traits<V>::get(state_, base_ + 2));
+    }
+    iterator &operator++() {
+      lua_settop(state_, base_ + 1);
+      next();
+      return *this;
+    }
+    bool operator==(const iterator &other) const {
+      return state_ == other.state_;
+    }
+    bool operator!=(const iterator &other) const { return !(*this == other); }
+
+  private:
+    void next() {
+      if (lua_next(state_, base_) == 0) {
+        state_ = 0;
+        return;
+      }
+      key_ = base_ + 1;
+      // lua_next needs the original key. number key is converted from a
+      // copy kept above the value until the next step
+      if (!traits::is_arithmetic<typename traits::decay<K>::type>::value &&
+          lua_type(state_, key_) == LUA_TNUMBER) {
+        lua_pushvalue(state_, key_);
+        key_ = base_ + 3;
+      }
+    }
+    lua_State *state_;
+    int base_;
+    int key_;
+  };
+
+  TablePairs() : saved_top_(-1) {}
+  explicit TablePairs(const LuaRef &table) : table_(table), saved_top_(-1) {}
+  TablePairs(const TablePairs &src) : table_(src.table_), saved_top_(-1) {}
+  ~TablePairs() {
+    if (saved_top_ >= 0) {
+      lua_settop(table_.state(), saved_top_);
+    }
+  }
+
+  iterator begin() const {
+    lua_State *state = table_.state();
+    if (!state) {
+      return iterator();
+    }
+    int base = push_table(state);
+    lua_pushnil(state);
+    return iterator(state, base);
+  }
+  iterator end() const { return iterator(); }
+
+private:
+  // table is pushed on top, iterator uses slots above it
+  int push_table(lua_State *state) const {
+    if (saved_top_ < 0) {
+      saved_top_ = lua_gettop(state);
+    }
+    lua_settop(state, saved_top_);
+    table_.push(state);
+    return lua_gettop(state);
+  }
+  TablePairs &operator=(const TablePairs &);
+  LuaRef table_;
+  mutable int saved_top_;
+};
+
+/// @brief Range of sequence table values from index 1 to first nil, for
+/// range-based for. Value is read by lua_rawgeti.
+/// e.g.
+/// @code
+/// for (auto iv : table.ipairs<int>()) {
+///   sum += iv.second;
+/// }
+/// @endcode
+template <typename V> class TableIPairs {
+public:
+  typedef typename lua_type_traits<V>::get_type mapped_type;
+  typedef std::pair<size_t, mapped_type> value_type;
+
+  struct iterator {
+    iterator() : state_(0), base_(0), index_(0) {}
+    iterator(lua_State *state, int base)
+        : state_(state), base_(base), index_(0) {
+      ++*this;
+    }
+
+    value_type operator*() const {
+      return value_type(index_, lua_type_traits<V>::get(state_, base_ + 1));
+    }
+    iterator &operator++() {
+      lua_settop(state_, base_);
+      lua_rawgeti(state_, base_, static_cast<luaInt>(++index_));
+      if (lua_isnil(state_, base_ + 1)) {
+        lua_settop(state_, base_);
+        state_ = 0;
+      }
+      return *this;
+    }
+    bool operator==(const iterator &other) const {
+      return state_ == other.state_;
+    }
+    bool operator!=(const iterator &other) const { return !(*this == other); }
+
+  private:
+    lua_State *state_;
+    int base_;
+    size_t index_;
+  };
+
+  TableIPairs() : saved_top_(-1) {}
+  explicit TableIPairs(const LuaRef &table) : table_(table), saved_top_(-1) {}
+  TableIPairs(const TableIPairs &src) : table_(src.table_), saved_top_(-1) {}
+  ~TableIPairs() {
+    if (saved_top_ >= 0) {
+      lua_settop(table_.state(), saved_top_);
+    }
+  }
+
+  iterator begin() const {
+    lua_State *state = table_.state();
+    if (!state) {
+      return iterator();
+    }
+    if (saved_top_ < 0) {
+      saved_top_ = lua_gettop(state);
+    }
+    lua_settop(state, saved_top_);
+    table_.push(state);
+    return iterator(state, lua_gettop(state));
+  }
+  iterator end() const { return iterator(); }
+
+private:
+  TableIPairs &operator=(const TableIPairs &);
+  LuaRef table_;
+  mutable int saved_top_;
+};
+
+namespace detail {
+template <typename T>
+template <typename K, typename V>
+TablePairs<K, V> LuaTableImpl<T>::pairs() const {
+  lua_State *state = state_();
+  if (!state) {
+    except::typeMismatchError(state, "is nil");
+    return TablePairs<K, V>();
+  }
+  util::ScopedSavedStack save(state);
+  int stackIndex = pushStackIndex_(state);
+  if (lua_type(state, stackIndex) != LUA_TTABLE) {
+    except::typeMismatchError(state, "is not table");
+    return TablePairs<K, V>();
+  }
+  lua_pushvalue(state, stackIndex);
+  return TablePairs<K, V>(LuaRef(state, StackTop()));
+}
+template <typename T>
+template <typename V>
+TableIPairs<V> LuaTableImpl<T>::ipairs() const {
+  lua_State *state = state_();
+  if (!state) {
+    except::typeMismatchError(state, "is nil");
+    return TableIPairs<V>();
+  }
+  util::ScopedSavedStack save(state);
+  int stackIndex = pushStackIndex_(state);
+  if (lua_type(state, stackIndex) != LUA_TTABLE) {
+    except::typeMismatchError(state, "is not table");
+    return TableIPairs<V>();
+  }
+  lua_pushvalue(state, stackIndex);
+  return TableIPairs<V>(LuaRef(state, StackTop()));
+}
 
 template <typename T>
 template <typename K>
@@ -387,8 +623,253 @@ template <typename T, size_t S> struct lua_type_traits<std::array<T, S> > {
     }
     return 1;
   }
+  typedef std::array<T, S> &&move_push_type;
+  static int push(lua_State *l, move_push_type v) {
+    lua_createtable(l, int(S), 0);
+    for (size_t i = 0; i < S; ++i) {
+      util::one_push(l, std::move(v[i]));
+      lua_rawseti(l, -2, i + 1);
+    }
+    return 1;
+  }
 };
 #endif
+
+namespace detail {
+/// @brief check table elements by policy.
+/// Check::check(state, key_index, value_index) is called for each element.
+template <typename Check>
+bool check_table_elements(lua_State *state, int index) {
+  if (lua_type(state, index) != LUA_TTABLE) {
+    return false;
+  }
+  TableTypeCheck policy = get_table_type_check(state);
+  size_t limit = policy.limit;
+  switch (policy.policy) {
+  case TableTypeCheck::CHECK_ALL:
+    limit = 0;
+    break;
+  case TableTypeCheck::CHECK_TABLE:
+    return true;
+  default:
+    if (limit == 0) {
+      return true;
+    }
+    break;
+  }
+  index = lua_absindex(state, index);
+  util::ScopedSavedStack save(state);
+  if (policy.policy == TableTypeCheck::CHECK_SAMPLE) {
+    size_t size = lua_rawlen(state, index);
+    if (size > limit) {
+      size_t step = size / limit;
+      for (size_t i = 1; i <= size; i += step) {
+        lua_pushinteger(state, static_cast<lua_Integer>(i));
+        lua_rawgeti(state, index, static_cast<int>(i));
+        if (!lua_isnil(state, -1) && !Check::check(state, -2, -1)) {
+          return false;
+        }
+        lua_pop(state, 2);
+        if (i < size && i + step > size) {
+          i = size - step; // last element is always checked
+        }
+      }
+      return true;
+    }
+  }
+  size_t count = 0;
+  lua_pushnil(state);
+  while (lua_next(state, index) != 0) {
+    lua_pushvalue(state, -2); // backup key
+    if (!Check::check(state, -1, -2)) {
+      return false;
+    }
+    lua_pop(state, 2); // pop key and value
+    if (++count == limit) {
+      break;
+    }
+  }
+  return true;
+}
+}
+
+namespace detail {
+template <typename Container> void reserve_table_size(Container &, size_t) {}
+template <typename T, typename A>
+void reserve_table_size(std::vector<T, A> &c, size_t size) {
+  c.reserve(size);
+}
+
+/// @brief number of all keys in table. lua_rawlen is 0 for table without
+/// sequence part, e.g. string keys
+inline size_t table_entry_count(lua_State *l, int index) {
+  util::ScopedSavedStack save(l);
+  size_t count = 0;
+  lua_pushnil(l);
+  while (lua_next(l, index) != 0) {
+    lua_pop(l, 1);
+    ++count;
+  }
+  return count;
+}
+
+/// @brief reserve container for values of table at index.
+/// sequence part length is used by default
+template <typename Container>
+void reserve_table_entries(lua_State *l, int index, Container &c) {
+  reserve_table_size(c, lua_rawlen(l, index));
+}
+#if KAGUYA_USE_CPP11
+// hash containers rehash on every growth, and a traversal that only counts
+// keys costs less than that
+template <typename K, typename V, typename H, typename E, typename A>
+void reserve_table_entries(lua_State *l, int index,
+                           std::unordered_map<K, V, H, E, A> &c) {
+  c.reserve(table_entry_count(l, index));
+}
+template <typename T, typename H, typename E, typename A>
+void reserve_table_entries(lua_State *l, int index,
+                           std::unordered_set<T, H, E, A> &c) {
+  c.reserve(table_entry_count(l, index));
+}
+#endif
+
+/// @brief read all values in traversal order. size is reserved by
+/// reserve_table_entries
+template <typename T, typename Container>
+void get_table_values(lua_State *l, int index, Container &result) {
+  reserve_table_entries(l, index, result);
+  util::ScopedSavedStack save(l);
+  lua_pushnil(l);
+  while (lua_next(l, index) != 0) {
+    result.insert(result.end(), lua_type_traits<T>::get(l, -1));
+    lua_pop(l, 1);
+  }
+}
+/// @brief read t[1...#t] in order by lua_rawgeti. if a key follows #t in
+/// traversal order, append values of other keys in traversal order. if
+/// t[1...#t] has hole, read all values in traversal order instead.
+/// @note keys placed before #t in traversal order are not seen. that happens
+/// only when the sequence itself lives in the hash part.
+template <typename T, typename Container>
+void get_sequence_values(lua_State *l, int index, Container &result) {
+  size_t size = lua_rawlen(l, index);
+  if (size == 0) {
+    get_table_values<T>(l, index, result);
+    return;
+  }
+  reserve_table_size(result, size);
+  for (size_t i = 1; i <= size; ++i) {
+    lua_rawgeti(l, index, static_cast<int>(i));
+    if (lua_isnil(l, -1)) {
+      lua_pop(l, 1);
+      result.clear();
+      get_table_values<T>(l, index, result);
+      return;
+    }
+    result.insert(result.end(), lua_type_traits<T>::get(l, -1));
+    lua_pop(l, 1);
+  }
+  util::ScopedSavedStack save(l);
+  lua_pushinteger(l, static_cast<lua_Integer>(size));
+  if (lua_next(l, index) == 0) {
+    return; // no key follows #t
+  }
+  lua_pop(l, 2);
+  lua_pushnil(l);
+  while (lua_next(l, index) != 0) {
+    if (lua_type(l, -2) == LUA_TNUMBER) {
+      lua_Number key = lua_tonumber(l, -2);
+      if (key >= 1 && key <= static_cast<lua_Number>(size) &&
+          static_cast<lua_Number>(static_cast<size_t>(key)) == key) {
+        lua_pop(l, 1); // already read
+        continue;
+      }
+    }
+    result.insert(result.end(), lua_type_traits<T>::get(l, -1));
+    lua_pop(l, 1);
+  }
+}
+/// @brief read key value pairs. size is reserved by reserve_table_entries
+template <typename K, typename V, typename Map>
+void get_table_map(lua_State *l, int index, Map &result) {
+  reserve_table_entries(l, index, result);
+  util::ScopedSavedStack save(l);
+  lua_pushnil(l);
+  while (lua_next(l, index) != 0) {
+    lua_pushvalue(l, -2); // backup key
+    result[lua_type_traits<K>::get(l, -1)] = lua_type_traits<V>::get(l, -2);
+    lua_pop(l, 2); // pop key and value
+  }
+}
+template <typename Container>
+int push_sequence_table(lua_State *l, const Container &v) {
+  lua_createtable(l, int(v.size()), 0);
+  int count = 1; // array is 1 origin in Lua
+  for (typename Container::const_iterator it = v.begin(); it != v.end();
+       ++it) {
+    util::one_push(l, *it);
+    lua_rawseti(l, -2, count++);
+  }
+  return 1;
+}
+template <typename Map> int push_map_table(lua_State *l, const Map &v) {
+  lua_createtable(l, 0, int(v.size()));
+  for (typename Map::const_iterator it = v.begin(); it != v.end(); ++it) {
+    util::one_push(l, it->first);
+    util::one_push(l, it->second);
+    lua_rawset(l, -3);
+  }
+  return 1;
+}
+#if KAGUYA_USE_CPP11
+template <typename Container>
+int move_push_sequence_table(lua_State *l, Container &v) {
+  lua_createtable(l, int(v.size()), 0);
+  int count = 1; // array is 1 origin in Lua
+  for (typename Container::iterator it = v.begin(); it != v.end(); ++it) {
+    util::one_push(l, static_cast<typename Container::value_type &&>(*it));
+    lua_rawseti(l, -2, count++);
+  }
+  return 1;
+}
+template <typename Map> int move_push_map_table(lua_State *l, Map &v) {
+  lua_createtable(l, 0, int(v.size()));
+  for (auto &e : v) {
+    util::one_push(l, e.first);
+    util::one_push(l, std::move(e.second));
+    lua_rawset(l, -3);
+  }
+  return 1;
+}
+#endif
+
+template <typename T> struct sequence_element_check {
+  static bool check(lua_State *l, int k, int v) {
+    return lua_type_traits<size_t>::strictCheckType(l, k) &&
+           lua_type_traits<T>::checkType(l, v);
+  }
+};
+template <typename T> struct sequence_element_strict_check {
+  static bool check(lua_State *l, int k, int v) {
+    return lua_type_traits<size_t>::strictCheckType(l, k) &&
+           lua_type_traits<T>::strictCheckType(l, v);
+  }
+};
+template <typename K, typename V> struct map_element_check {
+  static bool check(lua_State *l, int k, int v) {
+    return lua_type_traits<K>::checkType(l, k) &&
+           lua_type_traits<V>::checkType(l, v);
+  }
+};
+template <typename K, typename V> struct map_element_strict_check {
+  static bool check(lua_State *l, int k, int v) {
+    return lua_type_traits<K>::strictCheckType(l, k) &&
+           lua_type_traits<V>::strictCheckType(l, v);
+  }
+};
+}
+
 #ifndef KAGUYA_NO_STD_VECTOR_TO_TABLE
 
 /// @ingroup lua_type_traits
@@ -396,44 +877,14 @@ template <typename T, size_t S> struct lua_type_traits<std::array<T, S> > {
 template <typename T, typename A> struct lua_type_traits<std::vector<T, A> > {
   typedef std::vector<T, A> get_type;
   typedef const std::vector<T, A> &push_type;
-  struct checkTypeForEach {
-    checkTypeForEach(bool &valid) : valid_(valid) {}
-    bool &valid_;
-    bool operator()(const LuaStackRef &k, const LuaStackRef &v) {
-      valid_ = k.typeTest<size_t>() && v.weakTypeTest<T>();
-      return valid_;
-    }
-  };
-  struct strictCheckTypeForEach {
-    strictCheckTypeForEach(bool &valid) : valid_(valid) {}
-    bool &valid_;
-    bool operator()(const LuaStackRef &k, const LuaStackRef &v) {
-      valid_ = k.typeTest<size_t>() && v.typeTest<T>();
-      return valid_;
-    }
-  };
 
   static bool checkType(lua_State *l, int index) {
-    LuaStackRef table(l, index);
-    if (table.type() != LuaRef::TYPE_TABLE) {
-      return false;
-    }
-
-    bool valid = true;
-    table.foreach_table_breakable<LuaStackRef, LuaStackRef>(
-        checkTypeForEach(valid));
-    return valid;
+    return detail::check_table_elements<detail::sequence_element_check<T> >(
+        l, index);
   }
   static bool strictCheckType(lua_State *l, int index) {
-    LuaStackRef table(l, index);
-    if (table.type() != LuaRef::TYPE_TABLE) {
-      return false;
-    }
-
-    bool valid = true;
-    table.foreach_table_breakable<LuaStackRef, LuaStackRef>(
-        strictCheckTypeForEach(valid));
-    return valid;
+    return detail::check_table_elements<
+        detail::sequence_element_strict_check<T> >(l, index);
   }
 
   static get_type get(lua_State *l, int index) {
@@ -441,30 +892,18 @@ template <typename T, typename A> struct lua_type_traits<std::vector<T, A> > {
       except::typeMismatchError(l, std::string("type mismatch"));
       return get_type();
     }
-    return LuaStackRef(l, index).values<T>();
+    get_type result;
+    detail::get_sequence_values<T>(l, lua_absindex(l, index), result);
+    return result;
   }
 #if KAGUYA_USE_CPP11
   typedef std::vector<T, A> &&move_push_type;
   static int push(lua_State *l, move_push_type v) {
-    lua_createtable(l, int(v.size()), 0);
-    int count = 1; // array is 1 origin in Lua
-    for (typename std::vector<T, A>::iterator it = v.begin(); it != v.end();
-         ++it) {
-      util::one_push(l, static_cast<T &&>(*it));
-      lua_rawseti(l, -2, count++);
-    }
-    return 1;
+    return detail::move_push_sequence_table(l, v);
   }
 #endif
   static int push(lua_State *l, push_type v) {
-    lua_createtable(l, int(v.size()), 0);
-    int count = 1; // array is 1 origin in Lua
-    for (typename std::vector<T, A>::const_iterator it = v.begin();
-         it != v.end(); ++it) {
-      util::one_push(l, static_cast<const T &>(*it));
-      lua_rawseti(l, -2, count++);
-    }
-    return 1;
+    return detail::push_sequence_table(l, v);
   }
 };
 #endif
@@ -477,64 +916,228 @@ struct lua_type_traits<std::map<K, V, C, A> > {
   typedef std::map<K, V, C, A> get_type;
   typedef const std::map<K, V, C, A> &push_type;
 
-  struct checkTypeForEach {
-    checkTypeForEach(bool &valid) : valid_(valid) {}
-    bool &valid_;
-    bool operator()(const LuaStackRef &k, const LuaStackRef &v) {
-      valid_ = k.weakTypeTest<K>() && v.weakTypeTest<V>();
-      return valid_;
+  static bool checkType(lua_State *l, int index) {
+    return detail::check_table_elements<detail::map_element_check<K, V> >(
+        l, index);
+  }
+  static bool strictCheckType(lua_State *l, int index) {
+    return detail::check_table_elements<
+        detail::map_element_strict_check<K, V> >(l, index);
+  }
+
+  static get_type get(lua_State *l, int index) {
+    if (lua_type(l, index) != LUA_TTABLE) {
+      except::typeMismatchError(l, std::string("type mismatch"));
+      return get_type();
     }
-  };
-  struct strictCheckTypeForEach {
-    strictCheckTypeForEach(bool &valid) : valid_(valid) {}
-    bool &valid_;
-    bool operator()(const LuaStackRef &k, const LuaStackRef &v) {
-      valid_ = k.typeTest<K>() && v.typeTest<V>();
-      return valid_;
+    return LuaStackRef(l, index).map<K, V>();
+  }
+#if KAGUYA_USE_CPP11
+  typedef std::map<K, V, C, A> &&move_push_type;
+  static int push(lua_State *l, move_push_type v) {
+    return detail::move_push_map_table(l, v);
+  }
+#endif
+  static int push(lua_State *l, push_type v) {
+    return detail::push_map_table(l, v);
+  }
+};
+#endif
+
+#ifndef KAGUYA_NO_STD_CONTAINER_TO_TABLE
+/// @ingroup lua_type_traits
+/// @brief lua_type_traits for std::deque<T, A>. same as std::vector
+template <typename T, typename A> struct lua_type_traits<std::deque<T, A> > {
+  typedef std::deque<T, A> get_type;
+  typedef const std::deque<T, A> &push_type;
+
+  static bool checkType(lua_State *l, int index) {
+    return detail::check_table_elements<detail::sequence_element_check<T> >(
+        l, index);
+  }
+  static bool strictCheckType(lua_State *l, int index) {
+    return detail::check_table_elements<
+        detail::sequence_element_strict_check<T> >(l, index);
+  }
+  static get_type get(lua_State *l, int index) {
+    if (lua_type(l, index) != LUA_TTABLE) {
+      except::typeMismatchError(l, std::string("type mismatch"));
+      return get_type();
     }
-  };
+    get_type result;
+    detail::get_sequence_values<T>(l, lua_absindex(l, index), result);
+    return result;
+  }
+#if KAGUYA_USE_CPP11
+  typedef std::deque<T, A> &&move_push_type;
+  static int push(lua_State *l, move_push_type v) {
+    return detail::move_push_sequence_table(l, v);
+  }
+#endif
+  static int push(lua_State *l, push_type v) {
+    return detail::push_sequence_table(l, v);
+  }
+};
+
+/// @ingroup lua_type_traits
+/// @brief lua_type_traits for std::set<T, C, A>.
+/// pushed as sequence table, and gets all values of table.
+template <typename T, typename C, typename A>
+struct lua_type_traits<std::set<T, C, A> > {
+  typedef std::set<T, C, A> get_type;
+  typedef const std::set<T, C, A> &push_type;
+
   static bool checkType(lua_State *l, int index) {
-    LuaStackRef table(l, index);
-    if (table.type() != LuaRef::TYPE_TABLE) {
-      return false;
+    return detail::check_table_elements<detail::map_element_check<void, T> >(
+        l, index);
+  }
+  static bool strictCheckType(lua_State *l, int index) {
+    return detail::check_table_elements<
+        detail::map_element_strict_check<void, T> >(l, index);
+  }
+  static get_type get(lua_State *l, int index) {
+    if (lua_type(l, index) != LUA_TTABLE) {
+      except::typeMismatchError(l, std::string("type mismatch"));
+      return get_type();
     }
+    get_type result;
+    detail::get_table_values<T>(l, lua_absindex(l, index), result);
+    return result;
+  }
+  static int push(lua_State *l, push_type v) {
+    return detail::push_sequence_table(l, v);
+  }
+};
 
-    bool valid = true;
-    table.foreach_table_breakable<LuaStackRef, LuaStackRef>(
-        checkTypeForEach(valid));
-    return valid;
+/// @ingroup lua_type_traits
+/// @brief lua_type_traits for std::pair<T1, T2>. table of {first, second}
+template <typename T1, typename T2> struct lua_type_traits<std::pair<T1, T2> > {
+  typedef std::pair<T1, T2> get_type;
+  typedef const std::pair<T1, T2> &push_type;
+
+  static bool checkType(lua_State *l, int index) {
+    if (lua_type(l, index) != LUA_TTABLE) {
+      return false;
+    }
+    util::ScopedSavedStack save(l);
+    index = lua_absindex(l, index);
+    lua_rawgeti(l, index, 1);
+    lua_rawgeti(l, index, 2);
+    return lua_type_traits<T1>::checkType(l, -2) &&
+           lua_type_traits<T2>::checkType(l, -1);
   }
   static bool strictCheckType(lua_State *l, int index) {
-    LuaStackRef table(l, index);
-    if (table.type() != LuaRef::TYPE_TABLE) {
+    if (lua_type(l, index) != LUA_TTABLE) {
       return false;
     }
-
-    bool valid = true;
-    table.foreach_table_breakable<LuaStackRef, LuaStackRef>(
-        strictCheckTypeForEach(valid));
-    return valid;
+    util::ScopedSavedStack save(l);
+    index = lua_absindex(l, index);
+    lua_rawgeti(l, index, 1);
+    lua_rawgeti(l, index, 2);
+    return lua_type_traits<T1>::strictCheckType(l, -2) &&
+           lua_type_traits<T2>::strictCheckType(l, -1);
+  }
+  static get_type get(lua_State *l, int index) {
+    if (lua_type(l, index) != LUA_TTABLE) {
+      except::typeMismatchError(l, std::string("type mismatch"));
+      return get_type();
+    }
+    util::ScopedSavedStack save(l);
+    index = lua_absindex(l, index);
+    lua_rawgeti(l, index, 1);
+    lua_rawgeti(l, index, 2);
+    return get_type(lua_type_traits<T1>::get(l, -2),
+                    lua_type_traits<T2>::get(l, -1));
+  }
+#if KAGUYA_USE_CPP11
+  typedef std::pair<T1, T2> &&move_push_type;
+  static int push(lua_State *l, move_push_type v) {
+    lua_createtable(l, 2, 0);
+    util::one_push(l, std::move(v.first));
+    lua_rawseti(l, -2, 1);
+    util::one_push(l, std::move(v.second));
+    lua_rawseti(l, -2, 2);
+    return 1;
   }
+#endif
+  static int push(lua_State *l, push_type v) {
+    lua_createtable(l, 2, 0);
+    util::one_push(l, v.first);
+    lua_rawseti(l, -2, 1);
+    util::one_push(l, v.second);
+    lua_rawseti(l, -2, 2);
+    return 1;
+  }
+};
 
+#if KAGUYA_USE_CPP11
+/// @ingroup lua_type_traits
+/// @brief lua_type_traits for std::unordered_map<K, V, H, E, A>.
+/// get reserves by number of keys. Lua does not expose it for hash part, so
+/// keys are counted by an extra traversal before conversion.
+template <typename K, typename V, typename H, typename E, typename A>
+struct lua_type_traits<std::unordered_map<K, V, H, E, A> > {
+  typedef std::unordered_map<K, V, H, E, A> get_type;
+  typedef const std::unordered_map<K, V, H, E, A> &push_type;
+  typedef std::unordered_map<K, V, H, E, A> &&move_push_type;
+
+  static bool checkType(lua_State *l, int index) {
+    return detail::check_table_elements<detail::map_element_check<K, V> >(
+        l, index);
+  }
+  static bool strictCheckType(lua_State *l, int index) {
+    return detail::check_table_elements<
+        detail::map_element_strict_check<K, V> >(l, index);
+  }
   static get_type get(lua_State *l, int index) {
     if (lua_type(l, index) != LUA_TTABLE) {
       except::typeMismatchError(l, std::string("type mismatch"));
       return get_type();
     }
-    return LuaStackRef(l, index).map<K, V>();
+    get_type result;
+    detail::get_table_map<K, V>(l, lua_absindex(l, index), result);
+    return result;
+  }
+  static int push(lua_State *l, move_push_type v) {
+    return detail::move_push_map_table(l, v);
   }
   static int push(lua_State *l, push_type v) {
-    lua_createtable(l, 0, int(v.size()));
-    for (typename std::map<K, V, C, A>::const_iterator it = v.begin();
-         it != v.end(); ++it) {
-      util::one_push(l, it->first);
-      util::one_push(l, it->second);
-      lua_rawset(l, -3);
+    return detail::push_map_table(l, v);
+  }
+};
+
+/// @ingroup lua_type_traits
+/// @brief lua_type_traits for std::unordered_set<T, H, E, A>.
+/// pushed as sequence table, and gets all values of table. get reserves by
+/// number of keys counted by an extra traversal, as std::unordered_map.
+template <typename T, typename H, typename E, typename A>
+struct lua_type_traits<std::unordered_set<T, H, E, A> > {
+  typedef std::unordered_set<T, H, E, A> get_type;
+  typedef const std::unordered_set<T, H, E, A> &push_type;
+
+  static bool checkType(lua_State *l, int index) {
+    return detail::check_table_elements<detail::map_element_check<void, T> >(
+        l, index);
+  }
+  static bool strictCheckType(lua_State *l, int index) {
+    return detail::check_table_elements<
+        detail::map_element_strict_check<void, T> >(l, index);
+  }
+  static get_type get(lua_State *l, int index) {
+    if (lua_type(l, index) != LUA_TTABLE) {
+      except::typeMismatchError(l, std::string("type mismatch"));
+      return get_type();
     }
-    return 1;
+    get_type result;
+    detail::get_table_values<T>(l, lua_absindex(l, index), result);
+    return result;
+  }
+  static int push(lua_State *l, push_type v) {
+    return detail::push_sequence_table(l, v);
   }
 };
 #endif
+#endif
 
 struct TableDataElement {
   typedef std::pair<AnyDataPusher, AnyDataPusher> keyvalue_type;
@@ -566,7 +1169,13 @@ struct TableData {
 /// @brief lua_type_traits for TableData
 template <> struct lua_type_traits<TableData> {
   static int push(lua_State *l, const TableData &list) {
-    lua_createtable(l, int(list.elements.size()), int(list.elements.size()));
+    int narr = 0;
+    for (std::vector<TableDataElement>::const_iterator it =
+             list.elements.begin();
+         it != list.elements.end(); ++it) {
+      narr += it->keyvalue.first.empty() ? 1 : 0;
+    }
+    lua_createtable(l, narr, int(list.elements.size()) - narr);
     int count = 1; // array is 1 origin in Lua
     for (std::vector<TableDataElement>::const_iterator it =
              list.elements.begin();
@@ -257,8 +257,44 @@ inline void setMultipleBase(lua_State *state, int metatable_index,
              newmetaindex); // newmeta["__index"] = multiple_base_index_function
   lua_setmetatable(state, metatable_index); // metatable.setMetatable(newmeta);
 }
+
+inline void setIndexMetamethods(lua_State *state, int metatable_index,
+                                bool need_property_access, bool has_index,
+                                bool has_newindex) {
+  if (need_property_access) {
+    if (!has_index) {
+      setPropertyIndexMetamethod(state, metatable_index);
+    }
+    if (!has_newindex) {
+      setPropertyNewIndexMetamethod(state, metatable_index);
+    }
+  } else if (!has_index) {
+    lua_pushstring(state, "__index");
+    lua_pushvalue(state, metatable_index);
+    lua_rawset(state, metatable_index);
+  }
+}
+
+inline void setCallConstructorMetamethod(lua_State *state,
+                                         int metatable_index) {
+  if (lua_getmetatable(state, metatable_index)) // get base_metatable
+  {
+    lua_pushstring(state, "__call");
+    lua_pushcfunction(state, &call_constructor_function);
+    lua_rawset(state, -3); // base_metatable["__call"] =
+                           // Metatable::call_constructor_function
+  } else {
+    get_call_constructor_metatable(state);
+    lua_setmetatable(state, metatable_index);
+  }
+}
 }
 
+template <typename class_type, typename base_class_type>
+class StaticUserdataMetatable;
+template <typename class_type, typename base_class_type>
+class PreparedUserdataMetatable;
+
 /// class binding interface.
 template <typename class_type, typename base_class_type = void>
 class UserdataMetatable {
@@ -285,50 +321,35 @@ public:
   }
 
   bool pushCreateMetatable(lua_State *state) const {
-    if (!class_userdata::newmetatable<class_type>(state)) {
+    // __name, name key, __index and __newindex
+    int nrec = static_cast<int>(member_map_.size() + property_map_.size() + 4);
+    if (!class_userdata::newmetatable<class_type>(state, nrec)) {
       except::OtherError(state,
                          typeid(class_type *).name() +
                              std::string(" is already registered"));
       return false;
     }
-    int metatable_index = lua_gettop(state);
+    fillMetatable(state, lua_gettop(state));
+    return true;
+  }
+
+  /// @brief set members to registered metatable at metatable_index.
+  void fillMetatable(lua_State *state, int metatable_index) const {
     Metatable::setMembers(state, metatable_index, member_map_, property_map_);
 
-    if (!traits::is_same<base_class_type, void>::value ||
-        !property_map_.empty()) // if base class has property and derived class
-                                // hasnt property. need property access
-                                // metamethod
-    {
-      if (member_map_.count("__index") == 0) {
-        Metatable::setPropertyIndexMetamethod(state, metatable_index);
-      }
-
-      if (member_map_.count("__newindex") == 0) {
-        Metatable::setPropertyNewIndexMetamethod(state, metatable_index);
-      }
-    } else {
-      if (member_map_.count("__index") == 0) {
-        lua_pushstring(state, "__index");
-        lua_pushvalue(state, metatable_index);
-        lua_rawset(state, metatable_index);
-      }
-    }
+    // if base class has property and derived class hasnt property. need
+    // property access metamethod
+    Metatable::setIndexMetamethods(
+        state, metatable_index, !traits::is_same<base_class_type, void>::value ||
+                                    !property_map_.empty(),
+        member_map_.count("__index") != 0,
+        member_map_.count("__newindex") != 0);
 
     set_base_metatable(state, metatable_index,
                        types::typetag<base_class_type>());
 
-    if (lua_getmetatable(state, metatable_index)) // get base_metatable
-    {
-      lua_pushstring(state, "__call");
-      lua_pushcfunction(state, &Metatable::call_constructor_function);
-      lua_rawset(state, -3); // base_metatable["__call"] =
-                             // Metatable::call_constructor_function
-    } else {
-      Metatable::get_call_constructor_metatable(state);
-      lua_setmetatable(state, metatable_index);
-    }
+    Metatable::setCallConstructorMetamethod(state, metatable_index);
     lua_settop(state, metatable_index);
-    return true;
   }
   LuaTable createMatatable(lua_State *state) const {
     util::ScopedSavedStack save(state);
@@ -367,7 +388,8 @@ public:
   template <typename Ret>
   UserdataMetatable &addProperty(const char *name, Ret class_type::*mem) {
     if (has_key(name)) {
-      throw KaguyaException(std::string(name) + " is already registered.");
+      KAGUYA_THROW(
+          KaguyaException(std::string(name) + " is already registered."));
       return *this;
     }
     property_map_[name] = AnyDataPusher(kaguya::function(mem));
@@ -381,7 +403,8 @@ public:
   UserdataMetatable &addProperty(const char *name,
                                  GetType (class_type::*getter)() const) {
     if (has_key(name)) {
-      throw KaguyaException(std::string(name) + " is already registered.");
+      KAGUYA_THROW(
+          KaguyaException(std::string(name) + " is already registered."));
       return *this;
     }
     property_map_[name] = AnyDataPusher(kaguya::function(getter));
@@ -396,7 +419,8 @@ public:
   UserdataMetatable &addProperty(const char *name,
                                  GetType (*getter)(const class_type *)) {
     if (has_key(name)) {
-      throw KaguyaException(std::string(name) + " is already registered.");
+      KAGUYA_THROW(
+          KaguyaException(std::string(name) + " is already registered."));
       return *this;
     }
     property_map_[name] = AnyDataPusher(function(getter));
@@ -410,7 +434,8 @@ public:
   UserdataMetatable &addProperty(const char *name,
                                  GetType (*getter)(const class_type &)) {
     if (has_key(name)) {
-      throw KaguyaException(std::string(name) + " is already registered.");
+      KAGUYA_THROW(
+          KaguyaException(std::string(name) + " is already registered."));
       return *this;
     }
     property_map_[name] = AnyDataPusher(function(getter));
@@ -426,7 +451,8 @@ public:
                                  GetType (class_type::*getter)() const,
                                  void (class_type::*setter)(SetType)) {
     if (has_key(name)) {
-      throw KaguyaException(std::string(name) + " is already registered.");
+      KAGUYA_THROW(
+          KaguyaException(std::string(name) + " is already registered."));
       return *this;
     }
     property_map_[name] = AnyDataPusher(overload(getter, setter));
@@ -443,7 +469,8 @@ public:
                                  GetType (*getter)(const class_type *),
                                  void (*setter)(class_type *, SetType)) {
     if (has_key(name)) {
-      throw KaguyaException(std::string(name) + " is already registered.");
+      KAGUYA_THROW(
+          KaguyaException(std::string(name) + " is already registered."));
       return *this;
     }
     property_map_[name] = AnyDataPusher(overload(getter, setter));
@@ -460,7 +487,8 @@ public:
                                  GetType (*getter)(const class_type &),
                                  void (*setter)(class_type &, SetType)) {
     if (has_key(name)) {
-      throw KaguyaException(std::string(name) + " is already registered.");
+      KAGUYA_THROW(
+          KaguyaException(std::string(name) + " is already registered."));
       return *this;
     }
     property_map_[name] = AnyDataPusher(overload(getter, setter));
@@ -473,7 +501,8 @@ public:
   template <typename GetterType>
   UserdataMetatable &addPropertyAny(const char *name, GetterType getter) {
     if (has_key(name)) {
-      throw KaguyaException(std::string(name) + " is already registered.");
+      KAGUYA_THROW(
+          KaguyaException(std::string(name) + " is already registered."));
       return *this;
     }
     property_map_[name] = AnyDataPusher(function(getter));
@@ -487,7 +516,8 @@ public:
   UserdataMetatable &addPropertyAny(const char *name, GetterType getter,
                                     SetterType setter) {
     if (has_key(name)) {
-      throw KaguyaException(std::string(name) + " is already registered.");
+      KAGUYA_THROW(
+          KaguyaException(std::string(name) + " is already registered."));
       return *this;
     }
     property_map_[name] = AnyDataPusher(overload(getter, setter));
@@ -500,7 +530,8 @@ public:
   template <typename Fun>
   UserdataMetatable &addStaticFunction(const char *name, Fun f) {
     if (has_key(name)) {
-      throw KaguyaException(std::string(name) + " is already registered.");
+      KAGUYA_THROW(
+          KaguyaException(std::string(name) + " is already registered."));
       return *this;
     }
     member_map_[name] = AnyDataPusher(kaguya::function(f));
@@ -514,7 +545,8 @@ public:
   template <typename... Funcs>
   UserdataMetatable &addOverloadedFunctions(const char *name, Funcs... f) {
     if (has_key(name)) {
-      throw KaguyaException(std::string(name) + " is already registered.");
+      KAGUYA_THROW(
+          KaguyaException(std::string(name) + " is already registered."));
       return *this;
     }
 
@@ -529,7 +561,8 @@ public:
   template <typename Data>
   UserdataMetatable &addStaticField(const char *name, Data &&d) {
     if (has_key(name)) {
-      throw KaguyaException(std::string(name) + " is already registered.");
+      KAGUYA_THROW(
+          KaguyaException(std::string(name) + " is already registered."));
       return *this;
     }
     member_map_[name] = AnyDataPusher(std::forward<Data>(d));
@@ -542,7 +575,8 @@ public:
   inline UserdataMetatable &addOverloadedFunctions(                            \
       const char *name, KAGUYA_PP_ARG_CR_DEF_REPEAT(N)) {                      \
     if (has_key(name)) {                                                       \
-      throw KaguyaException(std::string(name) + " is already registered.");    \
+      KAGUYA_THROW(KaguyaException(std::string(name) +                        \
+                                   " is already registered."));                \
       return *this;                                                            \
     }                                                                          \
     member_map_[name] =                                                        \
@@ -560,7 +594,8 @@ public:
   template <typename Data>
   UserdataMetatable &addStaticField(const char *name, const Data &d) {
     if (has_key(name)) {
-      throw KaguyaException(std::string(name) + " is already registered.");
+      KAGUYA_THROW(
+          KaguyaException(std::string(name) + " is already registered."));
       return *this;
     }
     member_map_[name] = AnyDataPusher(d);
@@ -573,9 +608,10 @@ public:
   template <typename Fun>
   UserdataMetatable &addFunction(const char *name, Fun f) {
     if (has_key(name)) {
-      throw KaguyaException(std::string(name) + " is already registered. To "
-                                                "overload a function, use "
-                                                "addOverloadedFunctions");
+      KAGUYA_THROW(KaguyaException(std::string(name) +
+                                   " is already registered. To "
+                                   "overload a function, use "
+                                   "addOverloadedFunctions"));
       return *this;
     }
     member_map_[name] = AnyDataPusher(kaguya::function(f));
@@ -588,9 +624,10 @@ public:
   template <typename Ret>
   UserdataMetatable &addFunction(const char *name, Ret class_type::*f) {
     if (has_key(name)) {
-      throw KaguyaException(std::string(name) + " is already registered. To "
-                                                "overload a function, use "
-                                                "addOverloadedFunctions");
+      KAGUYA_THROW(KaguyaException(std::string(name) +
+                                   " is already registered. To "
+                                   "overload a function, use "
+                                   "addOverloadedFunctions"));
       return *this;
     }
     member_map_[name] = AnyDataPusher(kaguya::function(f));
@@ -602,9 +639,10 @@ public:
   /// @param f member function object.
   UserdataMetatable &addFunction(const char *name, PolymorphicMemberInvoker f) {
     if (has_key(name)) {
-      throw KaguyaException(std::string(name) + " is already registered. To "
-                                                "overload a function, use "
-                                                "addOverloadedFunctions");
+      KAGUYA_THROW(KaguyaException(std::string(name) +
+                                   " is already registered. To "
+                                   "overload a function, use "
+                                   "addOverloadedFunctions"));
       return *this;
     }
     member_map_[name] = AnyDataPusher(kaguya::function(f));
@@ -612,10 +650,13 @@ public:
   }
 
 private:
-  void set_base_metatable(lua_State *, int, types::typetag<void>) const {}
+  template <typename, typename> friend class StaticUserdataMetatable;
+  template <typename, typename> friend class PreparedUserdataMetatable;
+
+  static void set_base_metatable(lua_State *, int, types::typetag<void>) {}
   template <class Base>
-  void set_base_metatable(lua_State *state, int metatable_index,
-                          types::typetag<Base>) const {
+  static void set_base_metatable(lua_State *state, int metatable_index,
+                                 types::typetag<Base>) {
     class_userdata::get_metatable<Base>(state);
     lua_setmetatable(state,
                      metatable_index); // metatable.setMetatable(newmeta);
@@ -626,18 +667,18 @@ private:
 #if KAGUYA_USE_CPP11
 
   template <typename Base>
-  void metatables(lua_State *state, int metabase_array_index,
-                  PointerConverter &pvtreg,
-                  types::typetag<MultipleBase<Base> >) const {
+  static void metatables(lua_State *state, int metabase_array_index,
+                         PointerConverter &pvtreg,
+                         types::typetag<MultipleBase<Base> >) {
     class_userdata::get_metatable<Base>(state);
     lua_rawseti(state, metabase_array_index,
                 lua_rawlen(state, metabase_array_index) + 1);
     pvtreg.add_type_conversion<Base, class_type>();
   }
   template <typename Base, typename... Remain>
-  void metatables(lua_State *state, int metabase_array_index,
-                  PointerConverter &pvtreg,
-                  types::typetag<MultipleBase<Base, Remain...> >) const {
+  static void metatables(lua_State *state, int metabase_array_index,
+                         PointerConverter &pvtreg,
+                         types::typetag<MultipleBase<Base, Remain...> >) {
     class_userdata::get_metatable<Base>(state);
     lua_rawseti(state, metabase_array_index,
                 lua_rawlen(state, metabase_array_index) + 1);
@@ -647,9 +688,9 @@ private:
   }
 
   template <typename... Bases>
-  void
+  static void
   set_base_metatable(lua_State *state, int metatable_index,
-                     types::typetag<MultipleBase<Bases...> > metatypes) const {
+                     types::typetag<MultipleBase<Bases...> > metatypes) {
     PointerConverter &pconverter = PointerConverter::get(state);
 
     lua_createtable(state, sizeof...(Bases), 0);
@@ -666,9 +707,9 @@ private:
   pconverter.add_type_conversion<KAGUYA_PP_CAT(A, N), class_type>();
 #define KAGUYA_MULTIPLE_INHERITANCE_SETBASE_DEF(N)                             \
   template <KAGUYA_PP_TEMPLATE_DEF_REPEAT(N)>                                  \
-  void set_base_metatable(                                                     \
+  static void set_base_metatable(                                              \
       lua_State *state, int metatable_index,                                   \
-      types::typetag<MultipleBase<KAGUYA_PP_TEMPLATE_ARG_REPEAT(N)> >) const { \
+      types::typetag<MultipleBase<KAGUYA_PP_TEMPLATE_ARG_REPEAT(N)> >) {       \
     PointerConverter &pconverter = PointerConverter::get(state);               \
     lua_createtable(state, N, 0);                                              \
     int metabase_array_index = lua_gettop(state);                              \
@@ -712,4 +753,321 @@ struct lua_type_traits<UserdataMetatable<T, Base> > {
     return 1;
   }
 };
+
+/// UserdataMetatable flattened for repeated registration into many states.
+/// Member keys are resolved once, so fillMetatable is a single loop over
+/// a vector without map traversal or key building.
+template <typename class_type, typename base_class_type = void>
+class PreparedUserdataMetatable {
+public:
+  PreparedUserdataMetatable(
+      const UserdataMetatable<class_type, base_class_type> &meta)
+      : need_property_access_(
+            !traits::is_same<base_class_type, void>::value ||
+            !meta.property_map_.empty()),
+        has_index_(meta.member_map_.count("__index") != 0),
+        has_newindex_(meta.member_map_.count("__newindex") != 0) {
+    members_.reserve(meta.member_map_.size() + meta.property_map_.size());
+    for (Metatable::MemberMapType::const_iterator it =
+             meta.member_map_.begin();
+         it != meta.member_map_.end(); ++it) {
+      members_.push_back(*it);
+    }
+    for (Metatable::PropMapType::const_iterator it =
+             meta.property_map_.begin();
+         it != meta.property_map_.end(); ++it) {
+      members_.push_back(
+          member_type(KAGUYA_PROPERTY_PREFIX + it->first, it->second));
+    }
+  }
+
+  bool pushCreateMetatable(lua_State *state) const {
+    // __name, name key, __index and __newindex
+    int nrec = static_cast<int>(members_.size() + 4);
+    if (!class_userdata::newmetatable<class_type>(state, nrec)) {
+      except::OtherError(state,
+                         typeid(class_type *).name() +
+                             std::string(" is already registered"));
+      return false;
+    }
+    fillMetatable(state, lua_gettop(state));
+    return true;
+  }
+
+  /// @brief set members to registered metatable at metatable_index.
+  void fillMetatable(lua_State *state, int metatable_index) const {
+    for (typename std::vector<member_type>::const_iterator it =
+             members_.begin();
+         it != members_.end(); ++it) {
+      lua_pushlstring(state, it->first.data(), it->first.size());
+      util::one_push(state, it->second);
+      lua_rawset(state, metatable_index);
+    }
+    Metatable::setIndexMetamethods(state, metatable_index,
+                                   need_property_access_, has_index_,
+                                   has_newindex_);
+
+    UserdataMetatable<class_type, base_class_type>::set_base_metatable(
+        state, metatable_index, types::typetag<base_class_type>());
+
+    Metatable::setCallConstructorMetamethod(state, metatable_index);
+    lua_settop(state, metatable_index);
+  }
+
+private:
+  typedef std::pair<std::string, AnyDataPusher> member_type;
+  std::vector<member_type> members_;
+  bool need_property_access_;
+  bool has_index_;
+  bool has_newindex_;
+};
+
+/// @ingroup lua_type_traits
+/// @brief lua_type_traits for PreparedUserdataMetatable
+template <typename T, typename Base>
+struct lua_type_traits<PreparedUserdataMetatable<T, Base> > {
+  typedef const PreparedUserdataMetatable<T, Base> &push_type;
+
+  static int push(lua_State *l, push_type ref) {
+    ref.pushCreateMetatable(l);
+    return 1;
+  }
+};
+
+/// kind of ClassMemberDescriptor
+enum class_member_kind {
+  CLASS_MEMBER_FUNCTION, //!< metatable[name] = function
+  CLASS_MEMBER_PROPERTY  //!< property accessor. called as function(self[,value])
+};
+
+/// class member entry for StaticUserdataMetatable.
+/// e.g. {"get", KAGUYA_STATIC_FUNCTION(&Foo::get), CLASS_MEMBER_FUNCTION}
+struct ClassMemberDescriptor {
+  const char *name;
+  lua_CFunction function;
+  class_member_kind kind;
+};
+
+/// class binding interface from static ClassMemberDescriptor array.
+/// Descriptor array is referenced, not copied. It must outlive this object.
+/// Unlike UserdataMetatable, name duplication is not checked (later wins).
+template <typename class_type, typename base_class_type = void>
+class StaticUserdataMetatable {
+public:
+  template <size_t N>
+  StaticUserdataMetatable(const ClassMemberDescriptor (&members)[N])
+      : members_(members), member_count_(N) {}
+  StaticUserdataMetatable(const ClassMemberDescriptor *members, size_t count)
+      : members_(members), member_count_(count) {}
+
+  bool pushCreateMetatable(lua_State *state) const {
+    // __name, name key, __gc, __index and __newindex
+    int nrec = static_cast<int>(member_count_ + 5);
+    if (!class_userdata::newmetatable<class_type>(state, nrec)) {
+      except::OtherError(state,
+                         typeid(class_type *).name() +
+                             std::string(" is already registered"));
+      return false;
+    }
+    fillMetatable(state, lua_gettop(state));
+    return true;
+  }
+
+  /// @brief set members to registered metatable at metatable_index.
+  void fillMetatable(lua_State *state, int metatable_index) const {
+    bool has_property = false;
+    bool has_gc = false;
+    bool has_index = false;
+    bool has_newindex = false;
+    for (size_t i = 0; i < member_count_; ++i) {
+      const ClassMemberDescriptor &member = members_[i];
+      if (member.kind == CLASS_MEMBER_PROPERTY) {
+        lua_pushliteral(state, KAGUYA_PROPERTY_PREFIX);
+        lua_pushstring(state, member.name);
+        lua_concat(state, 2);
+        has_property = true;
+      } else {
+        lua_pushstring(state, member.name);
+        has_gc = has_gc || strcmp(member.name, "__gc") == 0;
+        has_index = has_index || strcmp(member.name, "__index") == 0;
+        has_newindex = has_newindex || strcmp(member.name, "__newindex") == 0;
+      }
+      lua_pushcfunction(state, member.function);
+      lua_rawset(state, metatable_index);
+    }
+    if (!has_gc) {
+      lua_pushliteral(state, "__gc");
+      lua_pushcfunction(state, &class_userdata::deleter<ObjectWrapperBase>);
+      lua_rawset(state, metatable_index);
+    }
+
+    Metatable::setIndexMetamethods(
+        state, metatable_index,
+        !traits::is_same<base_class_type, void>::value || has_property,
+        has_index, has_newindex);
+
+    UserdataMetatable<class_type, base_class_type>::set_base_metatable(
+        state, metatable_index, types::typetag<base_class_type>());
+
+    Metatable::setCallConstructorMetamethod(state, metatable_index);
+    lua_settop(state, metatable_index);
+  }
+
+private:
+  const ClassMemberDescriptor *members_;
+  size_t member_count_;
+};
+
+/// @ingroup lua_type_traits
+/// @brief lua_type_traits for StaticUserdataMetatable
+template <typename T, typename Base>
+struct lua_type_traits<StaticUserdataMetatable<T, Base> > {
+  typedef const StaticUserdataMetatable<T, Base> &push_type;
+
+  static int push(lua_State *l, push_type ref) {
+    ref.pushCreateMetatable(l);
+    return 1;
+  }
+};
+
+namespace Metatable {
+inline void call_lazy_builder(lua_State *L) {
+  lua_pushvalue(L, lua_upvalueindex(1));
+  lua_call(L, 0, 0);
+}
+inline int lazy_index_function(lua_State *L) {
+  // build metatable to class table, then return class_table[key]
+  call_lazy_builder(L);
+  lua_settop(L, 2);
+  lua_gettable(L, 1);
+  return 1;
+}
+inline int lazy_newindex_function(lua_State *L) {
+  call_lazy_builder(L);
+  lua_settop(L, 3);
+  lua_settable(L, 1);
+  return 0;
+}
+inline int lazy_call_function(lua_State *L) {
+  call_lazy_builder(L);
+  return call_constructor_function(L);
+}
+}
+
+/// deferred class registration.
+/// Pushes an empty class table. Its metatable is built into that table the
+/// first time the table is touched or an instance of class_type is pushed.
+template <typename class_type, typename MetatableType>
+class LazyUserdataMetatable {
+public:
+  typedef standard::shared_ptr<const MetatableType> holder_type;
+
+  explicit LazyUserdataMetatable(const MetatableType &meta)
+      : meta_(new MetatableType(meta)) {}
+  explicit LazyUserdataMetatable(const holder_type &meta) : meta_(meta) {}
+
+  bool pushStubMetatable(lua_State *state) const {
+    const std::type_info &typeinfo = metatableType<class_type>();
+    bool registered = class_userdata::get_registered_metatable(state, typeinfo);
+    lua_pop(state, 1);
+    if (registered || class_userdata::has_lazy_metatable(state, typeinfo)) {
+      except::OtherError(state,
+                         typeid(class_type *).name() +
+                             std::string(" is already registered"));
+      return false;
+    }
+    lua_newtable(state);
+    int stub_index = lua_gettop(state);
+
+    void *storage = lua_newuserdata(state, sizeof(holder_type));
+    new (storage) holder_type(meta_);
+    lua_createtable(state, 0, 1);
+    lua_pushcfunction(state, &holder_destructor);
+    lua_setfield(state, -2, "__gc");
+    lua_setmetatable(state, -2);
+    lua_pushvalue(state, stub_index);
+    lua_pushcclosure(state, &build, 2);
+    int builder_index = lua_gettop(state);
+    class_userdata::set_lazy_metatable_builder(state, typeinfo, builder_index);
+
+    lua_createtable(state, 0, 3);
+    lua_pushvalue(state, builder_index);
+    lua_pushcclosure(state, &Metatable::lazy_index_function, 1);
+    lua_setfield(state, -2, "__index");
+    lua_pushvalue(state, builder_index);
+    lua_pushcclosure(state, &Metatable::lazy_newindex_function, 1);
+    lua_setfield(state, -2, "__newindex");
+    lua_pushvalue(state, builder_index);
+    lua_pushcclosure(state, &Metatable::lazy_call_function, 1);
+    lua_setfield(state, -2, "__call");
+    lua_setmetatable(state, stub_index);
+
+    lua_settop(state, stub_index);
+    return true;
+  }
+
+private:
+  static int holder_destructor(lua_State *state) {
+    holder_type *holder = static_cast<holder_type *>(lua_touserdata(state, 1));
+    if (holder) {
+      holder->~holder_type();
+    }
+    return 0;
+  }
+  static int build(lua_State *state) {
+    const std::type_info &typeinfo = metatableType<class_type>();
+    lua_pushnil(state);
+    class_userdata::set_lazy_metatable_builder(state, typeinfo, -1);
+    lua_pop(state, 1);
+
+    // remove lazy metamethods first. stub must not call builder again even
+    // if it is not filled
+    lua_pushvalue(state, lua_upvalueindex(2));
+    int metatable_index = lua_gettop(state);
+    lua_pushnil(state);
+    lua_setmetatable(state, metatable_index);
+
+    bool registered = class_userdata::get_registered_metatable(state, typeinfo);
+    lua_pop(state, 1);
+    holder_type *holder = static_cast<holder_type *>(
+        lua_touserdata(state, lua_upvalueindex(1)));
+    if (registered || !holder || !*holder) {
+      return 0;
+    }
+    class_userdata::register_metatable<class_type>(state, metatable_index);
+    (*holder)->fillMetatable(state, metatable_index);
+    return 0;
+  }
+
+  holder_type meta_;
+};
+
+/// @brief flatten meta once for lazy registration. The result can be set to
+/// many states by setLazyClass, and they share one prepared copy.
+/// @code
+///   static const kaguya::LazyUserdataMetatable<
+///       Foo, kaguya::PreparedUserdataMetatable<Foo> >
+///       foo = kaguya::lazyClass(kaguya::UserdataMetatable<Foo>()...);
+///   state["Foo"].setLazyClass(foo);
+/// @endcode
+template <typename T, typename P>
+LazyUserdataMetatable<T, PreparedUserdataMetatable<T, P> >
+lazyClass(const UserdataMetatable<T, P> &meta) {
+  typedef LazyUserdataMetatable<T, PreparedUserdataMetatable<T, P> >
+      lazy_type;
+  return lazy_type(typename lazy_type::holder_type(
+      new PreparedUserdataMetatable<T, P>(meta)));
+}
+
+/// @ingroup lua_type_traits
+/// @brief lua_type_traits for LazyUserdataMetatable
+template <typename T, typename MetatableType>
+struct lua_type_traits<LazyUserdataMetatable<T, MetatableType> > {
+  typedef const LazyUserdataMetatable<T, MetatableType> &push_type;
+
+  static int push(lua_State *l, push_type ref) {
+    ref.pushStubMetatable(l);
+    return 1;
+  }
+};
 }
@@ -13,6 +13,7 @@
 #include "kaguya/utility.hpp"
 #include "kaguya/type.hpp"
 #include "kaguya/lua_ref.hpp"
+#include "kaguya/table_type_check.hpp"
 
 #if KAGUYA_USE_CPP11
 #include "kaguya/native_function_cxx11.hpp"
@@ -131,7 +132,7 @@ call(lua_State *state, MemType T::*mptr) {
     }
   } else {
     if (!this_) {
-      throw LuaTypeMismatch();
+      KAGUYA_THROW(LuaTypeMismatch());
     }
     this_->*mptr = lua_type_traits<MemType>::get(state, 2);
     return 0;
@@ -164,8 +165,7 @@ strictCheckArgTypes(lua_State *state, MemType T::*, int opt_count = 0) {
 template <class MemType, class T>
 typename traits::enable_if<traits::is_object<MemType>::value, std::string>::type
 argTypesName(MemType T::*) {
-  return util::pretty_name(typeid(T *)) + ",[OPT] " +
-         util::pretty_name(typeid(MemType));
+  return util::pretty_name<T *>() + ",[OPT] " + util::pretty_name<MemType>();
 }
 template <class MemType, class T>
 typename traits::enable_if<traits::is_object<MemType>::value, int>::type
@@ -333,7 +333,7 @@ public:
   template <typename T>
   typename lua_type_traits<T>::get_type at(size_t index) const {
     if (index >= size()) {
-      throw std::out_of_range("variadic arguments out of range");
+      KAGUYA_THROW(std::out_of_range("variadic arguments out of range"));
     }
     return lua_type_traits<T>::get(state_,
                                    startIndex_ + static_cast<int>(index));
@@ -341,7 +341,7 @@ public:
 
   reference at(size_t index) const {
     if (index >= size()) {
-      throw std::out_of_range("variadic arguments out of range");
+      KAGUYA_THROW(std::out_of_range("variadic arguments out of range"));
     }
     return reference(state_, startIndex_ + static_cast<int>(index));
   }
@@ -413,9 +413,10 @@ uint8_t compute_function_matching_score(lua_State *state, const Fn &fn) {
     return 0;
   }
 }
-inline int pushArgmentTypeNames(lua_State *state, int top) {
-  for (int i = 1; i <= top; i++) {
-    if (i != 1) {
+inline int pushArgmentTypeNames(lua_State *state, int first, int last) {
+  int top = lua_gettop(state);
+  for (int i = first; i <= last; i++) {
+    if (i != first) {
       lua_pushliteral(state, ",");
     }
 
@@ -432,6 +433,120 @@ inline int pushArgmentTypeNames(lua_State *state, int top) {
   }
   return lua_gettop(state) - top;
 }
+inline int pushArgmentTypeNames(lua_State *state, int top) {
+  return pushArgmentTypeNames(state, 1, top);
+}
+
+/// @brief error object for argument mismatch in deferred argument error
+/// mode. Keeps arguments and candidates in uservalue table, and message is
+/// built by __tostring.
+struct DeferredArgumentError {
+  enum error_kind { ARGUMENT_MISMATCH = 1 };
+  typedef void (*candidate_pusher)(lua_State *state, void *tuple);
+
+  error_kind kind;
+  int level;          //!< stack level of source and currentline
+  int argument_count; //!< arguments stored at uservalue[2...]
+  int currentline;
+  candidate_pusher push_candidates; //!< null if uservalue[1] is string
+  char source[LUA_IDSIZE];
+
+  static void push_uservalue(lua_State *state, int index) {
+#if LUA_VERSION_NUM >= 502
+    lua_getuservalue(state, index);
+#else
+    lua_getfenv(state, index);
+#endif
+  }
+  static void set_uservalue(lua_State *state, int index) {
+#if LUA_VERSION_NUM >= 502
+    lua_setuservalue(state, index);
+#else
+    lua_setfenv(state, index);
+#endif
+  }
+
+  static int tostring(lua_State *state) {
+    if (lua_type(state, 1) != LUA_TUSERDATA ||
+        !detail::is_deferred_argument_error(state, 1)) {
+      return luaL_argerror(state, 1, "DeferredArgumentError expected");
+    }
+    DeferredArgumentError *self =
+        static_cast<DeferredArgumentError *>(lua_touserdata(state, 1));
+    lua_settop(state, 1);
+    push_uservalue(state, 1);
+    for (int i = 1; i <= self->argument_count; ++i) {
+      lua_rawgeti(state, 2, i + 1);
+    }
+    int args_end = lua_gettop(state);
+    if (self->source[0]) {
+      lua_pushfstring(state, "%s:%d: ", self->source, self->currentline);
+    }
+    lua_pushliteral(state, "maybe...Argument mismatch:");
+    pushArgmentTypeNames(state, 3, args_end);
+    lua_pushliteral(state, "\t candidate is:\n");
+    lua_rawgeti(state, 2, 1);
+    if (self->push_candidates) {
+      void *tuple = lua_touserdata(state, -1);
+      lua_pop(state, 1);
+      if (tuple) {
+        self->push_candidates(state, tuple);
+      }
+    }
+    lua_concat(state, lua_gettop(state) - args_end);
+    return 1;
+  }
+
+  static void push_metatable(lua_State *state) {
+    void *key = detail::deferred_argument_error_key();
+    if (lua_rawgetp_rtype(state, LUA_REGISTRYINDEX, key) == LUA_TTABLE) {
+      return;
+    }
+    lua_pop(state, 1);
+    lua_createtable(state, 0, 3);
+    lua_pushcclosure(state, &tostring, 0);
+    lua_setfield(state, -2, "__tostring");
+    lua_pushliteral(state, "kaguya.DeferredArgumentError");
+    lua_setfield(state, -2, "__name");
+    // hide __tostring from scripts
+    lua_pushliteral(state, "kaguya.DeferredArgumentError");
+    lua_setfield(state, -2, "__metatable");
+    lua_pushvalue(state, -1);
+    lua_rawsetp(state, LUA_REGISTRYINDEX, key);
+  }
+
+  /// @brief push error object. arguments are 1...argument_count of stack,
+  /// candidates is value at candidates_index.
+  static void push(lua_State *state, int argument_count, int candidates_index,
+                   candidate_pusher pusher) {
+    candidates_index = lua_absindex(state, candidates_index);
+    DeferredArgumentError *self = static_cast<DeferredArgumentError *>(
+        lua_newuserdata(state, sizeof(DeferredArgumentError)));
+    self->kind = ARGUMENT_MISMATCH;
+    self->level = 1;
+    self->argument_count = argument_count;
+    self->currentline = 0;
+    self->push_candidates = pusher;
+    self->source[0] = '\0';
+    lua_Debug ar;
+    if (lua_getstack(state, self->level, &ar) && lua_getinfo(state, "Sl", &ar) &&
+        ar.currentline > 0) {
+      memcpy(self->source, ar.short_src, sizeof(self->source));
+      self->currentline = ar.currentline;
+    }
+    push_metatable(state);
+    lua_setmetatable(state, -2);
+
+    lua_createtable(state, argument_count + 1, 0);
+    lua_pushvalue(state, candidates_index);
+    lua_rawseti(state, -2, 1);
+    for (int i = 1; i <= argument_count; ++i) {
+      lua_pushvalue(state, i);
+      lua_rawseti(state, -2, i + 1);
+    }
+    set_uservalue(state, -2);
+  }
+};
 }
 
 #if KAGUYA_USE_CPP11
@@ -498,7 +613,7 @@ int best_match_invoke(lua_State *state, Fun &&fn, Functions &&... fns) {
     assert(size_t(index) <= sizeof...(fns));
     return invoke_index(state, index, 0, fn, fns...);
   } else {
-    throw LuaTypeMismatch();
+    KAGUYA_THROW(LuaTypeMismatch());
   }
   return 0;
 }
@@ -518,6 +633,33 @@ int invoke_tuple(lua_State *state, TupleType &&tuple) {
   return invoke_tuple_impl(state, tuple, indexrange());
 }
 
+template <typename TupleType, std::size_t... S>
+int best_function_index_tuple_impl(lua_State *state, TupleType &&tuple,
+                                   nativefunction::index_tuple<S...>) {
+  return best_function_index(state, fntuple::get<S>(tuple)...);
+}
+/// return index of best matched function in tuple. -1 if no candidate
+/// accepts the arguments
+template <typename TupleType>
+int best_function_index_tuple(lua_State *state, TupleType &&tuple) {
+  typedef typename std::decay<TupleType>::type ttype;
+  typedef typename nativefunction::index_range<
+      0, fntuple::tuple_size<ttype>::value>::type indexrange;
+  return best_function_index_tuple_impl(state, tuple, indexrange());
+}
+template <typename TupleType, std::size_t... S>
+int invoke_tuple_index_impl(lua_State *state, TupleType &&tuple, int index,
+                            nativefunction::index_tuple<S...>) {
+  return invoke_index(state, index, 0, fntuple::get<S>(tuple)...);
+}
+template <typename TupleType>
+int invoke_tuple_index(lua_State *state, TupleType &&tuple, int index) {
+  typedef typename std::decay<TupleType>::type ttype;
+  typedef typename nativefunction::index_range<
+      0, fntuple::tuple_size<ttype>::value>::type indexrange;
+  return invoke_tuple_index_impl(state, tuple, index, indexrange());
+}
+
 template <typename Fun>
 void push_arg_typename(lua_State *state, const Fun &fn) {
   lua_pushliteral(state, "\t\t");
@@ -583,7 +725,24 @@ namespace detail {
     int32_t currentbestindex = -1;                                             \
     KAGUYA_PP_REPEAT(N, KAGUYA_FUNCTION_SCOREING);                             \
     KAGUYA_PP_REPEAT(N, KAGUYA_FUNCTION_INVOKE);                               \
-    throw LuaTypeMismatch();                                                   \
+    KAGUYA_THROW(LuaTypeMismatch());                                           \
+  }                                                                            \
+  KAGUYA_TEMPLATE_PARAMETER(N)                                                 \
+  int best_function_index_tuple(                                               \
+      lua_State *state,                                                        \
+      fntuple::tuple<KAGUYA_PP_TEMPLATE_ARG_REPEAT(N)> &tuple) {               \
+    int32_t currentbestscore = 0;                                              \
+    int32_t currentbestindex = -1;                                             \
+    KAGUYA_PP_REPEAT(N, KAGUYA_FUNCTION_SCOREING);                             \
+    return currentbestindex > 0 ? currentbestindex - 1 : -1;                   \
+  }                                                                            \
+  KAGUYA_TEMPLATE_PARAMETER(N)                                                 \
+  int invoke_tuple_index(                                                      \
+      lua_State *state,                                                        \
+      fntuple::tuple<KAGUYA_PP_TEMPLATE_ARG_REPEAT(N)> &tuple, int index) {    \
+    int32_t currentbestindex = index + 1;                                      \
+    KAGUYA_PP_REPEAT(N, KAGUYA_FUNCTION_INVOKE);                               \
+    return 0;                                                                  \
   }                                                                            \
   KAGUYA_TEMPLATE_PARAMETER(N)                                                 \
   void push_arg_typename_tuple(                                                \
@@ -608,6 +767,54 @@ int invoke_tuple(lua_State *state, TupleType &tuple) {
 }
 #endif
 
+namespace detail {
+#if KAGUYA_USE_CPP20_COROUTINE
+/// pushed instead of results by a function that returned a suspended
+/// kaguya::Task. see coroutine.hpp
+inline void *pending_task_marker() {
+  static int marker;
+  return &marker;
+}
+#if LUA_VERSION_NUM >= 502
+// the finished task resumes the thread with results and the result count,
+// or with error message and -1. arguments of the call are still below.
+inline int pending_task_finish(lua_State *state) {
+  int count = static_cast<int>(lua_tointeger(state, -1));
+  lua_pop(state, 1);
+  if (count < 0) {
+    return lua_error(state);
+  }
+  return count;
+}
+#if LUA_VERSION_NUM >= 503
+inline int pending_task_continuation(lua_State *state, int, lua_KContext) {
+  return pending_task_finish(state);
+}
+#else
+inline int pending_task_continuation(lua_State *state) {
+  return pending_task_finish(state);
+}
+#endif
+#endif
+
+/// yield the calling thread if a bound function returned a pending task.
+/// must be called outside of try block.
+inline int return_or_yield(lua_State *state, int count) {
+  if (count != 1 || lua_touserdata(state, -1) != pending_task_marker()) {
+    return count;
+  }
+  lua_pop(state, 1);
+#if LUA_VERSION_NUM >= 502
+  return lua_yieldk(state, 0, 0, &pending_task_continuation);
+#else
+  return lua_yield(state, 0);
+#endif
+}
+#else
+inline int return_or_yield(lua_State *, int count) { return count; }
+#endif
+}
+
 template <typename FunctionTuple> struct FunctionInvokerType {
   FunctionTuple functions;
   FunctionInvokerType(const FunctionTuple &t) : functions(t) {}
@@ -646,6 +853,78 @@ KAGUYA_PP_REPEAT_DEF(KAGUYA_FUNCTION_MAX_OVERLOADS, KAGUYA_FOVERLOAD_DEF)
 #undef KAGUYA_FOVERLOAD_DEF
 #endif
 
+namespace detail {
+#if KAGUYA_USE_CPP11 && __cplusplus >= 201703L &&                              \
+    defined(__cpp_noexcept_function_type) &&                                   \
+    !defined(KAGUYA_FUNCTION_MAX_OVERLOADS)
+// noexcept is part of function type since C++17
+template <typename F, typename = void>
+struct is_noexcept_callable : std::false_type {};
+template <typename R, typename... Args>
+struct is_noexcept_callable<R (*)(Args...) noexcept> : std::true_type {};
+template <typename R, typename C, typename... Args>
+struct is_noexcept_callable<R (C::*)(Args...) noexcept> : std::true_type {};
+template <typename R, typename C, typename... Args>
+struct is_noexcept_callable<R (C::*)(Args...) const noexcept>
+    : std::true_type {};
+template <typename F>
+struct is_noexcept_callable<F, std::void_t<decltype(&F::operator())> >
+    : is_noexcept_callable<decltype(&F::operator())> {};
+
+/// all functions are noexcept, and need no exception handler
+template <typename FunctionTuple>
+struct is_noexcept_tuple : std::false_type {};
+template <typename... Functions>
+struct is_noexcept_tuple<std::tuple<Functions...> >
+    : std::integral_constant<
+          bool, (sizeof...(Functions) > 0) &&
+                    (is_noexcept_callable<Functions>::value && ...)> {};
+#else
+template <typename FunctionTuple>
+struct is_noexcept_tuple : traits::integral_constant<bool, false> {};
+#endif
+}
+
+/// @brief function object dispatched by checking arguments before call.
+/// mismatch is raised by lua_error, not by exception. try/catch is kept
+/// around argument conversion and call if exceptions are enabled.
+/// kaguya::function and overload dispatch this way if every function is
+/// noexcept (C++17), and all functions do if KAGUYA_NO_EXCEPTIONS is 1.
+template <typename FunctionTuple> struct NothrowFunctionInvokerType {
+  FunctionTuple functions;
+  NothrowFunctionInvokerType(const FunctionTuple &t) : functions(t) {}
+};
+
+/// @brief create function object dispatched by checking arguments before
+/// call. see NothrowFunctionInvokerType
+template <typename T>
+inline NothrowFunctionInvokerType<fntuple::tuple<T> > nothrow_function(T f) {
+  KAGUYA_STATIC_ASSERT(
+      nativefunction::is_callable<typename traits::decay<T>::type>::value,
+      "argument need callable");
+  return NothrowFunctionInvokerType<fntuple::tuple<T> >(fntuple::tuple<T>(f));
+}
+#if KAGUYA_USE_CPP11
+/// @brief overloaded version of nothrow_function
+template <typename... Functions>
+NothrowFunctionInvokerType<fntuple::tuple<Functions...> >
+nothrow_overload(Functions... fns) {
+  return NothrowFunctionInvokerType<fntuple::tuple<Functions...> >(
+      fntuple::tuple<Functions...>(fns...));
+}
+#else
+#define KAGUYA_NOTHROW_FOVERLOAD_DEF(N)                                        \
+  template <KAGUYA_PP_TEMPLATE_DEF_REPEAT(N)>                                  \
+  NothrowFunctionInvokerType<fntuple::tuple<KAGUYA_PP_TEMPLATE_ARG_REPEAT(N)> > \
+  nothrow_overload(KAGUYA_PP_ARG_DEF_REPEAT(N)) {                              \
+    typedef typename fntuple::tuple<KAGUYA_PP_TEMPLATE_ARG_REPEAT(N)> ttype;   \
+    return NothrowFunctionInvokerType<ttype>(ttype(KAGUYA_PP_ARG_REPEAT(N)));  \
+  }
+KAGUYA_PP_REPEAT_DEF(KAGUYA_FUNCTION_MAX_OVERLOADS,
+                     KAGUYA_NOTHROW_FOVERLOAD_DEF)
+#undef KAGUYA_NOTHROW_FOVERLOAD_DEF
+#endif
+
 struct luacfunction {
   lua_CFunction ptr;
 
@@ -660,8 +939,26 @@ struct lua_type_traits<FunctionInvokerType<FunctionTuple> > {
   typedef FunctionInvokerType<FunctionTuple> userdatatype;
   typedef const FunctionInvokerType<FunctionTuple> &push_type;
 
+  // push candidate signatures. computed once and kept at cache_index if
+  // cache_index is not 0
+  static void push_candidate_names(lua_State *state, FunctionTuple *tuple,
+                                   int cache_index) {
+    if (cache_index != 0 && lua_type(state, cache_index) == LUA_TSTRING) {
+      lua_pushvalue(state, cache_index);
+      return;
+    }
+    int stack_top = lua_gettop(state);
+    detail::push_arg_typename_tuple(state, *tuple);
+    lua_concat(state, lua_gettop(state) - stack_top);
+    if (cache_index != 0) {
+      lua_pushvalue(state, -1);
+      lua_replace(state, cache_index);
+    }
+  }
+
   static const char *build_arg_error_message(lua_State *state, const char *msg,
-                                             FunctionTuple *tuple) {
+                                             FunctionTuple *tuple,
+                                             int cache_index = 0) {
     int stack_top = lua_gettop(state);
     if (msg) {
       lua_pushstring(state, msg);
@@ -670,30 +967,117 @@ struct lua_type_traits<FunctionInvokerType<FunctionTuple> > {
     nativefunction::pushArgmentTypeNames(state, stack_top);
 
     lua_pushliteral(state, "\t candidate is:\n");
-    detail::push_arg_typename_tuple(state, *tuple);
+    push_candidate_names(state, tuple, cache_index);
 
     lua_concat(state, lua_gettop(state) - stack_top);
     return lua_tostring(state, -1);
   }
 
+  static void push_candidate_names_thunk(lua_State *state, void *tuple) {
+    detail::push_arg_typename_tuple(state, *static_cast<FunctionTuple *>(tuple));
+  }
+
+  // push argument mismatch error. if cache_index is not 0, the function is
+  // called from closure pushed by push_closure
+  static void push_arg_error(lua_State *state, FunctionTuple *tuple,
+                             int cache_index) {
+    if (cache_index != 0 && is_deferred_argument_error(state)) {
+      int argument_count = lua_gettop(state);
+      if (lua_type(state, cache_index) == LUA_TSTRING) {
+        nativefunction::DeferredArgumentError::push(state, argument_count,
+                                                    cache_index, 0);
+      } else {
+        nativefunction::DeferredArgumentError::push(
+            state, argument_count, lua_upvalueindex(1),
+            &push_candidate_names_thunk);
+      }
+      return;
+    }
+    util::traceBack(state, build_arg_error_message(state, "maybe...", tuple,
+                                                   cache_index));
+  }
+
   static int invoke(lua_State *state) {
     FunctionTuple *t = static_cast<FunctionTuple *>(
         lua_touserdata(state, lua_upvalueindex(1)));
+    return invoke(state, t, lua_upvalueindex(2));
+  }
 
+  static int invoke(lua_State *state, FunctionTuple *t, int cache_index = 0) {
+#if KAGUYA_NO_EXCEPTIONS
+    return invoke_nothrow(state, t, cache_index);
+#else
     if (t) {
+      int count = -1;
       try {
-        return detail::invoke_tuple(state, *t);
+        count = detail::invoke_tuple(state, *t);
       } catch (LuaTypeMismatch &e) {
-        if (strcmp(e.what(), "type mismatch!!") == 0) {
-          util::traceBack(state, build_arg_error_message(state, "maybe...", t));
-        } else {
-          util::traceBack(state, e.what());
-        }
+        push_type_mismatch_error(state, e, t, cache_index);
       } catch (std::exception &e) {
         util::traceBack(state, e.what());
       } catch (...) {
         util::traceBack(state, "Unknown exception");
       }
+      if (count >= 0) {
+        return detail::return_or_yield(state, count);
+      }
+    }
+    return lua_error(state);
+#endif
+  }
+#if !KAGUYA_NO_EXCEPTIONS
+  static void push_type_mismatch_error(lua_State *state,
+                                       const LuaTypeMismatch &e,
+                                       FunctionTuple *t, int cache_index) {
+    if (strcmp(e.what(), "type mismatch!!") == 0) {
+      push_arg_error(state, t, cache_index);
+    } else {
+      util::traceBack(state, e.what());
+    }
+  }
+#endif
+
+  static int invoke_nothrow(lua_State *state) {
+    FunctionTuple *t = static_cast<FunctionTuple *>(
+        lua_touserdata(state, lua_upvalueindex(1)));
+    return invoke_nothrow(state, t, lua_upvalueindex(2));
+  }
+
+  // argument types are checked before call and mismatch is raised by
+  // lua_error. all table elements are checked, but argument conversion can
+  // still throw, e.g. userdata with KAGUYA_NO_USERDATA_TYPE_CHECK,
+  // SerializedValue or bad_alloc. with exceptions enabled the call is kept
+  // in try block, which costs nothing unless thrown.
+  static int invoke_nothrow(lua_State *state, FunctionTuple *t,
+                            int cache_index = 0) {
+    if (t) {
+      int index = -1;
+      {
+        detail::strict_table_type_check strict(state);
+        index = detail::best_function_index_tuple(state, *t);
+      }
+      if (index < 0) {
+        push_arg_error(state, t, cache_index);
+        return lua_error(state);
+      }
+#if KAGUYA_NO_EXCEPTIONS
+      return detail::return_or_yield(
+          state, detail::invoke_tuple_index(state, *t, index));
+#else
+      int count = -1;
+      try {
+        count = detail::invoke_tuple_index(state, *t, index);
+      } catch (LuaTypeMismatch &e) {
+        push_type_mismatch_error(state, e, t, cache_index);
+      } catch (std::exception &e) {
+        util::traceBack(state, e.what());
+      } catch (...) {
+        util::traceBack(state, "Unknown exception");
+      }
+      if (count >= 0) {
+        return detail::return_or_yield(state, count);
+      }
+#endif
     }
     return lua_error(state);
   }
@@ -706,21 +1090,101 @@ struct lua_type_traits<FunctionInvokerType<FunctionTuple> > {
     return 0;
   }
 
-  static int push(lua_State *state, push_type fns) {
-    void *ptr = lua_newuserdata(state, sizeof(FunctionTuple));
-    new (ptr) FunctionTuple(fns.functions);
+  // metatable for FunctionTuple userdata is shared per type in state
+  static void push_tuple_metatable(lua_State *state) {
+    static int key = 0;
+    if (lua_rawgetp_rtype(state, LUA_REGISTRYINDEX, &key) == LUA_TTABLE) {
+      return;
+    }
+    lua_pop(state, 1);
     lua_createtable(state, 0, 2);
     lua_pushcclosure(state, &tuple_destructor, 0);
     lua_setfield(state, -2, "__gc");
     lua_pushvalue(state, -1);
     lua_setfield(state, -1, "__index");
+    lua_pushvalue(state, -1);
+    lua_rawsetp(state, LUA_REGISTRYINDEX, &key);
+  }
+
+  static int push_closure(lua_State *state, const FunctionTuple &functions,
+                          lua_CFunction invoker) {
+    void *ptr = lua_newuserdata(state, sizeof(FunctionTuple));
+    new (ptr) FunctionTuple(functions);
+    push_tuple_metatable(state);
     lua_setmetatable(state, -2);
-    lua_pushcclosure(state, &invoke, 1);
+    lua_pushnil(state); // candidate signatures cache
+    lua_pushcclosure(state, invoker, 2);
 
     return 1;
   }
+
+  static int push(lua_State *state, push_type fns) {
+    lua_CFunction invoker = &invoke;
+    if (detail::is_noexcept_tuple<FunctionTuple>::value) {
+      invoker = &invoke_nothrow;
+    }
+    return push_closure(state, fns.functions, invoker);
+  }
 };
 
+/// @ingroup lua_type_traits
+/// @brief lua_type_traits for NothrowFunctionInvokerType
+template <typename FunctionTuple>
+struct lua_type_traits<NothrowFunctionInvokerType<FunctionTuple> > {
+  typedef const NothrowFunctionInvokerType<FunctionTuple> &push_type;
+  typedef lua_type_traits<FunctionInvokerType<FunctionTuple> > invoker_traits;
+
+  static int push(lua_State *state, push_type fns) {
+    return invoker_traits::push_closure(state, fns.functions,
+                                        &invoker_traits::invoke_nothrow);
+  }
+};
+
+/// @brief lua_CFunction bound to function f at compile time.
+/// Unlike kaguya::function, pushing invoke need not allocate a userdata.
+/// usage: KAGUYA_STATIC_FUNCTION(&Foo::bar)
+template <typename F, F f> struct static_function {
+  static int invoke(lua_State *state) {
+    typedef fntuple::tuple<F> tuple_type;
+    typedef lua_type_traits<FunctionInvokerType<tuple_type> > invoker_traits;
+    tuple_type fns(f);
+    if (detail::is_noexcept_tuple<tuple_type>::value) {
+      return invoker_traits::invoke_nothrow(state, &fns);
+    }
+    return invoker_traits::invoke(state, &fns);
+  }
+};
+
+/// @brief lua_CFunction calling constructor of Signature. e.g.
+/// static_constructor<Foo(int)>::invoke
+template <typename Signature> struct static_constructor {
+  static int invoke(lua_State *state) {
+    typedef typename ConstructorFunction<Signature>::type constructor_type;
+    typedef fntuple::tuple<constructor_type> tuple_type;
+    tuple_type fns((constructor_type()));
+    return lua_type_traits<FunctionInvokerType<tuple_type> >::invoke(state,
+                                                                     &fns);
+  }
+};
+
+#if KAGUYA_USE_CPP11
+#define KAGUYA_STATIC_FUNCTION(FN)                                             \
+  (&kaguya::static_function<decltype(FN), FN>::invoke)
+#else
+namespace detail {
+template <typename F> struct static_function_deducer {
+  template <F f> lua_CFunction get() const {
+    return &static_function<F, f>::invoke;
+  }
+};
+template <typename F> static_function_deducer<F> deduce_static_function(F) {
+  return static_function_deducer<F>();
+}
+}
+#define KAGUYA_STATIC_FUNCTION(FN)                                             \
+  (kaguya::detail::deduce_static_function(FN).get<FN>())
+#endif
+
 /// @ingroup lua_type_traits
 /// @brief lua_type_traits for c function
 template <typename T>
@@ -853,7 +1317,7 @@ struct GENERATE_NAME \
         KAGUYA_PP_REPEAT_DEF_VA_ARG(                                           \
             KAGUYA_PP_INC(KAGUYA_PP_SUB(MAXARG, MINARG)),                      \
             KAGUYA_INTERNAL_OVERLOAD_FUNCTION_INVOKE, FNAME, MINARG, MAXARG)   \
-        throw kaguya::LuaTypeMismatch("argument count mismatch");              \
+        KAGUYA_THROW(kaguya::LuaTypeMismatch("argument count mismatch"));      \
       }                                                                        \
       virtual int minArgCount() const { return MINARG; }                       \
       virtual int maxArgCount() const { return MAXARG; }                       \
@@ -898,7 +1362,7 @@ struct GENERATE_NAME \
             KAGUYA_PP_INC(KAGUYA_PP_SUB(MAXARG, MINARG)),                      \
             KAGUYA_INTERNAL_OVERLOAD_MEMBER_FUNCTION_INVOKE, FNAME, MINARG,    \
             MAXARG)                                                            \
-        throw kaguya::LuaTypeMismatch("argument count mismatch");              \
+        KAGUYA_THROW(kaguya::LuaTypeMismatch("argument count mismatch"));      \
       }                                                                        \
       virtual int minArgCount() const { return MINARG + 1; }                   \
       virtual int maxArgCount() const { return MAXARG + 1; }                   \
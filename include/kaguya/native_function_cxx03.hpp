@@ -24,7 +24,7 @@ namespace nativefunction {
       N)> &fsig
 #define KAGUYA_TYPENAME_REP(N)                                                 \
   +((MAX_ARG - opt_count < N) ? "[OPT]" : "") +                                \
-      util::pretty_name(typeid(KAGUYA_PP_CAT(A, N))) + ","
+      util::pretty_name<KAGUYA_PP_CAT(A, N)>() + ","
 #define KAGUYA_TYPECHECK_REP(N)                                                \
   &&(((MAX_ARG - opt_count < N) && lua_isnoneornil(state, N)) ||               \
      lua_type_traits<KAGUYA_PP_CAT(A, N)>::checkType(state, N))
@@ -138,12 +138,13 @@ template <typename T> struct ConstructorFunctor;
     int operator()(lua_State *L) const {                                       \
       typedef ObjectWrapper<ClassType> wrapper_type;                           \
       void *storage = lua_newuserdata(L, sizeof(wrapper_type));                \
-      try {                                                                    \
+      KAGUYA_TRY {                                                             \
         new (storage)                                                          \
             wrapper_type(KAGUYA_PP_REPEAT_ARG(N, KAGUYA_CONSTRUCTOR_GET_REP)); \
-      } catch (...) {                                                          \
+      }                                                                        \
+      KAGUYA_CATCH_ALL {                                                       \
         lua_pop(L, 1);                                                         \
-        throw;                                                                 \
+        KAGUYA_RETHROW;                                                        \
       }                                                                        \
       class_userdata::setmetatable<ClassType>(L);                              \
       return 1;                                                                \
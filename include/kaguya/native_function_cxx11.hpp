@@ -103,7 +103,7 @@ std::string _type_name_apply(index_tuple<Indexes...>, util::TypeTuple<Args...>,
   join(result, ",",
        (((max_arg - opt_count < int(Indexes)) ? std::string("[OPT]")
                                               : std::string("")) +
-        util::pretty_name(typeid(Args)))...);
+        util::pretty_name<Args>())...);
   return result;
 }
 
@@ -160,12 +160,16 @@ struct ConstructorFunctor<util::FunctionSignatureType<ClassType, Args...> > {
   int invoke(lua_State *L, index_tuple<Indexes...>) const {
     typedef ObjectWrapper<ClassType> wrapper_type;
     void *storage = lua_newuserdata(L, sizeof(wrapper_type));
+#if KAGUYA_NO_EXCEPTIONS
+    new (storage) wrapper_type(lua_type_traits<Args>::get(L, Indexes)...);
+#else
     try {
       new (storage) wrapper_type(lua_type_traits<Args>::get(L, Indexes)...);
     } catch (...) {
       lua_pop(L, 1);
       throw;
     }
+#endif
 
     class_userdata::setmetatable<ClassType>(L);
     return 1;
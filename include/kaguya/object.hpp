@@ -21,6 +21,7 @@ template <typename T> struct typetag {};
 #if KAGUYA_SUPPORT_MULTIPLE_SHARED_LIBRARY
 inline const char *metatable_name_key() { return "\x80KAGUYA_N_KEY"; }
 inline const char *metatable_type_table_key() { return "\x80KAGUYA_T_KEY"; }
+inline const char *lazy_metatable_table_key() { return "\x80KAGUYA_L_KEY"; }
 #else
 inline void *metatable_name_key() {
   static int key;
@@ -30,13 +31,17 @@ inline void *metatable_type_table_key() {
   static int key;
   return &key;
 }
+inline void *lazy_metatable_table_key() {
+  static int key;
+  return &key;
+}
 #endif
 
 template <typename T> const std::type_info &metatableType() {
   return typeid(typename traits::decay<T>::type);
 }
-template <typename T> inline std::string metatableName() {
-  return util::pretty_name(metatableType<T>());
+template <typename T> inline const std::string &metatableName() {
+  return util::pretty_name<typename traits::decay<T>::type>();
 }
 
 struct ObjectWrapperBase {
@@ -549,7 +554,15 @@ template <typename T> inline void destructor(T *pointer) {
     pointer->~T();
   }
 }
-inline bool get_metatable(lua_State *l, const std::type_info &typeinfo) {
+inline void push_type_key(lua_State *l, const std::type_info &typeinfo) {
+#if KAGUYA_NAME_BASED_TYPE_CHECK
+  lua_pushstring(l, typeinfo.name());
+#else
+  lua_pushlightuserdata(l, const_cast<std::type_info *>(&typeinfo));
+#endif
+}
+inline bool get_registered_metatable(lua_State *l,
+                                     const std::type_info &typeinfo) {
 #if KAGUYA_SUPPORT_MULTIPLE_SHARED_LIBRARY
   lua_pushstring(l, metatable_type_table_key());
 #else
@@ -576,6 +589,95 @@ inline bool get_metatable(lua_State *l, const std::type_info &typeinfo) {
   lua_remove(l, -2); // remove metatable registry table
   return type != LUA_TNIL;
 }
+
+// no state has deferred metatable until set, and lookup of unregistered
+// type skips the builder table
+struct lazy_metatable_tag {};
+inline bool lazy_metatable_used() {
+  return detail::FeatureUsedFlag<lazy_metatable_tag>::used();
+}
+inline void set_lazy_metatable_used() {
+  detail::FeatureUsedFlag<lazy_metatable_tag>::set();
+}
+
+/// push deferred metatable builder table. if not exists, create it
+inline void get_lazy_metatable_table(lua_State *l) {
+#if KAGUYA_SUPPORT_MULTIPLE_SHARED_LIBRARY
+  lua_pushstring(l, lazy_metatable_table_key());
+#else
+  lua_pushlightuserdata(l, lazy_metatable_table_key());
+#endif
+  if (lua_rawget_rtype(l, LUA_REGISTRYINDEX) != LUA_TTABLE) {
+    lua_pop(l, 1);
+    lua_newtable(l);
+#if KAGUYA_SUPPORT_MULTIPLE_SHARED_LIBRARY
+    lua_pushstring(l, lazy_metatable_table_key());
+#else
+    lua_pushlightuserdata(l, lazy_metatable_table_key());
+#endif
+    lua_pushvalue(l, -2);
+    lua_rawset(l, LUA_REGISTRYINDEX);
+  }
+}
+/// set builder function(or nil) at builder_index for deferred metatable
+inline void set_lazy_metatable_builder(lua_State *l,
+                                       const std::type_info &typeinfo,
+                                       int builder_index) {
+  builder_index = lua_absindex(l, builder_index);
+  if (!lua_isnil(l, builder_index)) {
+    set_lazy_metatable_used();
+  }
+  get_lazy_metatable_table(l);
+  push_type_key(l, typeinfo);
+  lua_pushvalue(l, builder_index);
+  lua_rawset(l, -3);
+  lua_pop(l, 1);
+}
+inline bool has_lazy_metatable(lua_State *l, const std::type_info &typeinfo) {
+  if (!lazy_metatable_used()) {
+    return false;
+  }
+  get_lazy_metatable_table(l);
+  push_type_key(l, typeinfo);
+  int type = lua_rawget_rtype(l, -2);
+  lua_pop(l, 2);
+  return type != LUA_TNIL;
+}
+/// call deferred metatable builder if registered.
+inline bool build_lazy_metatable(lua_State *l, const std::type_info &typeinfo) {
+  if (!lazy_metatable_used()) {
+    return false;
+  }
+#if KAGUYA_SUPPORT_MULTIPLE_SHARED_LIBRARY
+  lua_pushstring(l, lazy_metatable_table_key());
+#else
+  lua_pushlightuserdata(l, lazy_metatable_table_key());
+#endif
+  if (lua_rawget_rtype(l, LUA_REGISTRYINDEX) != LUA_TTABLE) {
+    lua_pop(l, 1);
+    return false;
+  }
+  push_type_key(l, typeinfo);
+  if (lua_rawget_rtype(l, -2) != LUA_TFUNCTION) {
+    lua_pop(l, 2);
+    return false;
+  }
+  lua_remove(l, -2);
+  lua_call(l, 0, 0);
+  return true;
+}
+
+inline bool get_metatable(lua_State *l, const std::type_info &typeinfo) {
+  if (get_registered_metatable(l, typeinfo)) {
+    return true;
+  }
+  lua_pop(l, 1);
+  if (build_lazy_metatable(l, typeinfo)) {
+    return get_registered_metatable(l, typeinfo);
+  }
+  lua_pushnil(l);
+  return false;
+}
 template <typename T> bool get_metatable(lua_State *l) {
   return get_metatable(l, metatableType<T>());
 }
@@ -584,11 +686,14 @@ template <typename T> bool available_metatable(lua_State *l) {
   return get_metatable<T>(l);
 }
 
-inline bool newmetatable(lua_State *l, const std::type_info &typeinfo,
-                         const char *name) {
-  if (get_metatable(l, typeinfo)) // already register
+/// register table at index as metatable for typeinfo.
+inline void register_metatable(lua_State *l, const std::type_info &typeinfo,
+                               const char *name, int index) {
+  index = lua_absindex(l, index);
+  if (get_registered_metatable(l, typeinfo)) // already register
   {
-    return false; //
+    lua_pop(l, 1);
+    return;
   }
   lua_pop(l, 1);
 
@@ -601,9 +706,8 @@ inline bool newmetatable(lua_State *l, const std::type_info &typeinfo,
 
   int metaregindex = lua_absindex(l, -1);
 
-  lua_createtable(l, 0, 2);
   lua_pushstring(l, name);
-  lua_setfield(l, -2, "__name"); // metatable.__name = name
+  lua_setfield(l, index, "__name"); // metatable.__name = name
 
 #if KAGUYA_SUPPORT_MULTIPLE_SHARED_LIBRARY
   lua_pushstring(l, metatable_name_key());
@@ -611,26 +715,42 @@ inline bool newmetatable(lua_State *l, const std::type_info &typeinfo,
   lua_pushlightuserdata(l, metatable_name_key());
 #endif
   lua_pushstring(l, name);
-  lua_rawset(l, -3);
+  lua_rawset(l, index);
 #if KAGUYA_NAME_BASED_TYPE_CHECK
   lua_pushstring(l, typeinfo.name());
-  lua_pushvalue(l, -2);
+  lua_pushvalue(l, index);
   lua_rawset(l, metaregindex);
 #else
-  lua_pushvalue(l, -1);
+  lua_pushvalue(l, index);
   lua_rawsetp(l, metaregindex, &typeinfo);
 #endif
   lua_remove(l, metaregindex); // remove metatable registry table
+}
+template <typename T> void register_metatable(lua_State *l, int index) {
+  register_metatable(l, metatableType<T>(), metatableName<T>().c_str(), index);
+}
 
+inline bool newmetatable(lua_State *l, const std::type_info &typeinfo,
+                         const char *name, int nrec = 2) {
+  if (get_metatable(l, typeinfo)) // already register
+  {
+    return false; //
+  }
+  lua_pop(l, 1);
+
+  lua_createtable(l, 0, nrec);
+  register_metatable(l, typeinfo, name, -1);
   return true;
 }
-template <typename T> bool newmetatable(lua_State *l) {
-  return newmetatable(l, metatableType<T>(), metatableName<T>().c_str());
+template <typename T> bool newmetatable(lua_State *l, int nrec = 2) {
+  return newmetatable(l, metatableType<T>(), metatableName<T>().c_str(), nrec);
 }
 
 template <typename T> inline int deleter(lua_State *state) {
   T *ptr = (T *)lua_touserdata(state, 1);
-  ptr->~T();
+  if (ptr) { // metatable may be collected by base metatable's __gc
+    ptr->~T();
+  }
   return 0;
 }
 struct UnknownType {};
@@ -680,7 +800,7 @@ template <typename T> inline T object_get(lua_State *l, int index) {
   const typename traits::remove_reference<T>::type *pointer = get_const_pointer(
       l, index, types::typetag<typename traits::remove_reference<T>::type>());
   if (!pointer) {
-    throw LuaTypeMismatch();
+    KAGUYA_THROW(LuaTypeMismatch());
   }
   return *pointer;
 }
@@ -734,7 +854,9 @@ bool strictCheckType(lua_State *l, int index) {
   ;
 }
 
-template <class To> To get(lua_State *, int) { throw LuaTypeMismatch(); }
+template <class To> To get(lua_State *, int) {
+  KAGUYA_THROW(LuaTypeMismatch());
+}
 template <class To, class From, class... Remain>
 To get(lua_State *l, int index) {
   typedef optional<typename lua_type_traits<From>::get_type> opt_type;
@@ -824,7 +946,7 @@ KAGUYA_PP_REPEAT_DEF(KAGUYA_FUNCTION_MAX_ARGS,
          TypeTuple<KAGUYA_PP_TEMPLATE_ARG_REPEAT(N)>) {                        \
     KAGUYA_PP_REPEAT(N, KAGUYA_CONVERTIBLE_REG_HELPER_GET_OPT_TYPEDEF)         \
     KAGUYA_PP_REPEAT(N, KAGUYA_CONVERTIBLE_REG_HELPER_GET_REP) {               \
-      throw LuaTypeMismatch();                                                 \
+      KAGUYA_THROW(LuaTypeMismatch());                                         \
     }                                                                          \
   }
 KAGUYA_PP_REPEAT_DEF(KAGUYA_FUNCTION_MAX_ARGS,
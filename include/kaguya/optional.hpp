@@ -84,13 +84,13 @@ public:
     if (value_) {
       return *value_;
     }
-    throw bad_optional_access();
+    KAGUYA_THROW(bad_optional_access());
   }
   const T &value() const {
     if (value_) {
       return *value_;
     }
-    throw bad_optional_access();
+    KAGUYA_THROW(bad_optional_access());
   }
 
 #if KAGUYA_USE_CPP11
@@ -173,13 +173,13 @@ public:
     if (value_) {
       return *value_;
     }
-    throw bad_optional_access();
+    KAGUYA_THROW(bad_optional_access());
   }
   const T &value() const {
     if (value_) {
       return *value_;
     }
-    throw bad_optional_access();
+    KAGUYA_THROW(bad_optional_access());
   }
 
 #if KAGUYA_USE_CPP11
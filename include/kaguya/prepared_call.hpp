@@ -0,0 +1,155 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "kaguya/config.hpp"
+#include "kaguya/error_handler.hpp"
+#include "kaguya/utility.hpp"
+#include "kaguya/lua_ref.hpp"
+#include "kaguya/lua_ref_function.hpp"
+
+namespace kaguya {
+namespace detail {
+template <typename Ret> class PreparedCallBase {
+public:
+  /// @brief bound function
+  const LuaFunction &function() const { return function_; }
+
+  /// @brief return true if bound to a function
+  bool valid() const {
+    return state_ && function_.type() == LuaFunction::TYPE_FUNCTION;
+  }
+
+protected:
+  PreparedCallBase() : state_(0), handler_(0), stack_size_(0) {}
+  PreparedCallBase(const LuaFunction &function, int argnum)
+      : function_(function), state_(function.state()), handler_(0),
+        stack_size_(argnum + 1) {
+    if (state_) {
+      handler_ = ErrorHandler::getHandlerPointer(state_);
+    }
+  }
+
+  // space for function and arguments. other calls may have used the stack
+  // since construction, so check on each call
+  bool reserve_() const {
+    if (!lua_checkstack(state_, stack_size_)) {
+      except::OtherError(state_, "stack overflow");
+      return false;
+    }
+    return true;
+  }
+
+  Ret invoke_(int argstart, int argnum) const {
+    int status = lua_pcall_wrap(state_, argnum,
+                                function_result_count<Ret>::value);
+    if (status != 0) {
+      if (handler_) {
+        (*handler_)(status, get_error_message(state_));
+      } else {
+        ErrorHandler::handle(status, state_);
+      }
+    }
+    return FunctionResultProxy::ReturnValue(state_, status, argstart,
+                                            types::typetag<Ret>());
+  }
+
+  LuaFunction function_;
+  lua_State *state_;
+  ErrorHandler::function_type *handler_;
+  int stack_size_;
+};
+}
+
+/// @brief Call handle for a Lua function called repeatedly from C++.
+/// Resolves the error handler once at construction, then call like a
+/// function pointer.
+/// @code
+///   kaguya::PreparedCall<int(int, int)> add = state["add"];
+///   int v = add(1, 2);
+/// @endcode
+template <typename FTYPE> class PreparedCall;
+
+#if KAGUYA_USE_CPP11
+template <typename Ret, typename... Args>
+class PreparedCall<Ret(Args...)> : public detail::PreparedCallBase<Ret> {
+  typedef detail::PreparedCallBase<Ret> base_type;
+
+public:
+  PreparedCall() {}
+  explicit PreparedCall(const LuaFunction &function)
+      : base_type(function, static_cast<int>(sizeof...(Args))) {}
+
+  Ret operator()(Args... args) const {
+    lua_State *state = this->state_;
+    if (!state) {
+      except::typeMismatchError(state, "nil");
+      return Ret();
+    }
+    if (!this->reserve_()) {
+      return Ret();
+    }
+    int argstart = lua_gettop(state) + 1;
+    this->function_.push(state);
+    int argnum = util::push_args(state, std::forward<Args>(args)...);
+    return this->invoke_(argstart, argnum);
+  }
+};
+#else
+#define KAGUYA_PREPARED_CALL_DEF(N)                                            \
+  template <typename Ret KAGUYA_PP_TEMPLATE_DEF_REPEAT_CONCAT(N)>              \
+  class PreparedCall<Ret(KAGUYA_PP_TEMPLATE_ARG_REPEAT(N))>                    \
+      : public detail::PreparedCallBase<Ret> {                                 \
+    typedef detail::PreparedCallBase<Ret> base_type;                           \
+                                                                               \
+  public:                                                                      \
+    PreparedCall() {}                                                          \
+    explicit PreparedCall(const LuaFunction &function)                         \
+        : base_type(function, N) {}                                            \
+                                                                               \
+    Ret operator()(KAGUYA_PP_ARG_DEF_REPEAT(N)) const {                        \
+      lua_State *state = this->state_;                                         \
+      if (!state) {                                                            \
+        except::typeMismatchError(state, "nil");                               \
+        return Ret();                                                          \
+      }                                                                        \
+      if (!this->reserve_()) {                                                 \
+        return Ret();                                                          \
+      }                                                                        \
+      int argstart = lua_gettop(state) + 1;                                    \
+      this->function_.push(state);                                             \
+      int argnum = util::push_args(state KAGUYA_PP_ARG_REPEAT_CONCAT(N));      \
+      return this->invoke_(argstart, argnum);                                  \
+    }                                                                          \
+  };
+
+KAGUYA_PREPARED_CALL_DEF(0)
+KAGUYA_PP_REPEAT_DEF(KAGUYA_FUNCTION_MAX_ARGS, KAGUYA_PREPARED_CALL_DEF)
+#undef KAGUYA_PREPARED_CALL_DEF
+#endif
+
+template <typename FTYPE> struct lua_type_traits<PreparedCall<FTYPE> > {
+  typedef const PreparedCall<FTYPE> &push_type;
+  typedef PreparedCall<FTYPE> get_type;
+
+  static bool strictCheckType(lua_State *l, int index) {
+    return lua_type(l, index) == LUA_TFUNCTION;
+  }
+  static bool checkType(lua_State *l, int index) {
+    return lua_type(l, index) == LUA_TFUNCTION;
+  }
+  static get_type get(lua_State *l, int index) {
+    if (!l || lua_type(l, index) != LUA_TFUNCTION) {
+      return get_type();
+    }
+    lua_pushvalue(l, index);
+    return get_type(LuaFunction(l, StackTop()));
+  }
+  static int push(lua_State *l, push_type v) {
+    return v.function().push(l);
+  }
+};
+}
@@ -0,0 +1,530 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "kaguya/config.hpp"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <queue>
+#if KAGUYA_USE_CPP11
+#include <future>
+#include <chrono>
+#endif
+#include "kaguya/utility.hpp"
+#include "kaguya/error_handler.hpp"
+#include "kaguya/lua_ref.hpp"
+#include "kaguya/metatable.hpp"
+#include "kaguya/lua_ref_table.hpp"
+#include "kaguya/thread_pool.hpp"
+
+namespace kaguya {
+/// @brief Value a scheduled task waits for from C++.
+/// The scheduler polls ready() on every tick and, once it returns true,
+/// resumes the task with the values pushed by push().
+class Awaitable {
+public:
+  virtual ~Awaitable() {}
+  /// @brief return true if the result can be pushed
+  virtual bool ready() = 0;
+  /// @brief push result values to the task thread
+  /// @return number of pushed values
+  virtual int push(lua_State *state) = 0;
+};
+
+#if KAGUYA_USE_CPP11
+/// @brief Awaitable for std::future
+template <typename T> class FutureAwaitable : public Awaitable {
+public:
+  explicit FutureAwaitable(std::future<T> &&future)
+      : future_(std::move(future)) {}
+  virtual bool ready() {
+    return future_.wait_for(std::chrono::seconds(0)) ==
+           std::future_status::ready;
+  }
+  virtual int push(lua_State *state) {
+    return util::push_args(state, future_.get());
+  }
+
+private:
+  std::future<T> future_;
+};
+template <> class FutureAwaitable<void> : public Awaitable {
+public:
+  explicit FutureAwaitable(std::future<void> &&future)
+      : future_(std::move(future)) {}
+  virtual bool ready() {
+    return future_.wait_for(std::chrono::seconds(0)) ==
+           std::future_status::ready;
+  }
+  virtual int push(lua_State *) {
+    future_.get();
+    return 0;
+  }
+
+private:
+  std::future<void> future_;
+};
+#endif
+
+/// @brief Cooperative scheduler running Lua functions as coroutine tasks.
+///
+/// Tasks are resumed by tick() in FIFO order. Sleeping tasks are kept in
+/// a timer heap, so waking them costs O(log n). A task can wait on a named
+/// event, or a bound lua_CFunction can park it on an Awaitable. In both
+/// cases the values passed back on wake become the results of the call
+/// that yielded. Threads of finished tasks are recycled by a ThreadPool.
+///
+/// Functions for scripts are registered by openLibrary:
+/// sleep(ms), yield(), wait(name), notify(name), spawn(f, ...), now().
+///
+/// Only one scheduler can be attached to a lua_State. It must be destroyed
+/// before the lua_State is closed.
+/// @code
+///   kaguya::Scheduler scheduler(state.state());
+///   scheduler.openLibrary(state["task"] = kaguya::NewTable());
+///   scheduler.spawn(state["main"]);
+///   while (!scheduler.empty()) {
+///     scheduler.tick(now_ms());
+///   }
+/// @endcode
+/// This header is not included by kaguya.hpp.
+class Scheduler {
+public:
+  explicit Scheduler(lua_State *state, size_t max_idle_threads = 256)
+      : state_(util::toMainThread(state)), pool_(state, max_idle_threads),
+        now_(0), timer_seq_(0) {
+    util::ScopedSavedStack save(state_);
+    push_registry_key(state_);
+    lua_pushlightuserdata(state_, this);
+    lua_rawset(state_, LUA_REGISTRYINDEX);
+  }
+  ~Scheduler() {
+    clear();
+    util::ScopedSavedStack save(state_);
+    push_registry_key(state_);
+    lua_pushnil(state_);
+    lua_rawset(state_, LUA_REGISTRYINDEX);
+  }
+
+  /// @brief set sleep, yield, wait, notify, spawn and now to table.
+  void openLibrary(const LuaTable &table) {
+    util::ScopedSavedStack save(state_);
+    table.push(state_);
+    setLibraryFunction("sleep", &task_sleep);
+    setLibraryFunction("yield", &task_yield);
+    setLibraryFunction("wait", &task_wait);
+    setLibraryFunction("notify", &task_notify);
+    setLibraryFunction("spawn", &task_spawn);
+    setLibraryFunction("now", &task_now);
+  }
+
+#if KAGUYA_USE_CPP11
+  /// @brief add task running f(args...) to the run queue.
+  template <class... Args> bool spawn(const LuaFunction &f, Args &&... args) {
+    lua_State *co = newTask();
+    if (!co) {
+      return false;
+    }
+    f.push(co);
+    int argnum = util::push_args(co, std::forward<Args>(args)...);
+    makeReady(task(co), argnum);
+    return true;
+  }
+#else
+  bool spawn(const LuaFunction &f) {
+    lua_State *co = newTask();
+    if (!co) {
+      return false;
+    }
+    f.push(co);
+    makeReady(task(co), 0);
+    return true;
+  }
+#define KAGUYA_SCHEDULER_SPAWN_DEF(N)                                          \
+  template <KAGUYA_PP_TEMPLATE_DEF_REPEAT(N)>                                  \
+  bool spawn(const LuaFunction &f, KAGUYA_PP_ARG_CR_DEF_REPEAT(N)) {           \
+    lua_State *co = newTask();                                                 \
+    if (!co) {                                                                 \
+      return false;                                                            \
+    }                                                                          \
+    f.push(co);                                                                \
+    int argnum = util::push_args(co, KAGUYA_PP_ARG_REPEAT(N));                 \
+    makeReady(task(co), argnum);                                               \
+    return true;                                                               \
+  }
+  KAGUYA_PP_REPEAT_DEF(KAGUYA_FUNCTION_MAX_ARGS, KAGUYA_SCHEDULER_SPAWN_DEF)
+#undef KAGUYA_SCHEDULER_SPAWN_DEF
+#endif
+
+  /// @brief advance time to now, wake due tasks and resume every task that
+  /// was ready at the start of the tick once.
+  /// @param now current time in milliseconds
+  /// @return number of resumed tasks
+  size_t tick(double now) {
+    if (now > now_) {
+      now_ = now;
+    }
+    while (!timers_.empty() && timers_.top().time <= now_) {
+      Timer timer = timers_.top();
+      timers_.pop();
+      Task *sleeping = findTask(timer.thread);
+      if (sleeping && sleeping->status == TASK_SLEEPING &&
+          sleeping->timer_seq == timer.seq) {
+        lua_settop(timer.thread, 0);
+        makeReady(*sleeping, 0);
+      }
+    }
+    pollAwaiting();
+
+    size_t count = run_queue_.size();
+    size_t resumed = 0;
+    for (size_t i = 0; i < count && !run_queue_.empty(); ++i) {
+      lua_State *co = run_queue_.front();
+      run_queue_.pop_front();
+      if (resumeTask(co)) {
+        ++resumed;
+      }
+    }
+    return resumed;
+  }
+
+  /// @brief wake all tasks waiting on event name.
+  /// @return number of woken tasks
+  size_t notify(const std::string &name) {
+    EventMap::iterator it = events_.find(name);
+    if (it == events_.end()) {
+      return 0;
+    }
+    std::vector<lua_State *> waiting;
+    waiting.swap(it->second);
+    events_.erase(it);
+    size_t woken = 0;
+    for (size_t i = 0; i < waiting.size(); ++i) {
+      Task *waiter = findTask(waiting[i]);
+      if (waiter && waiter->status == TASK_WAITING) {
+        lua_settop(waiting[i], 0);
+        makeReady(*waiter, 0);
+        ++woken;
+      }
+    }
+    return woken;
+  }
+
+  /// @brief earliest wake time of sleeping tasks.
+  /// @return false if no task is sleeping
+  bool nextWakeTime(double &time) {
+    while (!timers_.empty()) {
+      const Timer &timer = timers_.top();
+      Task *sleeping = findTask(timer.thread);
+      if (sleeping && sleeping->status == TASK_SLEEPING &&
+          sleeping->timer_seq == timer.seq) {
+        time = timer.time;
+        return true;
+      }
+      timers_.pop();
+    }
+    return false;
+  }
+
+  /// @brief drop all tasks.
+  void clear() {
+    for (TaskMap::iterator it = tasks_.begin(); it != tasks_.end(); ++it) {
+      delete it->second.awaitable;
+    }
+    tasks_.clear();
+    run_queue_.clear();
+    timers_ = TimerQueue();
+    events_.clear();
+    awaiting_.clear();
+  }
+
+  /// @brief current time of scheduler in milliseconds
+  double now() const { return now_; }
+  /// @brief return true if no task is alive
+  bool empty() const { return tasks_.empty(); }
+  /// @brief number of alive tasks
+  size_t taskCount() const { return tasks_.size(); }
+  /// @brief number of tasks in run queue
+  size_t readyCount() const { return run_queue_.size(); }
+  /// @brief thread pool used for task threads
+  const ThreadPool &threadPool() const { return pool_; }
+
+  /// @brief scheduler attached to state, or null.
+  static Scheduler *get(lua_State *state) {
+    util::ScopedSavedStack save(state);
+    push_registry_key(state);
+    lua_rawget(state, LUA_REGISTRYINDEX);
+    return static_cast<Scheduler *>(lua_touserdata(state, -1));
+  }
+
+  /// @brief true if state is the thread of the running task of the
+  /// scheduler attached to it, so await can be called.
+  static bool inTask(lua_State *state) {
+    Scheduler *scheduler = get(state);
+    Task *running = scheduler ? scheduler->findTask(state) : 0;
+    return running && running->status == TASK_RUNNING;
+  }
+
+  /// @brief park the running task until awaitable is ready.
+  /// Use as return value of a lua_CFunction called from a task. The
+  /// scheduler takes ownership of awaitable.
+  /// @code
+  ///   int fetch(lua_State *L) {
+  ///     return kaguya::Scheduler::await(L, new MyAwaitable(...));
+  ///   }
+  /// @endcode
+  static int await(lua_State *state, Awaitable *awaitable) {
+    if (!park(state, awaitable)) {
+      return luaL_error(state, "await must be called in a scheduled task");
+    }
+    return lua_yield(state, 0);
+  }
+  /// @brief park the running task until awaitable is ready, for callers
+  /// that yield the thread by themselves. The scheduler takes ownership of
+  /// awaitable, and deletes it if state is not a running task.
+  /// Values pushed to the thread while parked are kept and count as
+  /// results of awaitable.
+  /// @return false if state is not a running task
+  static bool park(lua_State *state, Awaitable *awaitable) {
+    Scheduler *scheduler = get(state);
+    Task *running = scheduler ? scheduler->findTask(state) : 0;
+    if (!running || running->status != TASK_RUNNING) {
+      delete awaitable;
+      return false;
+    }
+    running->status = TASK_AWAITING;
+    running->awaitable = awaitable;
+    scheduler->awaiting_.push_back(state);
+    return true;
+  }
+#if KAGUYA_USE_CPP11
+  /// @brief park the running task until future is ready. The task is
+  /// resumed with the value of the future.
+  template <typename T>
+  static int await(lua_State *state, std::future<T> &&future) {
+    return await(state, new FutureAwaitable<T>(std::move(future)));
+  }
+#endif
+
+private:
+  enum TaskStatus {
+    TASK_READY,
+    TASK_RUNNING,
+    TASK_SLEEPING,
+    TASK_WAITING,
+    TASK_AWAITING
+  };
+  struct Task {
+    Task()
+        : co(0), status(TASK_READY), argnum(0), timer_seq(0), awaitable(0) {}
+    LuaThread thread;
+    lua_State *co;
+    TaskStatus status;
+    int argnum;
+    unsigned long timer_seq;
+    Awaitable *awaitable;
+  };
+  struct Timer {
+    double time;
+    unsigned long seq;
+    lua_State *thread;
+  };
+  struct TimerLater {
+    bool operator()(const Timer &lhs, const Timer &rhs) const {
+      return lhs.time > rhs.time ||
+             (lhs.time == rhs.time && lhs.seq > rhs.seq);
+    }
+  };
+  typedef std::map<lua_State *, Task> TaskMap;
+  typedef std::map<std::string, std::vector<lua_State *> > EventMap;
+  typedef std::priority_queue<Timer, std::vector<Timer>, TimerLater>
+      TimerQueue;
+
+#if KAGUYA_SUPPORT_MULTIPLE_SHARED_LIBRARY
+  static void push_registry_key(lua_State *state) {
+    lua_pushstring(state, "\x80KAGUYA_SCHEDULER_REGISTRY_KEY");
+  }
+#else
+  static void push_registry_key(lua_State *state) {
+    static int key;
+    lua_pushlightuserdata(state, &key);
+  }
+#endif
+
+  void setLibraryFunction(const char *name, lua_CFunction f) {
+    lua_pushcfunction(state_, f);
+    lua_setfield(state_, -2, name);
+  }
+
+  lua_State *newTask() {
+    LuaThread thread = pool_.acquire();
+    lua_State *co = thread.getthread();
+    if (!co) {
+      return 0;
+    }
+    Task &added = tasks_[co];
+    added.thread.swap(thread);
+    added.co = co;
+    return co;
+  }
+  Task &task(lua_State *co) { return tasks_[co]; }
+  Task *findTask(lua_State *co) {
+    TaskMap::iterator it = tasks_.find(co);
+    return it == tasks_.end() ? 0 : &it->second;
+  }
+  void makeReady(Task &ready, int argnum) {
+    ready.status = TASK_READY;
+    ready.argnum = argnum;
+    run_queue_.push_back(ready.co);
+  }
+
+  void pollAwaiting() {
+    size_t keep = 0;
+    for (size_t i = 0; i < awaiting_.size(); ++i) {
+      lua_State *co = awaiting_[i];
+      Task *waiter = findTask(co);
+      if (!waiter || waiter->status != TASK_AWAITING) {
+        continue;
+      }
+      if (!waiter->awaitable->ready()) {
+        awaiting_[keep++] = co;
+        continue;
+      }
+      Awaitable *awaitable = waiter->awaitable;
+      waiter->awaitable = 0;
+      int argnum = 0;
+#if KAGUYA_NO_EXCEPTIONS
+      argnum = awaitable->push(co);
+#else
+      try {
+        argnum = awaitable->push(co);
+      } catch (...) {
+        delete awaitable;
+        awaiting_.erase(awaiting_.begin() + keep,
+                        awaiting_.begin() + i + 1);
+        throw;
+      }
+#endif
+      delete awaitable;
+      makeReady(*waiter, argnum);
+    }
+    awaiting_.resize(keep);
+  }
+
+  bool resumeTask(lua_State *co) {
+    TaskMap::iterator it = tasks_.find(co);
+    if (it == tasks_.end() || it->second.status != TASK_READY) {
+      return false;
+    }
+    Task &running = it->second;
+    running.status = TASK_RUNNING;
+    int argnum = running.argnum;
+    running.argnum = 0;
+    int status = lua_resume(co, state_, argnum);
+    if (status == LUA_YIELD) {
+      if (running.status == TASK_RUNNING) {
+        // plain coroutine.yield. values are discarded
+        lua_settop(co, 0);
+        makeReady(running, 0);
+      }
+      return true;
+    }
+    LuaThread finished;
+    finished.swap(running.thread);
+    tasks_.erase(it);
+    if (status == 0) {
+      pool_.release(finished);
+    } else {
+      ErrorHandler::handle(status, co);
+    }
+    return true;
+  }
+
+  static Scheduler *running_scheduler(lua_State *L, Task *&running) {
+    Scheduler *scheduler = get(L);
+    running = scheduler ? scheduler->findTask(L) : 0;
+    if (!running || running->status != TASK_RUNNING) {
+      luaL_error(L, "must be called in a scheduled task");
+      return 0;
+    }
+    return scheduler;
+  }
+
+  static int task_sleep(lua_State *L) {
+    lua_Number ms = luaL_optnumber(L, 1, 0);
+    Task *running = 0;
+    Scheduler *scheduler = running_scheduler(L, running);
+    Timer timer;
+    timer.time = scheduler->now_ + static_cast<double>(ms);
+    timer.seq = ++scheduler->timer_seq_;
+    timer.thread = L;
+    scheduler->timers_.push(timer);
+    running->status = TASK_SLEEPING;
+    running->timer_seq = timer.seq;
+    return lua_yield(L, 0);
+  }
+  static int task_yield(lua_State *L) {
+    Task *running = 0;
+    Scheduler *scheduler = running_scheduler(L, running);
+    lua_settop(L, 0);
+    scheduler->makeReady(*running, 0);
+    return lua_yield(L, 0);
+  }
+  static int task_wait(lua_State *L) {
+    const char *name = luaL_checkstring(L, 1);
+    Task *running = 0;
+    Scheduler *scheduler = running_scheduler(L, running);
+    scheduler->events_[name].push_back(L);
+    running->status = TASK_WAITING;
+    return lua_yield(L, 0);
+  }
+  static int task_notify(lua_State *L) {
+    const char *name = luaL_checkstring(L, 1);
+    Scheduler *scheduler = get(L);
+    if (!scheduler) {
+      return luaL_error(L, "scheduler is not available");
+    }
+    lua_pushnumber(L, static_cast<lua_Number>(scheduler->notify(name)));
+    return 1;
+  }
+  static int task_spawn(lua_State *L) {
+    luaL_checktype(L, 1, LUA_TFUNCTION);
+    Scheduler *scheduler = get(L);
+    if (!scheduler) {
+      return luaL_error(L, "scheduler is not available");
+    }
+    int argnum = lua_gettop(L) - 1;
+    lua_State *co = scheduler->newTask();
+    if (!co) {
+      return luaL_error(L, "can not create thread");
+    }
+    lua_xmove(L, co, argnum + 1);
+    scheduler->makeReady(scheduler->task(co), argnum);
+    return 0;
+  }
+  static int task_now(lua_State *L) {
+    Scheduler *scheduler = get(L);
+    lua_pushnumber(L, scheduler ? scheduler->now_ : 0);
+    return 1;
+  }
+
+  Scheduler(const Scheduler &);
+  Scheduler &operator=(const Scheduler &);
+
+  lua_State *state_;
+  ThreadPool pool_;
+  double now_;
+  unsigned long timer_seq_;
+  TaskMap tasks_;
+  std::deque<lua_State *> run_queue_;
+  TimerQueue timers_;
+  EventMap events_;
+  std::vector<lua_State *> awaiting_;
+};
+}
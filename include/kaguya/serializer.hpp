@@ -0,0 +1,868 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include "kaguya/config.hpp"
+#include "kaguya/utility.hpp"
+#include "kaguya/error_handler.hpp"
+#include "kaguya/object.hpp"
+#include "kaguya/type.hpp"
+#include "kaguya/lua_ref.hpp"
+
+namespace kaguya {
+namespace detail {
+// open addressing map from table and userdata addresses to Serializer ids
+class serializer_ref_map {
+public:
+  struct entry {
+    entry() : key(0), id(0), pos(0) {}
+    const void *key;
+    lua_Integer id; // negative while pending
+    size_t pos;     // offset of tag in output
+  };
+
+  serializer_ref_map() : size_(0) {}
+  // entry of key, or null if not found
+  entry *find(const void *key) {
+    if (entries_.empty()) {
+      return 0;
+    }
+    for (size_t i = slot(key);; i = (i + 1) & (entries_.size() - 1)) {
+      if (entries_[i].key == key) {
+        return &entries_[i];
+      }
+      if (!entries_[i].key) {
+        return 0;
+      }
+    }
+  }
+  void insert(const entry &e) {
+    if ((size_ + 1) * 2 > entries_.size()) {
+      grow();
+    }
+    size_t i = slot(e.key);
+    while (entries_[i].key) {
+      i = (i + 1) & (entries_.size() - 1);
+    }
+    entries_[i] = e;
+    ++size_;
+  }
+
+private:
+  size_t slot(const void *key) const {
+    size_t h = reinterpret_cast<size_t>(key);
+    h ^= h >> 16;
+    h *= 0x45d9f3bu;
+    h ^= h >> 16;
+    return h & (entries_.size() - 1);
+  }
+  void grow() {
+    std::vector<entry> old;
+    old.swap(entries_);
+    entries_.resize(old.empty() ? 64 : old.size() * 2);
+    size_ = 0;
+    for (size_t i = 0; i < old.size(); ++i) {
+      if (old[i].key) {
+        insert(old[i]);
+      }
+    }
+  }
+  std::vector<entry> entries_;
+  size_t size_;
+};
+}
+
+/// @brief Compact binary serializer of Lua values.
+///
+/// Encodes nil, boolean, number, integer, string, table and userdata into
+/// a byte string which can be decoded into any State, e.g. for messages
+/// between States of WorkerPool. Tables referenced more than once, including
+/// cycles, are encoded once and decoded as the same table. Decoded tables
+/// are created with the array and hash sizes of the encoded tables.
+///
+/// Userdata opts in by metamethods: __serialize(self) returns serializable
+/// value, and __deserialize(value) of the metatable that has the same
+/// __name in the destination State creates the userdata again.
+/// The metatable must be registered in the destination State before decode.
+/// Functions, threads and light userdata are not serializable.
+/// e.g.
+/// @code
+/// state["pack"] = kaguya::luacfunction(&kaguya::Serializer::pack);
+/// state["unpack"] = kaguya::luacfunction(&kaguya::Serializer::unpack);
+/// state("t = unpack(pack({1, 2, 3, name = 'kaguya'}))");
+/// @endcode
+class Serializer {
+public:
+  /// @brief append encoded value at index to out.
+  /// On error, out is unchanged and error handler is called.
+  static bool encode(lua_State *state, int index, std::string &out) {
+    util::ScopedSavedStack save(state);
+    size_t size = out.size();
+    int status = encode_status(state, index, out);
+    if (status != 0) {
+      out.resize(size);
+      ErrorHandler::handle(status, state);
+      return false;
+    }
+    return true;
+  }
+  /// @brief push decoded value. On error, push nil and call error handler.
+  static bool decode(lua_State *state, const void *data, size_t size) {
+    int top = lua_gettop(state);
+    int status = decode_status(state, data, size);
+    if (status != 0) {
+      {
+        util::ScopedSavedStack save(state, top);
+        ErrorHandler::handle(status, state);
+      }
+      lua_pushnil(state);
+      return false;
+    }
+    return true;
+  }
+  /// @brief encode value at index in from and decode it into to.
+  static bool transfer(lua_State *from, int index, lua_State *to) {
+    std::string buffer;
+    if (!encode(from, index, buffer)) {
+      lua_pushnil(to);
+      return false;
+    }
+    return decode(to, buffer.data(), buffer.size());
+  }
+
+  /// @brief lua_CFunction pack(value) -> string
+  static int pack(lua_State *state) {
+    lua_settop(state, 1);
+    if (!pack_to_string(state)) {
+      return lua_error(state);
+    }
+    return 1;
+  }
+  /// @brief lua_CFunction unpack(string) -> value
+  static int unpack(lua_State *state) {
+    size_t size = 0;
+    const char *data = luaL_checklstring(state, 1, &size);
+    lua_settop(state, 1);
+    if (decode_status(state, data, size) != 0) {
+      return lua_error(state);
+    }
+    return 1;
+  }
+
+  /// @brief encode value at index or leave error message on the stack.
+  /// @return 0 on success or status of lua_pcall
+  static int encode_status(lua_State *state, int index, std::string &out) {
+    index = lua_absindex(state, index);
+    if (!lua_checkstack(state, 4)) {
+      lua_pushstring(state, "stack overflow");
+      return LUA_ERRMEM;
+    }
+    // containers live out of pcall, lua_error does not unwind C++ objects
+    detail::serializer_ref_map refs;
+    lua_pushcfunction(state, &encode_function);
+    lua_pushvalue(state, index);
+    lua_pushlightuserdata(state, &out);
+    lua_pushlightuserdata(state, &refs);
+    return lua_pcall(state, 3, 0, 0);
+  }
+  /// @brief push decoded value or error message.
+  /// @return 0 on success or status of lua_pcall
+  static int decode_status(lua_State *state, const void *data, size_t size) {
+    reader_type reader;
+    reader.pos = static_cast<const unsigned char *>(data);
+    reader.end = reader.pos + size;
+    reader.refs = 0;
+    reader.strings = 0;
+    reader.next_id = 0;
+    reader.depth = 0;
+    if (!lua_checkstack(state, 4)) {
+      lua_pushstring(state, "stack overflow");
+      return LUA_ERRMEM;
+    }
+    lua_pushcfunction(state, &decode_function);
+    lua_pushlightuserdata(state, &reader);
+    return lua_pcall(state, 1, 1, 0);
+  }
+
+private:
+  enum {
+    FORMAT_MAGIC = 0x4b, // 'K'
+    FORMAT_VERSION = 1,
+    MAX_DEPTH = 200,
+    // short strings are cached in slots by hash of contents, and written
+    // as slot number while the slot has the same string. Decoder caches
+    // strings marked by TAG_STRING_CACHED only.
+    STRING_CACHE_MIN = 2,
+    STRING_CACHE_MAX = 40,
+    STRING_CACHE_SIZE = 256
+  };
+  enum Tag {
+    TAG_NIL,
+    TAG_FALSE,
+    TAG_TRUE,
+    TAG_INTEGER,  // zigzag varint
+    TAG_NUMBER,   // little endian double
+    TAG_STRING,   // varint length, bytes
+    TAG_TABLE,    // varint narr, u32 nhash, array values, key value pairs
+    TAG_REF,      // varint id of table or userdata written before
+    TAG_USERDATA, // __name string, value of __serialize
+    TAG_TABLE_SHARED,  // TAG_TABLE referenced by TAG_REF
+    TAG_STRING_CACHED, // TAG_STRING referenced by TAG_STRING_REF
+    TAG_STRING_REF,    // string cache slot
+    TAG_SMALL_INTEGER = 0x80 // 0x80 + n for integer 0 <= n < 128
+  };
+#if LUA_VERSION_NUM >= 503
+  typedef lua_Unsigned unsigned_type;
+#else
+  typedef size_t unsigned_type;
+#endif
+
+  struct writer_type {
+    std::string *out;
+    detail::serializer_ref_map *refs; // negative id while pending
+    lua_Integer next_id;
+    int keep; // stack index of table of __serialize values
+    int keep_count;
+    int depth;
+    const char *strings[STRING_CACHE_SIZE];
+    size_t string_pos[STRING_CACHE_SIZE]; // offset of tag of the string
+  };
+  struct reader_type {
+    const unsigned char *pos;
+    const unsigned char *end;
+    int refs; // stack index of table: id -> value
+    int strings; // stack index of table: slot + 1 -> string
+    lua_Integer next_id;
+    int depth;
+  };
+
+  static bool pack_to_string(lua_State *state) {
+    std::string out;
+    if (encode_status(state, 1, out) != 0) {
+      return false;
+    }
+    lua_pushlstring(state, out.data(), out.size());
+    return true;
+  }
+
+  static bool host_is_big_endian() {
+    const unsigned int one = 1;
+    return *reinterpret_cast<const unsigned char *>(&one) == 0;
+  }
+
+  // encode
+  static int encode_function(lua_State *state) {
+    writer_type w;
+    w.out = static_cast<std::string *>(lua_touserdata(state, 2));
+    w.refs =
+        static_cast<detail::serializer_ref_map *>(lua_touserdata(state, 3));
+    lua_newtable(state);
+    w.keep = lua_gettop(state);
+    w.next_id = 0;
+    w.keep_count = 0;
+    w.depth = 0;
+    std::fill(w.strings, w.strings + STRING_CACHE_SIZE,
+              static_cast<const char *>(0));
+    w.out->push_back(static_cast<char>(FORMAT_MAGIC));
+    w.out->push_back(static_cast<char>(FORMAT_VERSION));
+    write_value(state, w, 1);
+    return 0;
+  }
+  static void put(writer_type &w, unsigned char byte) {
+    w.out->push_back(static_cast<char>(byte));
+  }
+  static void put_varint(writer_type &w, unsigned_type v) {
+    while (v >= 0x80) {
+      put(w, static_cast<unsigned char>(v | 0x80));
+      v >>= 7;
+    }
+    put(w, static_cast<unsigned char>(v));
+  }
+  static void put_integer(writer_type &w, lua_Integer v) {
+    if (v >= 0 && v < 0x80) {
+      put(w, static_cast<unsigned char>(TAG_SMALL_INTEGER + v));
+      return;
+    }
+    unsigned_type u = static_cast<unsigned_type>(v);
+    put(w, TAG_INTEGER);
+    put_varint(w, v < 0 ? ~(u << 1) : (u << 1));
+  }
+  static void put_number(writer_type &w, lua_Number v) {
+    double d = static_cast<double>(v);
+    unsigned char bytes[sizeof(double)];
+    std::memcpy(bytes, &d, sizeof(double));
+    if (host_is_big_endian()) {
+      std::reverse(bytes, bytes + sizeof(double));
+    }
+    put(w, TAG_NUMBER);
+    w.out->append(reinterpret_cast<const char *>(bytes), sizeof(double));
+  }
+  static void put_string(writer_type &w, const char *data, size_t size) {
+    put_varint(w, static_cast<unsigned_type>(size));
+    w.out->append(data, size);
+  }
+  static bool is_cached_string_size(size_t size) {
+    return size >= STRING_CACHE_MIN && size <= STRING_CACHE_MAX;
+  }
+  static unsigned char string_slot(const char *data, size_t size) {
+    unsigned int h = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < size; ++i) {
+      h = (h ^ static_cast<unsigned char>(data[i])) * 16777619u;
+    }
+    return static_cast<unsigned char>(h ^ (h >> 8) ^ (h >> 16) ^ (h >> 24));
+  }
+  // write reference if value at index is written before, or assign new id
+  static bool put_ref(lua_State *state, writer_type &w, int index,
+                      bool pending) {
+    const void *key = lua_topointer(state, index);
+    detail::serializer_ref_map::entry *found = w.refs->find(key);
+    if (!found) {
+      detail::serializer_ref_map::entry e;
+      e.key = key;
+      e.id = pending ? -(++w.next_id) : ++w.next_id;
+      e.pos = w.out->size();
+      w.refs->insert(e);
+      return false;
+    }
+    lua_Integer id = found->id;
+    if (id < 0) {
+      luaL_error(state, "userdata referenced from its __serialize value");
+    }
+    // decoder keeps tables referenced later only
+    char &tag = (*w.out)[found->pos];
+    if (tag == static_cast<char>(TAG_TABLE)) {
+      tag = static_cast<char>(TAG_TABLE_SHARED);
+    }
+    put(w, TAG_REF);
+    put_varint(w, static_cast<unsigned_type>(id));
+    return true;
+  }
+  // true if key at index is in array part written by write_table
+  static bool is_array_key(lua_State *state, int index, size_t narr) {
+    if (lua_type(state, index) != LUA_TNUMBER) {
+      return false;
+    }
+#if LUA_VERSION_NUM >= 503
+    if (!lua_isinteger(state, index)) {
+      return false;
+    }
+    lua_Integer key = lua_tointeger(state, index);
+    return key >= 1 && static_cast<size_t>(key) <= narr;
+#else
+    lua_Number key = lua_tonumber(state, index);
+    return key >= 1 && key <= static_cast<lua_Number>(narr) &&
+           key == static_cast<lua_Number>(static_cast<size_t>(key));
+#endif
+  }
+
+  static void write_value(lua_State *state, writer_type &w, int index) {
+    switch (lua_type(state, index)) {
+    case LUA_TNIL:
+      put(w, TAG_NIL);
+      break;
+    case LUA_TBOOLEAN:
+      put(w, lua_toboolean(state, index) ? TAG_TRUE : TAG_FALSE);
+      break;
+    case LUA_TNUMBER:
+      write_number(w, state, index);
+      break;
+    case LUA_TSTRING: {
+      size_t size = 0;
+      const char *data = lua_tolstring(state, index, &size);
+      if (is_cached_string_size(size)) {
+        // short strings are interned, same contents has same address
+        unsigned char slot = string_slot(data, size);
+        if (w.strings[slot] == data) {
+          (*w.out)[w.string_pos[slot]] = static_cast<char>(TAG_STRING_CACHED);
+          put(w, TAG_STRING_REF);
+          put(w, slot);
+          break;
+        }
+        w.strings[slot] = data;
+        w.string_pos[slot] = w.out->size();
+      }
+      put(w, TAG_STRING);
+      put_string(w, data, size);
+      break;
+    }
+    case LUA_TTABLE:
+      if (!put_ref(state, w, index, false)) {
+        write_table(state, w, index);
+      }
+      break;
+    case LUA_TUSERDATA:
+      write_userdata(state, w, index);
+      break;
+    default:
+      luaL_error(state, "%s is not serializable",
+                 luaL_typename(state, index));
+    }
+  }
+  static void write_number(writer_type &w, lua_State *state, int index) {
+#if LUA_VERSION_NUM >= 503
+    if (lua_isinteger(state, index)) {
+      put_integer(w, lua_tointeger(state, index));
+      return;
+    }
+#else
+    // integral numbers in exact range of double are written as integer
+    lua_Number v = lua_tonumber(state, index);
+    const lua_Number limit = 9007199254740992.0; // 2^53
+    if (v == v && v > -limit && v < limit &&
+        v >= static_cast<lua_Number>(
+                 (std::numeric_limits<lua_Integer>::min)()) &&
+        v <= static_cast<lua_Number>(
+                 (std::numeric_limits<lua_Integer>::max)()) &&
+        static_cast<lua_Number>(static_cast<lua_Integer>(v)) == v &&
+        (v != 0 || 1 / v > 0)) {
+      put_integer(w, static_cast<lua_Integer>(v));
+      return;
+    }
+#endif
+    put_number(w, lua_tonumber(state, index));
+  }
+  static void enter(lua_State *state, int &depth) {
+    if (++depth > MAX_DEPTH) {
+      luaL_error(state, "serialization nested too deep");
+    }
+    luaL_checkstack(state, 4, "serialization nested too deep");
+  }
+  static void write_table(lua_State *state, writer_type &w, int index) {
+    enter(state, w.depth);
+    size_t narr = lua_rawlen(state, index);
+    put(w, TAG_TABLE);
+    put_varint(w, static_cast<unsigned_type>(narr));
+    size_t nhash_pos = w.out->size();
+    w.out->append(4, '\0');
+    for (size_t i = 1; i <= narr; ++i) {
+      lua_rawgeti(state, index, static_cast<lua_Integer>(i));
+      write_value(state, w, lua_gettop(state));
+      lua_pop(state, 1);
+    }
+    unsigned int nhash = 0;
+    lua_pushnil(state);
+    while (lua_next(state, index)) {
+      int key = lua_gettop(state) - 1;
+      if (!is_array_key(state, key, narr)) {
+        write_value(state, w, key);
+        write_value(state, w, key + 1);
+        ++nhash;
+      }
+      lua_pop(state, 1);
+    }
+    for (int i = 0; i < 4; ++i) {
+      (*w.out)[nhash_pos + i] = static_cast<char>((nhash >> (8 * i)) & 0xff);
+    }
+    --w.depth;
+  }
+  static void write_userdata(lua_State *state, writer_type &w, int index) {
+    if (!lua_getmetatable(state, index)) {
+      luaL_error(state, "userdata without metatable is not serializable");
+    }
+    int metatable = lua_gettop(state);
+    lua_getfield(state, metatable, "__name");
+    if (lua_type(state, -1) != LUA_TSTRING) {
+      luaL_error(state, "userdata without __name is not serializable");
+    }
+    lua_getfield(state, metatable, "__serialize");
+    if (lua_type(state, -1) != LUA_TFUNCTION) {
+      luaL_error(state, "%s is not serializable", lua_tostring(state, -2));
+    }
+    if (put_ref(state, w, index, true)) {
+      lua_settop(state, metatable - 1);
+      return;
+    }
+    enter(state, w.depth);
+    size_t size = 0;
+    const char *name = lua_tolstring(state, metatable + 1, &size);
+    put(w, TAG_USERDATA);
+    put_string(w, name, size);
+    lua_pushvalue(state, index);
+    lua_call(state, 1, 1);
+    write_value(state, w, lua_gettop(state));
+    // the value must live while its addresses are in refs and string cache
+    lua_rawseti(state, w.keep, ++w.keep_count);
+    // userdata is completed, references to it are valid now
+    detail::serializer_ref_map::entry *e =
+        w.refs->find(lua_topointer(state, index));
+    e->id = -e->id;
+    lua_settop(state, metatable - 1);
+    --w.depth;
+  }
+
+  // decode
+  static int decode_function(lua_State *state) {
+    reader_type *r = static_cast<reader_type *>(lua_touserdata(state, 1));
+    lua_newtable(state);
+    r->refs = lua_gettop(state);
+    lua_createtable(state, STRING_CACHE_SIZE, 0);
+    r->strings = lua_gettop(state);
+    if (r->end - r->pos < 2 || r->pos[0] != FORMAT_MAGIC) {
+      return luaL_error(state, "not serialized data");
+    }
+    if (r->pos[1] != FORMAT_VERSION) {
+      return luaL_error(state, "unsupported serialized data version %d",
+                        static_cast<int>(r->pos[1]));
+    }
+    r->pos += 2;
+    read_value(state, *r);
+    if (r->pos != r->end) {
+      return malformed(state);
+    }
+    return 1;
+  }
+  static int malformed(lua_State *state) {
+    return luaL_error(state, "malformed serialized data");
+  }
+  static unsigned char get(lua_State *state, reader_type &r) {
+    if (r.pos == r.end) {
+      malformed(state);
+    }
+    return *r.pos++;
+  }
+  static unsigned_type get_varint(lua_State *state, reader_type &r) {
+    unsigned_type v = 0;
+    for (unsigned int shift = 0;; shift += 7) {
+      if (shift >= sizeof(unsigned_type) * 8) {
+        malformed(state);
+      }
+      unsigned char byte = get(state, r);
+      v |= static_cast<unsigned_type>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        return v;
+      }
+    }
+  }
+  // varint count of items, each item takes one byte or more
+  static size_t get_count(lua_State *state, reader_type &r) {
+    unsigned_type v = get_varint(state, r);
+    if (v > static_cast<unsigned_type>(r.end - r.pos)) {
+      malformed(state);
+    }
+    return static_cast<size_t>(v);
+  }
+  static const char *get_bytes(lua_State *state, reader_type &r,
+                               size_t &size) {
+    size = get_count(state, r);
+    const char *data = reinterpret_cast<const char *>(r.pos);
+    r.pos += size;
+    return data;
+  }
+  static void set_ref(lua_State *state, reader_type &r, lua_Integer id,
+                      int index) {
+    lua_pushvalue(state, index);
+    lua_rawseti(state, r.refs, id);
+  }
+
+  static void read_value(lua_State *state, reader_type &r) {
+    unsigned char tag = get(state, r);
+    if (tag >= TAG_SMALL_INTEGER) {
+      lua_pushinteger(state, static_cast<lua_Integer>(tag - TAG_SMALL_INTEGER));
+      return;
+    }
+    switch (tag) {
+    case TAG_NIL:
+      lua_pushnil(state);
+      break;
+    case TAG_FALSE:
+    case TAG_TRUE:
+      lua_pushboolean(state, tag == TAG_TRUE);
+      break;
+    case TAG_INTEGER: {
+      unsigned_type u = get_varint(state, r);
+      u = (u >> 1) ^ (unsigned_type(0) - (u & 1));
+      lua_pushinteger(state, static_cast<lua_Integer>(u));
+      break;
+    }
+    case TAG_NUMBER: {
+      if (r.end - r.pos < static_cast<ptrdiff_t>(sizeof(double))) {
+        malformed(state);
+      }
+      unsigned char bytes[sizeof(double)];
+      std::memcpy(bytes, r.pos, sizeof(double));
+      if (host_is_big_endian()) {
+        std::reverse(bytes, bytes + sizeof(double));
+      }
+      double d;
+      std::memcpy(&d, bytes, sizeof(double));
+      r.pos += sizeof(double);
+      lua_pushnumber(state, static_cast<lua_Number>(d));
+      break;
+    }
+    case TAG_STRING:
+    case TAG_STRING_CACHED: {
+      size_t size = 0;
+      const char *data = get_bytes(state, r, size);
+      lua_pushlstring(state, data, size);
+      if (tag == TAG_STRING_CACHED) {
+        if (!is_cached_string_size(size)) {
+          malformed(state);
+        }
+        lua_pushvalue(state, -1);
+        lua_rawseti(state, r.strings, string_slot(data, size) + 1);
+      }
+      break;
+    }
+    case TAG_STRING_REF:
+      lua_rawgeti(state, r.strings, get(state, r) + 1);
+      if (lua_type(state, -1) != LUA_TSTRING) {
+        malformed(state);
+      }
+      break;
+    case TAG_TABLE:
+    case TAG_TABLE_SHARED:
+      read_table(state, r, tag == TAG_TABLE_SHARED);
+      break;
+    case TAG_REF: {
+      unsigned_type id = get_varint(state, r);
+      if (id == 0 || id > static_cast<unsigned_type>(r.next_id)) {
+        malformed(state);
+      }
+      lua_rawgeti(state, r.refs, static_cast<lua_Integer>(id));
+      if (lua_isnil(state, -1)) {
+        malformed(state);
+      }
+      break;
+    }
+    case TAG_USERDATA:
+      read_userdata(state, r);
+      break;
+    default:
+      malformed(state);
+    }
+  }
+  static void read_table(lua_State *state, reader_type &r, bool shared) {
+    enter(state, r.depth);
+    size_t narr = get_count(state, r);
+    if (r.end - r.pos < 4) {
+      malformed(state);
+    }
+    unsigned int nhash = 0;
+    for (int i = 0; i < 4; ++i) {
+      nhash |= static_cast<unsigned int>(r.pos[i]) << (8 * i);
+    }
+    r.pos += 4;
+    // each pair takes two bytes or more
+    if (nhash > static_cast<size_t>(r.end - r.pos) / 2 ||
+        narr > static_cast<size_t>((std::numeric_limits<int>::max)()) ||
+        nhash > static_cast<unsigned int>((std::numeric_limits<int>::max)())) {
+      malformed(state);
+    }
+    lua_createtable(state, static_cast<int>(narr), static_cast<int>(nhash));
+    int table = lua_gettop(state);
+    ++r.next_id;
+    if (shared) {
+      set_ref(state, r, r.next_id, table);
+    }
+    for (size_t i = 1; i <= narr; ++i) {
+      read_value(state, r);
+      lua_rawseti(state, table, static_cast<lua_Integer>(i));
+    }
+    for (unsigned int i = 0; i < nhash; ++i) {
+      read_value(state, r);
+      if (lua_isnil(state, -1)) {
+        malformed(state);
+      }
+      read_value(state, r);
+      lua_rawset(state, table);
+    }
+    --r.depth;
+  }
+  static void read_userdata(lua_State *state, reader_type &r) {
+    enter(state, r.depth);
+    size_t size = 0;
+    const char *data = get_bytes(state, r, size);
+    lua_pushlstring(state, data, size);
+    int name = lua_gettop(state);
+    lua_Integer id = ++r.next_id;
+    if (!get_metatable_by_name(state, name)) {
+      luaL_error(state, "%s is not registered", lua_tostring(state, name));
+    }
+    lua_getfield(state, -1, "__deserialize");
+    if (lua_type(state, -1) != LUA_TFUNCTION) {
+      luaL_error(state, "%s is not deserializable",
+                 lua_tostring(state, name));
+    }
+    read_value(state, r);
+    lua_call(state, 1, 1);
+    set_ref(state, r, id, -1);
+    lua_replace(state, name);
+    lua_settop(state, name);
+    --r.depth;
+  }
+
+#if KAGUYA_SUPPORT_MULTIPLE_SHARED_LIBRARY
+  static void push_registry_key(lua_State *state) {
+    lua_pushstring(state, "\x80KAGUYA_SERIALIZER_METATABLE_KEY");
+  }
+#else
+  static void push_registry_key(lua_State *state) {
+    static int key;
+    lua_pushlightuserdata(state, &key);
+  }
+#endif
+  // push metatable of __name at name index.
+  // Found metatables are cached in the registry.
+  static bool get_metatable_by_name(lua_State *state, int name) {
+    push_registry_key(state);
+    lua_rawget(state, LUA_REGISTRYINDEX);
+    if (!lua_istable(state, -1)) {
+      lua_pop(state, 1);
+      lua_newtable(state);
+      push_registry_key(state);
+      lua_pushvalue(state, -2);
+      lua_rawset(state, LUA_REGISTRYINDEX);
+    }
+    int cache = lua_gettop(state);
+    lua_pushvalue(state, name);
+    lua_rawget(state, cache);
+    if (lua_istable(state, -1)) {
+      lua_remove(state, cache);
+      return true;
+    }
+    lua_pop(state, 1);
+    if (!find_metatable(state, name)) {
+      lua_pop(state, 1);
+      return false;
+    }
+    lua_pushvalue(state, name);
+    lua_pushvalue(state, -2);
+    lua_rawset(state, cache);
+    lua_remove(state, cache);
+    return true;
+  }
+  // metatable created by luaL_newmetatable or registered class
+  static bool find_metatable(lua_State *state, int name) {
+    lua_pushvalue(state, name);
+    lua_rawget(state, LUA_REGISTRYINDEX);
+    if (lua_istable(state, -1)) {
+      return true;
+    }
+    lua_pop(state, 1);
+#if KAGUYA_SUPPORT_MULTIPLE_SHARED_LIBRARY
+    lua_pushstring(state, metatable_type_table_key());
+#else
+    lua_pushlightuserdata(state, metatable_type_table_key());
+#endif
+    lua_rawget(state, LUA_REGISTRYINDEX);
+    if (!lua_istable(state, -1)) {
+      return false;
+    }
+    int types = lua_gettop(state);
+    lua_pushnil(state);
+    while (lua_next(state, types)) {
+      if (lua_istable(state, -1)) {
+        lua_getfield(state, -1, "__name");
+        bool found = lua_rawequal(state, -1, name) != 0;
+        lua_pop(state, 1);
+        if (found) {
+          lua_replace(state, types);
+          lua_pop(state, 1);
+          return true;
+        }
+      }
+      lua_pop(state, 1);
+    }
+    return false;
+  }
+};
+
+/// @brief Serialized Lua value. Pushed as decoded value.
+///
+/// Usable as argument and result type to copy Lua values between States,
+/// e.g. with WorkerPool.
+/// @code
+/// kaguya::SerializedValue v = state["config"];
+/// other_state["config"] = v;
+/// @endcode
+class SerializedValue {
+public:
+  SerializedValue() {}
+  /// @brief from encoded bytes by Serializer
+  explicit SerializedValue(const std::string &data) : data_(data) {}
+
+  /// @brief encoded bytes. empty if default constructed
+  const std::string &data() const { return data_; }
+  bool empty() const { return data_.empty(); }
+  size_t size() const { return data_.size(); }
+  /// @brief exchange encoded bytes with data without copy
+  void swap(std::string &data) { data_.swap(data); }
+
+  /// @brief decode into state. default constructed value is nil.
+  LuaRef get(lua_State *state) const;
+
+private:
+  std::string data_;
+};
+
+/// @ingroup lua_type_traits
+/// @brief lua_type_traits for SerializedValue.
+/// get serializes the value, push deserializes it.
+template <> struct lua_type_traits<SerializedValue> {
+  typedef SerializedValue get_type;
+  typedef const SerializedValue &push_type;
+
+  static bool strictCheckType(lua_State *l, int index) {
+    return checkType(l, index);
+  }
+  static bool checkType(lua_State *l, int index) {
+    int type = lua_type(l, index);
+    return type != LUA_TFUNCTION && type != LUA_TTHREAD &&
+           type != LUA_TLIGHTUSERDATA;
+  }
+  static get_type get(lua_State *l, int index) {
+    util::ScopedSavedStack save(l);
+    std::string data;
+    if (Serializer::encode_status(l, index, data) != 0) {
+      KAGUYA_THROW(LuaTypeMismatch(get_error_message(l)));
+    }
+    SerializedValue value;
+    value.swap(data);
+    return value;
+  }
+  static int push(lua_State *l, push_type v) {
+    if (v.empty()) {
+      lua_pushnil(l);
+      return 1;
+    }
+    Serializer::decode(l, v.data().data(), v.size());
+    return 1;
+  }
+};
+template <>
+struct lua_type_traits<const SerializedValue &>
+    : lua_type_traits<SerializedValue> {};
+
+inline LuaRef SerializedValue::get(lua_State *state) const {
+  util::ScopedSavedStack save(state);
+  lua_type_traits<SerializedValue>::push(state, *this);
+  return LuaRef(state, StackTop());
+}
+
+/// @brief encode value by Serializer. empty string on error.
+inline std::string serialize(const LuaRef &value) {
+  std::string out;
+  lua_State *state = value.state();
+  if (!state) {
+    return out;
+  }
+  util::ScopedSavedStack save(state);
+  value.push(state);
+  Serializer::encode(state, -1, out);
+  return out;
+}
+/// @brief decode value encoded by Serializer into state.
+inline LuaRef deserialize(lua_State *state, const std::string &data) {
+  util::ScopedSavedStack save(state);
+  Serializer::decode(state, data.data(), data.size());
+  return LuaRef(state, StackTop());
+}
+}
@@ -90,6 +90,14 @@ class State {
   template <typename Libs> void init(const Libs &lib) {
     if (state_) {
       lua_atpanic(state_, &initializing_panic);
+#if KAGUYA_NO_EXCEPTIONS
+      if (!ErrorHandler::getHandler(state_)) {
+        setErrorHandler(&stderror_out);
+      }
+      registerMainThreadIfNeeded();
+      openlibs(lib);
+      lua_atpanic(state_, &default_panic);
+#else
       try {
         if (!ErrorHandler::getHandler(state_)) {
           setErrorHandler(&stderror_out);
@@ -98,9 +106,11 @@ class State {
         openlibs(lib);
         lua_atpanic(state_, &default_panic);
       } catch (const LuaException &) {
+        unregisterMainThreadIfNeeded();
         lua_close(state_);
         state_ = 0;
       }
+#endif
     }
   }
 
@@ -108,6 +118,18 @@ class State {
 #if LUA_VERSION_NUM < 502
     if (state_) {
       util::registerMainThread(state_);
+#if KAGUYA_USE_MAIN_THREAD_CACHE
+      if (created_) {
+        util::MainThreadCache::add(state_);
+      }
+#endif
+    }
+#endif
+  }
+  void unregisterMainThreadIfNeeded() {
+#if LUA_VERSION_NUM < 502 && KAGUYA_USE_MAIN_THREAD_CACHE
+    if (created_ && state_) {
+      util::MainThreadCache::remove(state_);
     }
 #endif
   }
@@ -167,6 +189,7 @@ public:
   }
   ~State() {
     if (created_ && state_) {
+      unregisterMainThreadIfNeeded();
       lua_close(state_);
     }
   }
@@ -182,6 +205,34 @@ public:
     ErrorHandler::registerHandler(state_, errorfunction);
   }
 
+  /// @brief If true, argument mismatch of bound function raise lightweight
+  /// error object instead of message with traceback. The message is built
+  /// when the error is converted to string.
+  void setDeferredArgumentError(bool enable) {
+    if (!state_) {
+      return;
+    }
+    set_deferred_argument_error(state_, enable);
+  }
+  bool isDeferredArgumentError() const {
+    return state_ && is_deferred_argument_error(state_);
+  }
+
+  /// @brief Set element type check policy of table for std::vector and
+  /// std::map arguments. e.g.
+  /// @code
+  /// state.setTableTypeCheck(kaguya::TableTypeCheck::CHECK_FIRST, 8);
+  /// @endcode
+  void setTableTypeCheck(TableTypeCheck::Policy policy, size_t limit = 16) {
+    if (!state_) {
+      return;
+    }
+    set_table_type_check(state_, TableTypeCheck(policy, limit));
+  }
+  TableTypeCheck tableTypeCheck() const {
+    return state_ ? get_table_type_check(state_) : TableTypeCheck();
+  }
+
   /// @brief load all lua standard library
   void openlibs(AllLoadLibs = AllLoadLibs()) {
     if (!state_) {
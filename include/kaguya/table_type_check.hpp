@@ -0,0 +1,110 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <new>
+#include "kaguya/config.hpp"
+#include "kaguya/utility.hpp"
+
+namespace kaguya {
+/// @brief Element type check policy of table for std::vector and std::map.
+/// checkType and strictCheckType are used by overload resolution, and
+/// checking every element of large table is costly. Elements that are not
+/// checked are still checked on conversion and raise type mismatch error.
+/// Functions bound by nothrow_function always check all elements.
+struct TableTypeCheck {
+  enum Policy {
+    CHECK_ALL,    //!< check all elements (default)
+    CHECK_FIRST,  //!< check first limit elements in traversal order
+    CHECK_SAMPLE, //!< check limit elements sampled from sequence
+    CHECK_TABLE   //!< any table matches
+  };
+  TableTypeCheck(Policy policy = CHECK_ALL, size_t limit = 16)
+      : policy(policy), limit(limit) {}
+  Policy policy;
+  size_t limit;
+};
+
+namespace detail {
+#if KAGUYA_SUPPORT_MULTIPLE_SHARED_LIBRARY
+inline void push_table_type_check_key(lua_State *state) {
+  lua_pushstring(state, "\x80KAGUYA_TABLE_TYPE_CHECK_KEY");
+}
+#else
+inline void push_table_type_check_key(lua_State *state) {
+  static int key;
+  lua_pushlightuserdata(state, &key);
+}
+#endif
+// no state has other policy than CHECK_ALL until set, and checks skip
+// registry lookup
+struct table_type_check_tag {};
+inline bool table_type_check_used() {
+  return FeatureUsedFlag<table_type_check_tag>::used();
+}
+inline void set_table_type_check_used() {
+  FeatureUsedFlag<table_type_check_tag>::set();
+}
+
+// policy stored in registry, or null for CHECK_ALL
+inline TableTypeCheck *table_type_check_storage(lua_State *state) {
+  if (!table_type_check_used()) {
+    return 0;
+  }
+  detail::push_table_type_check_key(state);
+  lua_rawget(state, LUA_REGISTRYINDEX);
+  TableTypeCheck *check = static_cast<TableTypeCheck *>(
+      lua_type(state, -1) == LUA_TUSERDATA ? lua_touserdata(state, -1) : 0);
+  lua_pop(state, 1); // kept alive by registry
+  return check;
+}
+
+// check all elements while alive, so conversion after overload resolution
+// can not fail
+class strict_table_type_check {
+public:
+  explicit strict_table_type_check(lua_State *state)
+      : check_(table_type_check_storage(state)) {
+    if (check_) {
+      saved_ = *check_;
+      *check_ = TableTypeCheck();
+    }
+  }
+  ~strict_table_type_check() {
+    if (check_) {
+      *check_ = saved_;
+    }
+  }
+
+private:
+  strict_table_type_check(const strict_table_type_check &);
+  strict_table_type_check &operator=(const strict_table_type_check &);
+
+  TableTypeCheck *check_;
+  TableTypeCheck saved_;
+};
+}
+
+/// @brief set element type check policy of table
+inline void set_table_type_check(lua_State *state,
+                                 const TableTypeCheck &check) {
+  util::ScopedSavedStack save(state);
+  detail::push_table_type_check_key(state);
+  if (check.policy == TableTypeCheck::CHECK_ALL) {
+    lua_pushnil(state);
+  } else {
+    detail::set_table_type_check_used();
+    void *storage = lua_newuserdata(state, sizeof(TableTypeCheck));
+    new (storage) TableTypeCheck(check);
+  }
+  lua_rawset(state, LUA_REGISTRYINDEX);
+}
+/// @brief get element type check policy of table
+inline TableTypeCheck get_table_type_check(lua_State *state) {
+  const TableTypeCheck *check = detail::table_type_check_storage(state);
+  return check ? *check : TableTypeCheck();
+}
+}
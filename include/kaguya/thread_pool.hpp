@@ -0,0 +1,114 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <vector>
+#include "kaguya/config.hpp"
+#include "kaguya/utility.hpp"
+#include "kaguya/lua_ref.hpp"
+#include "kaguya/metatable.hpp"
+#include "kaguya/lua_ref_table.hpp"
+
+namespace kaguya {
+/// @brief Recycles Lua threads used as short lived coroutines.
+/// Released threads are reset and kept in a free list, so acquire does not
+/// create a new lua_newthread while idle threads are available.
+/// On Lua 5.4 any suspended, finished or failed thread is reset with
+/// lua_closethread (lua_resetthread before 5.4.6). On older versions only
+/// threads whose status is ok (finished or not started) can be reused.
+/// Do not release a thread that is running or resuming another coroutine.
+/// The pool must be destroyed before the lua_State is closed.
+class ThreadPool {
+public:
+  /// @param state lua_State of the threads
+  /// @param max_idle max number of idle threads retained
+  explicit ThreadPool(lua_State *state, size_t max_idle = 256)
+      : state_(util::toMainThread(state)), max_idle_(max_idle), created_(0),
+        reused_(0), discarded_(0) {}
+
+  /// @brief take an idle thread or create a new one.
+  LuaThread acquire() {
+    LuaThread thread;
+    if (idle_.empty()) {
+      LuaThread created(state_);
+      thread.swap(created);
+      ++created_;
+    } else {
+      thread.swap(idle_.back());
+      idle_.pop_back();
+      ++reused_;
+    }
+    return thread;
+  }
+
+  /// @brief take a thread and set function for thread running.
+  LuaThread acquire(const LuaFunction &f) {
+    LuaThread thread = acquire();
+    thread.setFunction(f);
+    return thread;
+  }
+
+  /// @brief reset thread and return it to the free list.
+  /// thread is set to nil reference.
+  /// @return true if thread was recycled, false if it was dropped.
+  bool release(LuaThread &thread) {
+    LuaThread released;
+    released.swap(thread);
+    if (!released.state() || released.isNilref()) {
+      return false;
+    }
+    lua_State *corstate = released.getthread();
+    if (!corstate || util::toMainThread(corstate) != state_ ||
+        idle_.size() >= max_idle_ || !resetThread(corstate)) {
+      ++discarded_;
+      return false;
+    }
+    idle_.push_back(LuaThread());
+    idle_.back().swap(released);
+    return true;
+  }
+
+  /// @brief drop all idle threads.
+  void clear() { idle_.clear(); }
+
+  /// @brief number of idle threads in the free list
+  size_t idleCount() const { return idle_.size(); }
+  /// @brief number of threads created by acquire
+  size_t createdCount() const { return created_; }
+  /// @brief number of acquire served from the free list
+  size_t reusedCount() const { return reused_; }
+  /// @brief number of released threads that could not be recycled
+  size_t discardedCount() const { return discarded_; }
+
+private:
+  bool resetThread(lua_State *corstate) {
+#if LUA_VERSION_NUM >= 504
+#if defined(LUA_VERSION_RELEASE_NUM) && LUA_VERSION_RELEASE_NUM >= 50406
+    lua_closethread(corstate, state_);
+#else
+    lua_resetthread(corstate);
+#endif
+    return true;
+#else
+    if (lua_status(corstate) != 0) {
+      return false; // suspended or failed thread can not be reset.
+    }
+    lua_settop(corstate, 0);
+    return true;
+#endif
+  }
+
+  ThreadPool(const ThreadPool &);
+  ThreadPool &operator=(const ThreadPool &);
+
+  lua_State *state_;
+  size_t max_idle_;
+  std::vector<LuaThread> idle_;
+  size_t created_;
+  size_t reused_;
+  size_t discarded_;
+};
+}
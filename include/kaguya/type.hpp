@@ -42,7 +42,7 @@ lua_type_traits<T, Enable>::get(lua_State *l, int index) {
   const typename traits::remove_reference<T>::type *pointer = get_const_pointer(
       l, index, types::typetag<typename traits::remove_reference<T>::type>());
   if (!pointer) {
-    throw LuaTypeMismatch();
+    KAGUYA_THROW(LuaTypeMismatch());
   }
   return *pointer;
 }
@@ -93,7 +93,7 @@ struct lua_type_traits<
   static get_type get(lua_State *l, int index) {
     T *pointer = get_pointer(l, index, types::typetag<T>());
     if (!pointer) {
-      throw LuaTypeMismatch();
+      KAGUYA_THROW(LuaTypeMismatch());
     }
     return *pointer;
   }
@@ -153,7 +153,7 @@ struct lua_type_traits<
     if (type == LUA_TNIL || type == LUA_TNONE) {
       return 0;
     }
-    throw LuaTypeMismatch();
+    KAGUYA_THROW(LuaTypeMismatch());
     return 0;
   }
   static opt_type opt(lua_State *l, int index) KAGUYA_NOEXCEPT {
@@ -253,11 +253,18 @@ opt_helper(lua_State *state, int index) KAGUYA_NOEXCEPT {
 template <typename T>
 typename traits::enable_if<!has_optional_get<T>::value, optional<T> >::type
 opt_helper(lua_State *state, int index) {
+#if KAGUYA_NO_EXCEPTIONS
+  if (!lua_type_traits<T>::checkType(state, index)) {
+    return optional<T>();
+  }
+  return lua_type_traits<T>::get(state, index);
+#else
   try {
     return lua_type_traits<T>::get(state, index);
   } catch (...) {
     return optional<T>();
   }
+#endif
 }
 }
 
@@ -350,7 +357,7 @@ struct lua_type_traits<std::unique_ptr<T, Deleter> > {
   static get_type get(lua_State *l, int index) {
     type *pointer = get_pointer(l, index, types::typetag<type>());
     if (!pointer) {
-      throw LuaTypeMismatch();
+      KAGUYA_THROW(LuaTypeMismatch());
     }
     return *pointer;
   }
@@ -388,7 +395,7 @@ template <> struct lua_type_traits<std::nullptr_t> {
   }
   static get_type get(lua_State *l, int index) {
     if (!lua_isnoneornil(l, index)) {
-      throw LuaTypeMismatch();
+      KAGUYA_THROW(LuaTypeMismatch());
     }
     return nullptr;
   }
@@ -461,7 +468,7 @@ struct lua_type_traits<
     int isnum = 0;
     get_type num = static_cast<T>(lua_tonumberx(l, index, &isnum));
     if (!isnum) {
-      throw LuaTypeMismatch();
+      KAGUYA_THROW(LuaTypeMismatch());
     }
     return num;
   }
@@ -499,7 +506,7 @@ struct lua_type_traits<
     int isnum = 0;
     get_type num = static_cast<T>(lua_tointegerx(l, index, &isnum));
     if (!isnum) {
-      throw LuaTypeMismatch();
+      KAGUYA_THROW(LuaTypeMismatch());
     }
     return num;
   }
@@ -578,7 +585,7 @@ template <> struct lua_type_traits<const char *> {
   static get_type get(lua_State *l, int index) {
     const char *buffer = lua_tostring(l, index);
     if (!buffer) {
-      throw LuaTypeMismatch();
+      KAGUYA_THROW(LuaTypeMismatch());
     }
     return buffer;
   }
@@ -610,7 +617,7 @@ template <int N> struct lua_type_traits<char[N]> {
   static const char *get(lua_State *l, int index) {
     const char *buffer = lua_tostring(l, index);
     if (!buffer) {
-      throw LuaTypeMismatch();
+      KAGUYA_THROW(LuaTypeMismatch());
     }
     return buffer;
   }
@@ -649,7 +656,7 @@ template <> struct lua_type_traits<std::string> {
     if (opt_type o = opt(l, index)) {
       return *o;
     }
-    throw LuaTypeMismatch();
+    KAGUYA_THROW(LuaTypeMismatch());
   }
   static int push(lua_State *l, const std::string &s) {
     lua_pushlstring(l, s.c_str(), s.size());
@@ -710,7 +717,7 @@ template <> struct lua_type_traits<NilValue> {
   }
   static get_type get(lua_State *l, int index) {
     if (!checkType(l, index)) {
-      throw LuaTypeMismatch();
+      KAGUYA_THROW(LuaTypeMismatch());
     }
     return NilValue();
   }
@@ -919,12 +926,12 @@ inline std::ostream &operator<<(std::ostream &os,
 template <typename D, typename T>
 inline KAGUYA_ENABLE_IF_NOT_LUAREF(bool)
 operator==(const T &lhs, const LuaBasicTypeFunctions<D> &rhs) {
-  return rhs == lhs;
+  return rhs.operator==(lhs); // C++20 would rewrite rhs == lhs to this
 }
 template <typename D, typename T>
 inline KAGUYA_ENABLE_IF_NOT_LUAREF(bool)
 operator!=(const T &lhs, const LuaBasicTypeFunctions<D> &rhs) {
-  return !(rhs == lhs);
+  return !rhs.operator==(lhs);
 }
 #undef KAGUYA_ENABLE_IF_NOT_LUAREF
 //@}
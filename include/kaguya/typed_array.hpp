@@ -0,0 +1,407 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include "kaguya/config.hpp"
+#include "kaguya/type.hpp"
+#include "kaguya/utility.hpp"
+
+namespace kaguya {
+/// @addtogroup span
+///  @{
+
+/// @brief Non owning view of contiguous elements.
+/// self implement for std::span(C++20 feature).
+template <typename T> class span {
+public:
+  typedef T element_type;
+  typedef T value_type;
+  typedef T *iterator;
+  typedef size_t size_type;
+
+  span() : data_(0), size_(0) {}
+  span(T *data, size_t size) : data_(data), size_(size) {}
+  template <typename A>
+  span(std::vector<T, A> &v) : data_(v.empty() ? 0 : &v[0]), size_(v.size()) {}
+
+  T *data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  T &operator[](size_t index) const { return data_[index]; }
+  iterator begin() const { return data_; }
+  iterator end() const { return data_ + size_; }
+
+private:
+  T *data_;
+  size_t size_;
+};
+/// @}
+
+namespace detail {
+template <typename T> struct typed_array_storage {
+  T *data;
+  size_t size;
+};
+}
+
+/// @brief Numeric array userdata sharing contiguous buffer with C++.
+/// Lua owned array holds elements in the userdata. View array refers C++
+/// owned buffer, which must outlive the Lua value.
+/// In Lua, array supports a[i](1 origin), a[i]=v, #a and bulk methods
+/// fill(v), copy(src [,offset]), sum(), min(), max(), scale(s),
+/// axpy(alpha, x) and totable().
+/// e.g.
+/// @code
+/// state["FloatArray"] = kaguya::luacfunction(&TypedArray<float>::create);
+/// state("local a = FloatArray(1024) a:fill(1) print(a:sum())");
+/// @endcode
+template <typename T> class TypedArray {
+  KAGUYA_STATIC_ASSERT(traits::is_arithmetic<T>::value,
+                       "TypedArray element must be arithmetic type");
+  typedef detail::typed_array_storage<T> storage_type;
+  typedef typename standard::conditional<traits::is_floating_point<T>::value,
+                                         T, lua_Number>::type scalar_type;
+  typedef typename standard::conditional<traits::is_floating_point<T>::value,
+                                         lua_Number, lua_Integer>::type
+      sum_type;
+  // integer sum wraps around like Lua integer arithmetic, without signed
+  // overflow
+  typedef typename standard::conditional<
+      traits::is_floating_point<T>::value, lua_Number,
+      typename standard::make_unsigned<lua_Integer>::type>::type
+      accumulate_type;
+
+public:
+  /// @brief push new Lua owned array initialized by zero.
+  /// @return view of the array buffer. valid while the array is alive
+  static span<T> push(lua_State *state, size_t size) {
+    storage_type *storage = static_cast<storage_type *>(
+        lua_newuserdata(state, header_size() + sizeof(T) * size));
+    storage->data = aligned_data(storage);
+    storage->size = size;
+    std::fill(storage->data, storage->data + size, T());
+    setmetatable(state);
+    return span<T>(storage->data, size);
+  }
+  /// @brief push view array of C++ owned buffer without copy.
+  static void pushView(lua_State *state, T *data, size_t size) {
+    storage_type *storage = static_cast<storage_type *>(
+        lua_newuserdata(state, sizeof(storage_type)));
+    storage->data = data;
+    storage->size = size;
+    setmetatable(state);
+  }
+  /// @brief true if value at index is TypedArray<T>
+  static bool isArray(lua_State *state, int index) {
+    if (!lua_getmetatable(state, index)) {
+      return false;
+    }
+    luaL_getmetatable(state, metatable_name());
+    bool result = lua_rawequal(state, -1, -2) != 0;
+    lua_pop(state, 2);
+    return result;
+  }
+  /// @brief get view of array buffer. return empty span if not TypedArray<T>
+  static span<T> get(lua_State *state, int index) {
+    if (!isArray(state, index)) {
+      return span<T>();
+    }
+    storage_type *storage =
+        static_cast<storage_type *>(lua_touserdata(state, index));
+    return span<T>(storage->data, storage->size);
+  }
+
+  /// @brief lua_CFunction constructor. create(size) or create(table)
+  static int create(lua_State *state) {
+    if (lua_type(state, 1) == LUA_TTABLE) {
+      size_t size = lua_rawlen(state, 1);
+      span<T> array = push(state, size);
+      copy_from_table(state, array.data(), size, 1);
+      return 1;
+    }
+    lua_Integer size = luaL_checkinteger(state, 1);
+    if (size < 0 ||
+        static_cast<size_t>(size) > (size_t(-1) - header_size()) / sizeof(T)) {
+      return luaL_argerror(state, 1, "invalid size");
+    }
+    push(state, static_cast<size_t>(size));
+    return 1;
+  }
+
+private:
+  // elements of Lua owned array follow storage. userdata memory is not
+  // aligned for every T (e.g. long double), so padding is reserved
+  static size_t header_size() {
+    return sizeof(storage_type) + standard::alignment_of<T>::value - 1;
+  }
+  static T *aligned_data(storage_type *storage) {
+    const size_t align = standard::alignment_of<T>::value;
+    char *data = reinterpret_cast<char *>(storage + 1);
+    size_t misalign = reinterpret_cast<size_t>(data) % align;
+    if (misalign) {
+      data += align - misalign;
+    }
+    return reinterpret_cast<T *>(data);
+  }
+  static const char *metatable_name() {
+    static const std::string name =
+        "kaguya::TypedArray<" + util::pretty_name<T>() + ">";
+    return name.c_str();
+  }
+  static void setmetatable(lua_State *state) {
+    if (luaL_newmetatable(state, metatable_name())) {
+      init_metatable(state);
+    }
+    lua_setmetatable(state, -2);
+  }
+  static void add_function(lua_State *state, int metatable, int table,
+                           const char *name, lua_CFunction f) {
+    lua_pushvalue(state, metatable);
+    lua_pushcclosure(state, f, 1);
+    lua_setfield(state, table, name);
+  }
+  static void init_metatable(lua_State *state) {
+    int metatable = lua_gettop(state);
+    lua_createtable(state, 0, 9);
+    int methods = lua_gettop(state);
+    add_function(state, metatable, methods, "fill", &fill);
+    add_function(state, metatable, methods, "copy", &copy);
+    add_function(state, metatable, methods, "sum", &sum);
+    add_function(state, metatable, methods, "min", &min_function);
+    add_function(state, metatable, methods, "max", &max_function);
+    add_function(state, metatable, methods, "scale", &scale);
+    add_function(state, metatable, methods, "axpy", &axpy);
+    add_function(state, metatable, methods, "totable", &totable);
+
+    lua_pushvalue(state, metatable);
+    lua_pushvalue(state, methods);
+    lua_pushcclosure(state, &index_function, 2);
+    lua_setfield(state, metatable, "__index");
+    add_function(state, metatable, metatable, "__newindex", &newindex_function);
+    add_function(state, metatable, metatable, "__len", &len_function);
+    add_function(state, metatable, metatable, "__tostring", &tostring_function);
+    lua_pushstring(state, metatable_name());
+    lua_setfield(state, metatable, "__name");
+    lua_settop(state, metatable);
+  }
+
+  // metamethods and methods hold metatable as upvalue 1
+  static storage_type *check(lua_State *state, int index) {
+    if (lua_getmetatable(state, index)) {
+      bool same = lua_rawequal(state, -1, lua_upvalueindex(1)) != 0;
+      lua_pop(state, 1);
+      if (same) {
+        return static_cast<storage_type *>(lua_touserdata(state, index));
+      }
+    }
+    luaL_argerror(state, index,
+                  lua_pushfstring(state, "%s expected", metatable_name()));
+    return 0;
+  }
+  static bool to_value(lua_State *state, int index, T &value) {
+    typename lua_type_traits<T>::opt_type v =
+        lua_type_traits<T>::opt(state, index);
+    if (!v) {
+      return false;
+    }
+    value = *v;
+    return true;
+  }
+  static T check_value(lua_State *state, int index) {
+    T value = T();
+    if (!to_value(state, index, value)) {
+      luaL_argerror(state, index, "number expected");
+    }
+    return value;
+  }
+  static scalar_type check_scalar(lua_State *state, int index) {
+    return static_cast<scalar_type>(luaL_checknumber(state, index));
+  }
+  // 1 origin index to position. return false if out of range
+  static bool to_position(lua_State *state, int index, size_t size,
+                          size_t &pos) {
+    optional<size_t> i = lua_type_traits<size_t>::opt(state, index);
+    if (!i || *i < 1 || *i > size) {
+      return false;
+    }
+    pos = *i - 1;
+    return true;
+  }
+  static void copy_from_table(lua_State *state, T *data, size_t size,
+                              int table) {
+    for (size_t i = 0; i < size; ++i) {
+      lua_rawgeti(state, table, static_cast<int>(i + 1));
+      if (!to_value(state, -1, data[i])) {
+        luaL_argerror(state, table,
+                      lua_pushfstring(state, "number expected at index %d",
+                                      static_cast<int>(i + 1)));
+      }
+      lua_pop(state, 1);
+    }
+  }
+
+  static int index_function(lua_State *state) {
+    storage_type *self = check(state, 1);
+    if (lua_type(state, 2) == LUA_TNUMBER) {
+      size_t pos = 0;
+      if (to_position(state, 2, self->size, pos)) {
+        return lua_type_traits<T>::push(state, self->data[pos]);
+      }
+      lua_pushnil(state);
+      return 1;
+    }
+    lua_pushvalue(state, 2);
+    lua_rawget(state, lua_upvalueindex(2));
+    return 1;
+  }
+  static int newindex_function(lua_State *state) {
+    storage_type *self = check(state, 1);
+    size_t pos = 0;
+    if (!to_position(state, 2, self->size, pos)) {
+      return luaL_argerror(state, 2, "index out of range");
+    }
+    self->data[pos] = check_value(state, 3);
+    return 0;
+  }
+  static int len_function(lua_State *state) {
+    storage_type *self = check(state, 1);
+    lua_pushinteger(state, static_cast<lua_Integer>(self->size));
+    return 1;
+  }
+  static int tostring_function(lua_State *state) {
+    storage_type *self = check(state, 1);
+    lua_pushfstring(state, "%s: %d", metatable_name(),
+                    static_cast<int>(self->size));
+    return 1;
+  }
+
+  static int fill(lua_State *state) {
+    storage_type *self = check(state, 1);
+    std::fill(self->data, self->data + self->size, check_value(state, 2));
+    lua_settop(state, 1);
+    return 1;
+  }
+  static int copy(lua_State *state) {
+    storage_type *self = check(state, 1);
+    size_t offset = 0;
+    if (!lua_isnoneornil(state, 3) &&
+        !to_position(state, 3, self->size, offset)) {
+      return luaL_argerror(state, 3, "offset out of range");
+    }
+    size_t count = self->size - offset;
+    if (lua_type(state, 2) == LUA_TTABLE) {
+      copy_from_table(state, self->data + offset,
+                      (std::min)(count, lua_rawlen(state, 2)), 2);
+    } else {
+      storage_type *src = check(state, 2);
+      count = (std::min)(count, src->size);
+      if (count > 0) {
+        std::memmove(self->data + offset, src->data, sizeof(T) * count);
+      }
+    }
+    lua_settop(state, 1);
+    return 1;
+  }
+  static int sum(lua_State *state) {
+    storage_type *self = check(state, 1);
+    const T *data = self->data;
+    accumulate_type result = 0;
+    for (size_t i = 0, size = self->size; i < size; ++i) {
+      result += static_cast<accumulate_type>(data[i]);
+    }
+    return lua_type_traits<sum_type>::push(state,
+                                           static_cast<sum_type>(result));
+  }
+  static int min_function(lua_State *state) {
+    storage_type *self = check(state, 1);
+    if (self->size == 0) {
+      lua_pushnil(state);
+      return 1;
+    }
+    return lua_type_traits<T>::push(
+        state, *std::min_element(self->data, self->data + self->size));
+  }
+  static int max_function(lua_State *state) {
+    storage_type *self = check(state, 1);
+    if (self->size == 0) {
+      lua_pushnil(state);
+      return 1;
+    }
+    return lua_type_traits<T>::push(
+        state, *std::max_element(self->data, self->data + self->size));
+  }
+  static int scale(lua_State *state) {
+    storage_type *self = check(state, 1);
+    const scalar_type s = check_scalar(state, 2);
+    T *data = self->data;
+    for (size_t i = 0, size = self->size; i < size; ++i) {
+      data[i] = static_cast<T>(data[i] * s);
+    }
+    lua_settop(state, 1);
+    return 1;
+  }
+  // self = alpha * x + self
+  static int axpy(lua_State *state) {
+    storage_type *self = check(state, 1);
+    const scalar_type alpha = check_scalar(state, 2);
+    storage_type *x = check(state, 3);
+    if (x->size != self->size) {
+      return luaL_argerror(state, 3, "size mismatch");
+    }
+    T *y = self->data;
+    const T *xdata = x->data;
+    for (size_t i = 0, size = self->size; i < size; ++i) {
+      y[i] = static_cast<T>(y[i] + alpha * xdata[i]);
+    }
+    lua_settop(state, 1);
+    return 1;
+  }
+  static int totable(lua_State *state) {
+    storage_type *self = check(state, 1);
+    lua_createtable(state, static_cast<int>(self->size), 0);
+    for (size_t i = 0; i < self->size; ++i) {
+      lua_type_traits<T>::push(state, self->data[i]);
+      lua_rawseti(state, -2, static_cast<int>(i + 1));
+    }
+    return 1;
+  }
+};
+
+/// @ingroup lua_type_traits
+/// @brief lua_type_traits for span<T>. span is pushed as TypedArray<T> view
+/// without copy, and gets view of TypedArray<T> buffer. span<const T> uses
+/// TypedArray<T>; the pushed view is not write protected.
+template <typename T> struct lua_type_traits<span<T> > {
+  typedef span<T> get_type;
+  typedef const span<T> &push_type;
+  typedef typename traits::remove_const<T>::type element_type;
+  typedef TypedArray<element_type> array_type;
+
+  static bool strictCheckType(lua_State *l, int index) {
+    return array_type::isArray(l, index);
+  }
+  static bool checkType(lua_State *l, int index) {
+    return array_type::isArray(l, index);
+  }
+  static get_type get(lua_State *l, int index) {
+    if (!array_type::isArray(l, index)) {
+      KAGUYA_THROW(LuaTypeMismatch());
+    }
+    span<element_type> view = array_type::get(l, index);
+    return get_type(view.data(), view.size());
+  }
+  static int push(lua_State *l, push_type s) {
+    array_type::pushView(l, const_cast<element_type *>(s.data()), s.size());
+    return 1;
+  }
+};
+template <typename T>
+struct lua_type_traits<const span<T> &> : lua_type_traits<span<T> > {};
+}
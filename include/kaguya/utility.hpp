@@ -10,6 +10,9 @@
 #endif
 
 #include "kaguya/config.hpp"
+#if KAGUYA_USE_CPP11
+#include <atomic>
+#endif
 #include "kaguya/compatibility.hpp"
 #include "kaguya/traits.hpp"
 #include "kaguya/preprocess.hpp"
@@ -152,6 +155,63 @@ inline void stackValueDump(std::ostream &os, lua_State *state, int stackIndex,
   }
 }
 
+#if KAGUYA_USE_MAIN_THREAD_CACHE
+/// @brief Process wide table from registry address to main thread.
+/// lua_topointer(L, LUA_REGISTRYINDEX) is shared by all threads of one state.
+/// Entries are added and removed by State that owns the lua_State.
+struct MainThreadCache {
+  /// @brief return main thread of state, or null if not cached
+  static lua_State *find(lua_State *state) {
+    const void *registry = lua_topointer(state, LUA_REGISTRYINDEX);
+    const Slot &slot = slots()[index(registry)];
+    if (slot.registry.load(std::memory_order_acquire) == registry) {
+      return slot.main_thread.load(std::memory_order_relaxed);
+    }
+    return 0;
+  }
+  /// @brief add main thread. return false if the slot is used by other state
+  static bool add(lua_State *main_thread) {
+    const void *registry = lua_topointer(main_thread, LUA_REGISTRYINDEX);
+    Slot &slot = slots()[index(registry)];
+    const void *expected = 0;
+    if (!slot.registry.compare_exchange_strong(expected, reserved(),
+                                               std::memory_order_acquire)) {
+      return false;
+    }
+    slot.main_thread.store(main_thread, std::memory_order_relaxed);
+    slot.registry.store(registry, std::memory_order_release);
+    return true;
+  }
+  /// @brief remove main thread. must be called before lua_close
+  static void remove(lua_State *main_thread) {
+    const void *registry = lua_topointer(main_thread, LUA_REGISTRYINDEX);
+    Slot &slot = slots()[index(registry)];
+    slot.registry.compare_exchange_strong(registry, 0,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed);
+  }
+
+private:
+  struct Slot {
+    std::atomic<const void *> registry;
+    std::atomic<lua_State *> main_thread;
+  };
+  static const std::size_t slot_count = 64;
+  static Slot *slots() {
+    static Slot table[slot_count];
+    return table;
+  }
+  static const void *reserved() {
+    static const char marker = 0;
+    return &marker;
+  }
+  static std::size_t index(const void *registry) {
+    std::size_t address = reinterpret_cast<std::size_t>(registry);
+    return ((address >> 4) ^ (address >> 10)) % slot_count;
+  }
+};
+#endif
+
 #if LUA_VERSION_NUM >= 502
 inline lua_State *toMainThread(lua_State *state) {
   if (state) {
@@ -168,6 +228,12 @@ inline lua_State *toMainThread(lua_State *state) {
 #else
 inline lua_State *toMainThread(lua_State *state) {
   if (state) {
+#if KAGUYA_USE_MAIN_THREAD_CACHE
+    lua_State *cached = MainThreadCache::find(state);
+    if (cached) {
+      return cached;
+    }
+#endif
     // lua_pushthread return 1 if state is main thread
     bool state_is_main = lua_pushthread(state) == 1;
 	lua_pop(state, 1);
@@ -256,5 +322,44 @@ inline std::string pretty_name(const std::type_info &t) {
   return t.name();
 #endif
 }
+
+/// @brief demangled name of typeid(T).
+/// Computed on first call per type and shared by the whole process; later
+/// calls only read the initialized static.
+template <typename T> const std::string &pretty_name() {
+  static const std::string name = pretty_name(typeid(T));
+  return name;
+}
+}
+
+namespace detail {
+/// @brief process wide flag that is set once any state uses the feature
+/// selected by Tag, so that states not using it skip the registry lookup.
+/// With multiple shared libraries the flag is not shared between them, and
+/// the feature is always treated as used.
+template <typename Tag> struct FeatureUsedFlag {
+#if KAGUYA_SUPPORT_MULTIPLE_SHARED_LIBRARY
+  static bool used() { return true; }
+  static void set() {}
+#elif KAGUYA_USE_CPP11
+  static bool used() { return flag().load(std::memory_order_relaxed); }
+  static void set() { flag().store(true, std::memory_order_relaxed); }
+
+private:
+  static std::atomic<bool> &flag() {
+    static std::atomic<bool> value(false);
+    return value;
+  }
+#else
+  static bool used() { return flag(); }
+  static void set() { flag() = true; }
+
+private:
+  static volatile bool &flag() {
+    static volatile bool value = false;
+    return value;
+  }
+#endif
+};
 }
 }
@@ -29,6 +29,16 @@ template <typename T, typename Ret, typename... Args>
 struct FunctorSignature<Ret (T::*)(Args...)> {
   typedef FunctionSignatureType<Ret, Args...> type;
 };
+#if defined(__cpp_noexcept_function_type)
+template <typename T, typename Ret, typename... Args>
+struct FunctorSignature<Ret (T::*)(Args...) const noexcept> {
+  typedef FunctionSignatureType<Ret, Args...> type;
+};
+template <typename T, typename Ret, typename... Args>
+struct FunctorSignature<Ret (T::*)(Args...) noexcept> {
+  typedef FunctionSignatureType<Ret, Args...> type;
+};
+#endif
 
 #if defined(_MSC_VER) && _MSC_VER < 1900
 template <typename T>
@@ -77,6 +87,26 @@ template <class Ret, class... Args> struct FunctionSignature<Ret(Args...)> {
   typedef FunctionSignatureType<Ret, Args...> type;
 };
 
+#if defined(__cpp_noexcept_function_type)
+// noexcept is part of function type since C++17
+template <typename T, typename Ret, typename... Args>
+struct FunctionSignature<Ret (T::*)(Args...) noexcept> {
+  typedef FunctionSignatureType<Ret, T &, Args...> type;
+};
+template <typename T, typename Ret, typename... Args>
+struct FunctionSignature<Ret (T::*)(Args...) const noexcept> {
+  typedef FunctionSignatureType<Ret, const T &, Args...> type;
+};
+template <class Ret, class... Args>
+struct FunctionSignature<Ret (*)(Args...) noexcept> {
+  typedef FunctionSignatureType<Ret, Args...> type;
+};
+template <class Ret, class... Args>
+struct FunctionSignature<Ret(Args...) noexcept> {
+  typedef FunctionSignatureType<Ret, Args...> type;
+};
+#endif
+
 template <typename F> struct FunctionResultType {
   typedef typename FunctionSignature<F>::type::result_type type;
 };
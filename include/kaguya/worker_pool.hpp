@@ -0,0 +1,369 @@
+// Copyright satoren
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "kaguya/config.hpp"
+
+#if KAGUYA_USE_CPP11
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "kaguya/error_handler.hpp"
+#include "kaguya/state.hpp"
+
+namespace kaguya {
+/// @brief Per worker counters of WorkerPool
+struct WorkerStats {
+  /// @brief number of jobs in the queues of the worker
+  size_t queued;
+  /// @brief number of jobs started by the worker
+  size_t executed;
+  /// @brief number of jobs the worker took from other workers
+  size_t stolen;
+  /// @brief seconds spent running jobs
+  double busySeconds;
+  /// @brief busySeconds per seconds since the pool started
+  double utilization;
+};
+
+/// @brief Thread pool running Lua functions on one State per worker.
+///
+/// Each worker owns a State initialized by the setup function, so jobs
+/// submitted by name run on whichever worker is free. Jobs are queued per
+/// worker; an idle worker takes jobs from the back of the other queues.
+/// submitTo pins a job to one worker and its State, for stateful jobs.
+///
+/// Lua errors and type mismatches of results are reported through the
+/// returned future. Arguments and results are copied across threads, so
+/// use value types, not LuaRef.
+/// @code
+///   kaguya::WorkerPool pool(4, [](kaguya::State &state) {
+///     state.dofile("jobs.lua");
+///   });
+///   std::future<int> f = pool.submit<int>("fib", 30);
+/// @endcode
+/// This header is not included by kaguya.hpp. Link with the thread library.
+class WorkerPool {
+public:
+  typedef std::function<void(State &)> setup_function_type;
+
+  /// @param threads number of workers and States. 0 means hardware threads
+  /// @param setup called for each State before workers start
+  explicit WorkerPool(size_t threads,
+                      const setup_function_type &setup = setup_function_type())
+      : stop_(false), sleepers_(0), shared_queued_(0), next_(0),
+        started_(std::chrono::steady_clock::now()) {
+    if (threads == 0) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    workers_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+      workers_.push_back(std::unique_ptr<Worker>(new Worker()));
+      State &state = workers_.back()->state;
+      state.setErrorHandler(&ErrorHandler::throwDefaultError);
+      if (setup) {
+        setup(state);
+      }
+    }
+    threads_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+      threads_.push_back(std::thread(&WorkerPool::run, this, i));
+    }
+  }
+
+  /// @brief finish queued jobs and join workers
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      stop_ = true;
+      for (size_t i = 0; i < workers_.size(); ++i) {
+        workers_[i]->wake.notify_one();
+      }
+    }
+    for (size_t i = 0; i < threads_.size(); ++i) {
+      threads_[i].join();
+    }
+  }
+
+  /// @brief call global function of any worker state with args.
+  template <class Result = void, class... Args>
+  std::future<Result> submit(const std::string &function, Args &&... args) {
+    std::shared_ptr<std::promise<Result> > promise =
+        std::make_shared<std::promise<Result> >();
+    std::future<Result> future = promise->get_future();
+    size_t index = next_.fetch_add(1, std::memory_order_relaxed) %
+                   workers_.size();
+    enqueue(index, false,
+            std::bind(&WorkerPool::invoke<Result, typename std::decay<
+                                                      Args>::type...>,
+                      std::placeholders::_1, promise, function,
+                      std::forward<Args>(args)...));
+    return future;
+  }
+
+  /// @brief call global function of the state of worker with args.
+  /// jobs submitted to a worker run in order and are never stolen.
+  template <class Result = void, class... Args>
+  std::future<Result> submitTo(size_t worker, const std::string &function,
+                               Args &&... args) {
+    if (worker >= workers_.size()) {
+      KAGUYA_THROW(std::out_of_range("worker index out of range"));
+    }
+    std::shared_ptr<std::promise<Result> > promise =
+        std::make_shared<std::promise<Result> >();
+    std::future<Result> future = promise->get_future();
+    enqueue(worker, true,
+            std::bind(&WorkerPool::invoke<Result, typename std::decay<
+                                                      Args>::type...>,
+                      std::placeholders::_1, promise, function,
+                      std::forward<Args>(args)...));
+    return future;
+  }
+
+  /// @brief number of workers
+  size_t size() const { return workers_.size(); }
+
+  /// @brief number of jobs waiting in all queues
+  size_t queueDepth() const {
+    size_t depth = 0;
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      depth += queueDepth(i);
+    }
+    return depth;
+  }
+  /// @brief number of jobs waiting in the queues of worker
+  size_t queueDepth(size_t worker) const {
+    const Worker &w = *workers_.at(worker);
+    return w.local_count.load(std::memory_order_relaxed) +
+           w.pinned_count.load(std::memory_order_relaxed);
+  }
+
+  /// @brief number of jobs taken from other workers
+  size_t stealCount() const {
+    size_t count = 0;
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      count += workers_[i]->stolen.load(std::memory_order_relaxed);
+    }
+    return count;
+  }
+
+  /// @brief counters of worker
+  WorkerStats stats(size_t worker) const {
+    const Worker &w = *workers_.at(worker);
+    WorkerStats s;
+    s.queued = queueDepth(worker);
+    s.executed = w.executed.load(std::memory_order_relaxed);
+    s.stolen = w.stolen.load(std::memory_order_relaxed);
+    s.busySeconds =
+        static_cast<double>(w.busy_ns.load(std::memory_order_relaxed)) / 1e9;
+    double elapsed = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - started_)
+                         .count();
+    s.utilization = elapsed > 0 ? s.busySeconds / elapsed : 0;
+    return s;
+  }
+
+private:
+  typedef std::function<void(State &)> job_type;
+
+  struct Worker {
+    Worker()
+        : parked(false), local_count(0), pinned_count(0), executed(0),
+          stolen(0), busy_ns(0) {}
+    State state;
+    std::condition_variable wake; // waited with sleep_mutex_
+    bool parked;                  // guarded by sleep_mutex_
+    std::mutex mutex;
+    std::deque<job_type> local;
+    std::deque<job_type> pinned;
+    std::atomic<size_t> local_count;
+    std::atomic<size_t> pinned_count;
+    std::atomic<size_t> executed;
+    std::atomic<size_t> stolen;
+    std::atomic<long long> busy_ns;
+  };
+
+  template <class Result, class... Args>
+  static void invoke(State &state,
+                     const std::shared_ptr<std::promise<Result> > &promise,
+                     const std::string &function, const Args &... args) {
+#if KAGUYA_NO_EXCEPTIONS
+    set_result(*promise, state, function, args...);
+#else
+    try {
+      set_result(*promise, state, function, args...);
+    } catch (...) {
+      promise->set_exception(std::current_exception());
+    }
+#endif
+  }
+  template <class Result, class... Args>
+  static void set_result(std::promise<Result> &promise, State &state,
+                         const std::string &function, const Args &... args) {
+    promise.set_value(call<Result>(state, function, args...));
+  }
+  template <class... Args>
+  static void set_result(std::promise<void> &promise, State &state,
+                         const std::string &function, const Args &... args) {
+    call<void>(state, function, args...);
+    promise.set_value();
+  }
+  template <class Result, class... Args>
+  static Result call(State &state, const std::string &function,
+                     const Args &... args) {
+    LuaFunction f = state[function];
+    if (f.type() != LuaFunction::TYPE_FUNCTION) {
+      KAGUYA_THROW(std::runtime_error("function not found: " + function));
+    }
+    return f.call<Result>(args...);
+  }
+
+  void enqueue(size_t index, bool pinned, job_type job) {
+    Worker &w = *workers_[index];
+    {
+      std::lock_guard<std::mutex> lock(w.mutex);
+      if (pinned) {
+        w.pinned.push_back(std::move(job));
+        w.pinned_count.fetch_add(1, std::memory_order_seq_cst);
+      } else {
+        w.local.push_back(std::move(job));
+        w.local_count.fetch_add(1, std::memory_order_relaxed);
+        shared_queued_.fetch_add(1, std::memory_order_seq_cst);
+      }
+    }
+    // pairs with sleepers_ increment in wait. a worker that is about to
+    // park either sees the job or is counted here
+    if (sleepers_.load(std::memory_order_seq_cst) == 0) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    Worker *target = &w;
+    if (!pinned && !w.parked) {
+      target = 0;
+      for (size_t i = 0; i < workers_.size() && !target; ++i) {
+        if (workers_[i]->parked) {
+          target = workers_[i].get();
+        }
+      }
+    }
+    if (target && target->parked) {
+      target->parked = false;
+      target->wake.notify_one();
+    }
+  }
+
+  bool hasWork(const Worker &w) const {
+    return shared_queued_.load(std::memory_order_seq_cst) > 0 ||
+           w.pinned_count.load(std::memory_order_seq_cst) > 0;
+  }
+
+  // return false if pool is stopped and no job is left
+  bool wait(Worker &self) {
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    sleepers_.fetch_add(1, std::memory_order_seq_cst);
+    while (!stop_ && !hasWork(self)) {
+      self.parked = true;
+      self.wake.wait(lock);
+    }
+    self.parked = false;
+    sleepers_.fetch_sub(1, std::memory_order_relaxed);
+    return !stop_ || hasWork(self);
+  }
+
+  bool pop(Worker &w, job_type &job) {
+    std::lock_guard<std::mutex> lock(w.mutex);
+    if (!w.pinned.empty()) {
+      job = std::move(w.pinned.front());
+      w.pinned.pop_front();
+      w.pinned_count.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+    if (!w.local.empty()) {
+      job = std::move(w.local.front());
+      w.local.pop_front();
+      w.local_count.fetch_sub(1, std::memory_order_relaxed);
+      takeShared();
+      return true;
+    }
+    return false;
+  }
+
+  bool steal(size_t thief, job_type &job) {
+    for (size_t i = 1; i < workers_.size(); ++i) {
+      Worker &victim = *workers_[(thief + i) % workers_.size()];
+      if (victim.local_count.load(std::memory_order_relaxed) == 0) {
+        continue;
+      }
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.local.empty()) {
+        job = std::move(victim.local.back());
+        victim.local.pop_back();
+        victim.local_count.fetch_sub(1, std::memory_order_relaxed);
+        takeShared();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void takeShared() {
+    shared_queued_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void run(size_t index) {
+    Worker &self = *workers_[index];
+    job_type job;
+    for (;;) {
+      bool stolen = false;
+      if (!pop(self, job)) {
+        stolen = steal(index, job);
+        if (!stolen) {
+          if (!wait(self)) {
+            return;
+          }
+          continue;
+        }
+      }
+      self.executed.fetch_add(1, std::memory_order_relaxed);
+      if (stolen) {
+        self.stolen.fetch_add(1, std::memory_order_relaxed);
+      }
+      std::chrono::steady_clock::time_point begin =
+          std::chrono::steady_clock::now();
+      job(self.state);
+      job = job_type();
+      self.busy_ns.fetch_add(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now() - begin)
+              .count(),
+          std::memory_order_relaxed);
+    }
+  }
+
+  WorkerPool(const WorkerPool &);
+  WorkerPool &operator=(const WorkerPool &);
+
+  std::vector<std::unique_ptr<Worker> > workers_;
+  std::vector<std::thread> threads_;
+  std::mutex sleep_mutex_; // taken only to park and wake workers
+  bool stop_;               // guarded by sleep_mutex_
+  std::atomic<size_t> sleepers_;
+  std::atomic<size_t> shared_queued_; // jobs in local queues
+  std::atomic<size_t> next_;
+  std::chrono::steady_clock::time_point started_;
+};
+}
+#endif
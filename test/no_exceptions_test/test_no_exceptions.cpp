@@ -0,0 +1,91 @@
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "kaguya/kaguya.hpp"
+#include "kaguya/worker_pool.hpp"
+#include "kaguya/channel.hpp"
+
+#if !KAGUYA_NO_EXCEPTIONS
+#error exceptions are not detected as disabled
+#endif
+
+#if !KAGUYA_USE_CPP11
+// boost requires definition by user if exceptions are disabled
+namespace boost {
+void throw_exception(const std::exception &e) {
+  std::fprintf(stderr, "boost: %s\n", e.what());
+  std::abort();
+}
+}
+#endif
+
+namespace {
+int failures = 0;
+
+void check(bool condition, const char *expression, int line) {
+  if (!condition) {
+    std::fprintf(stderr, "line %d: %s failed\n", line, expression);
+    ++failures;
+  }
+}
+#define CHECK(E) check(E, #E, __LINE__)
+
+int add(int a, int b) { return a + b; }
+int size(const std::vector<int> &v) { return static_cast<int>(v.size()); }
+std::string name(const std::string &s) { return "name:" + s; }
+
+struct Point {
+  Point() : x(0), y(0) {}
+  Point(int x, int y) : x(x), y(y) {}
+  int x;
+  int y;
+  int sum() const { return x + y; }
+};
+
+void error_handler(int, const char *) { ++failures; }
+}
+
+int main() {
+  kaguya::State state;
+  state.setErrorHandler(&error_handler);
+  state["add"] = kaguya::function(add);
+  state["size"] = kaguya::function(size);
+  state["overload"] = kaguya::overload(add, name);
+  state["Point"].setClass(kaguya::UserdataMetatable<Point>()
+                              .setConstructors<Point(), Point(int, int)>()
+                              .addFunction("sum", &Point::sum));
+
+  CHECK(state("assert(add(1, 2) == 3)"));
+  CHECK(state("assert(size({1, 2, 3}) == 3)"));
+  CHECK(state("assert(overload(1, 2) == 3 and overload('a') == 'name:a')"));
+  CHECK(state("assert(Point.new(1, 2):sum() == 3)"));
+
+  // mismatch is raised by lua_error, and caught by pcall
+  CHECK(state("local ok, msg = pcall(add, 'x') "
+              "assert(not ok and msg:find('candidate'))"));
+  CHECK(state("local ok = pcall(size, {1, 'x'}) assert(not ok)"));
+  CHECK(state("local ok = pcall(Point.sum, 'x') assert(not ok)"));
+
+  CHECK(state("v = {4, 5}"));
+  std::vector<int> v = state["v"];
+  CHECK(v.size() == 2 && v[1] == 5);
+  kaguya::optional<int> none = state["v"].get<kaguya::optional<int> >();
+  CHECK(!none);
+  CHECK(state["add"].call<int>(3, 4) == 7);
+
+#if KAGUYA_USE_CPP11
+  kaguya::BasicChannel<int> channel(2);
+  CHECK(channel.trySend(1));
+  int value = 0;
+  CHECK(channel.tryRecv(value) && value == 1);
+
+  kaguya::WorkerPool pool(1, [](kaguya::State &s) {
+    s("function twice(x) return x * 2 end");
+  });
+  CHECK(pool.submit<int>("twice", 21).get() == 42);
+#endif
+  if (failures) {
+    std::fprintf(stderr, "%d failures\n", failures);
+  }
+  return failures ? 1 : 0;
+}
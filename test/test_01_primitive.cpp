@@ -1,3 +1,4 @@
+#include <limits>
 #include "kaguya/kaguya.hpp"
 #include "test_util.hpp"
 
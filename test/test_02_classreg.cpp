@@ -1549,5 +1549,131 @@ KAGUYA_TEST_FUNCTION_DEF(unregistered_property)(kaguya::State &state) {
 	TEST_CHECK(!state("base.c=1"));
 }
 
+KAGUYA_TEST_FUNCTION_DEF(static_descriptor_class)(kaguya::State &state) {
+  static const kaguya::ClassMemberDescriptor abc_members[] = {
+      {"new", &kaguya::static_constructor<ABC(int)>::invoke,
+       kaguya::CLASS_MEMBER_FUNCTION},
+      {"getInt", KAGUYA_STATIC_FUNCTION(&ABC::getInt),
+       kaguya::CLASS_MEMBER_FUNCTION},
+      {"setInt", KAGUYA_STATIC_FUNCTION(&ABC::setInt),
+       kaguya::CLASS_MEMBER_FUNCTION},
+      {"intmember", KAGUYA_STATIC_FUNCTION(&ABC::intmember),
+       kaguya::CLASS_MEMBER_PROPERTY},
+  };
+  state["ABC"].setClass(kaguya::StaticUserdataMetatable<ABC>(abc_members));
+
+  TEST_CHECK(state("value = assert(ABC.new(32))"));
+  TEST_CHECK(state("assert(value:getInt() == 32)"));
+  TEST_CHECK(state("value:setInt(5)"));
+  TEST_CHECK(state("assert(value.intmember == 5)"));
+  TEST_CHECK(state("value.intmember = 9"));
+  TEST_CHECK(state("assert(value:getInt() == 9)"));
+  TEST_CHECK(state("value2 = ABC(3) assert(value2:getInt() == 3)"));
+
+  ABC *ptr = state["value"];
+  TEST_CHECK(ptr);
+  TEST_EQUAL(ptr->intmember, 9);
+
+  state.setErrorHandler(ignore_error_fun);
+  last_error_message = "";
+  TEST_CHECK(!state("value:setInt('a')"));
+  TEST_CHECK(last_error_message.find("candidate is:") != std::string::npos);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(static_descriptor_derived_class)(
+    kaguya::State &state) {
+  static const kaguya::ClassMemberDescriptor base_members[] = {
+      {"get", KAGUYA_STATIC_FUNCTION(&Base::get),
+       kaguya::CLASS_MEMBER_FUNCTION},
+      {"a", KAGUYA_STATIC_FUNCTION(&Base::a), kaguya::CLASS_MEMBER_PROPERTY},
+  };
+  static const kaguya::ClassMemberDescriptor derived_members[] = {
+      {"new", &kaguya::static_constructor<Derived()>::invoke,
+       kaguya::CLASS_MEMBER_FUNCTION},
+      {"b", KAGUYA_STATIC_FUNCTION(&Derived::b),
+       kaguya::CLASS_MEMBER_PROPERTY},
+  };
+  state["Base"].setClass(kaguya::StaticUserdataMetatable<Base>(base_members));
+  state["Derived"].setClass(
+      kaguya::StaticUserdataMetatable<Derived, Base>(derived_members));
+
+  TEST_CHECK(state("d = Derived.new() d.a = 3 d.b = 4"));
+  TEST_CHECK(state("assert(d:get() == 3)"));
+  TEST_CHECK(state("assert(d.a == 3 and d.b == 4)"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(lazy_class_registration)(kaguya::State &state) {
+  state["ABC"].setLazyClass(kaguya::UserdataMetatable<ABC>()
+                                .setConstructors<ABC(int)>()
+                                .addFunction("getInt", &ABC::getInt)
+                                .addProperty("intmember", &ABC::intmember));
+  TEST_CHECK(!kaguya::class_userdata::get_registered_metatable(
+      state.state(), typeid(ABC)));
+  lua_pop(state.state(), 1);
+
+  TEST_CHECK(state("value = assert(ABC.new(32))"));
+  TEST_CHECK(kaguya::class_userdata::get_registered_metatable(state.state(),
+                                                              typeid(ABC)));
+  lua_pop(state.state(), 1);
+  TEST_CHECK(state("assert(value:getInt() == 32)"));
+  TEST_CHECK(state("assert(getmetatable(value) == ABC)"));
+  TEST_CHECK(state("assert(ABC(3).intmember == 3)"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(lazy_class_registered_before_build)(
+    kaguya::State &state) {
+  state["ABC"].setLazyClass(
+      kaguya::UserdataMetatable<ABC>().setConstructors<ABC(int)>());
+  // registered by other way, e.g. by another shared library
+  lua_State *L = state.state();
+  lua_newtable(L);
+  kaguya::class_userdata::register_metatable<ABC>(L, -1);
+  lua_pop(L, 1);
+  // builder finds ABC registered, and stub must not call it again
+  TEST_CHECK(state("assert(ABC.new == nil)"));
+  TEST_CHECK(state("ABC.x = 1 assert(ABC.x == 1)"));
+  TEST_CHECK(state("assert(getmetatable(ABC) == nil)"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(lazy_class_registration_by_push)(
+    kaguya::State &state) {
+  state["Base"].setLazyClass(kaguya::UserdataMetatable<Base>()
+                                 .addFunction("get", &Base::get)
+                                 .addProperty("a", &Base::a));
+  state["Derived"].setLazyClass(
+      kaguya::UserdataMetatable<Derived, Base>().addProperty("b",
+                                                             &Derived::b));
+  Derived derived;
+  derived.a = 3;
+  derived.b = 4;
+  state["derived"] = &derived;
+  TEST_CHECK(state("assert(derived:get() == 3)"));
+  TEST_CHECK(state("assert(derived.a == 3 and derived.b == 4)"));
+  TEST_CHECK(state("function Derived.twice(self) return self.b * 2 end"));
+  TEST_CHECK(state("assert(derived:twice() == 8)"));
+
+  TEST_CHECK(state("Derived2 = {}"));
+  state.setErrorHandler(ignore_error_fun);
+  last_error_message = "";
+  state["Derived2"].setLazyClass(kaguya::UserdataMetatable<Derived>());
+  TEST_CHECK(last_error_message.find("already registered") !=
+             std::string::npos);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(lazy_class_shared_by_states)(kaguya::State &state) {
+  const kaguya::LazyUserdataMetatable<ABC,
+                                      kaguya::PreparedUserdataMetatable<ABC> >
+      lazy = kaguya::lazyClass(kaguya::UserdataMetatable<ABC>()
+                                   .setConstructors<ABC(int)>()
+                                   .addFunction("getInt", &ABC::getInt));
+  kaguya::State other;
+  state["ABC"].setLazyClass(lazy);
+  other["ABC"].setLazyClass(lazy);
+  TEST_CHECK(state("assert(ABC.new(3):getInt() == 3)"));
+  TEST_CHECK(!kaguya::class_userdata::get_registered_metatable(
+      other.state(), typeid(ABC)));
+  lua_pop(other.state(), 1);
+  TEST_CHECK(other("assert(ABC.new(5):getInt() == 5)"));
+}
 
 KAGUYA_TEST_GROUP_END(test_02_classreg)
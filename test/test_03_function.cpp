@@ -493,4 +493,24 @@ KAGUYA_TEST_FUNCTION_DEF(none_to_string)(kaguya::State &state) {
   TEST_CHECK(last_error_message != "");
 }
 
+KAGUYA_TEST_FUNCTION_DEF(nothrow_function)(kaguya::State &state) {
+  state.setErrorHandler(ignore_error_fun);
+  state["nothrow_fn"] = kaguya::nothrow_function(overload3);
+  state["nothrow_overloaded"] =
+      kaguya::nothrow_overload(overload2, overload3);
+
+  TEST_CHECK(state("assert(nothrow_fn(5) == 3)"));
+  TEST_CHECK(state("assert(nothrow_overloaded('') == 2)"));
+  TEST_CHECK(state("assert(nothrow_overloaded(4) == 3)"));
+
+  last_error_message = "";
+  TEST_CHECK(!state.dostring("nothrow_fn('str')"));
+  TEST_CHECK_M(last_error_message.find("candidate is:") != std::string::npos,
+               last_error_message);
+  last_error_message = "";
+  TEST_CHECK(!state.dostring("nothrow_overloaded({})"));
+  TEST_CHECK_M(last_error_message.find("candidate is:") != std::string::npos,
+               last_error_message);
+}
+
 KAGUYA_TEST_GROUP_END(test_03_function)
@@ -1,3 +1,4 @@
+#include <iterator>
 #include "test_util.hpp"
 #include "kaguya/kaguya.hpp"
 
@@ -532,6 +533,224 @@ KAGUYA_TEST_FUNCTION_DEF(to_standard_function)(kaguya::State &state) {
   TEST_EQUAL(state["testfun3"](), "text");
 }
 
+KAGUYA_TEST_FUNCTION_DEF(fixed_result_count_call)(kaguya::State &state) {
+  state("manyresfun = function(a) return a, a * 2, a * 3, a * 4 end");
+  state("noresfun = function() end");
+  kaguya::LuaFunction many = state["manyresfun"];
+  kaguya::LuaFunction nores = state["noresfun"];
+  lua_State *L = state.state();
+  int top = lua_gettop(L);
+
+  TEST_EQUAL(many.call<int>(2), 2);
+  TEST_EQUAL(lua_gettop(L), top);
+
+  using kaguya::standard::get;
+  kaguya::standard::tuple<int, int> pair_res =
+      many.call<kaguya::standard::tuple<int, int> >(3);
+  TEST_EQUAL(get<0>(pair_res), 3);
+  TEST_EQUAL(get<1>(pair_res), 6);
+  TEST_EQUAL(lua_gettop(L), top);
+
+  // missing results are adjusted to nil
+  state("oneresfun = function() return 3232 end");
+  kaguya::standard::tuple<int, kaguya::optional<int> > opt_res =
+      state["oneresfun"]
+          .call<kaguya::standard::tuple<int, kaguya::optional<int> > >();
+  TEST_EQUAL(get<0>(opt_res), 3232);
+  TEST_CHECK(!get<1>(opt_res));
+  TEST_CHECK(!nores.call<kaguya::optional<int> >());
+  TEST_CHECK(nores.call<kaguya::LuaRef>().isNilref());
+  nores.call<void>();
+  TEST_EQUAL(lua_gettop(L), top);
+
+  kaguya::FunctionResults all = many(1);
+  TEST_EQUAL(all.result_size(), 4u);
+  TEST_EQUAL(all.result_at<int>(3), 4);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(prepared_call)(kaguya::State &state) {
+  state("add = function(a, b) return a + b end");
+  state("concat = function(a, b) return a .. b, #a + #b end");
+  state("counter = 0 increment = function() counter = counter + 1 end");
+  lua_State *L = state.state();
+  int top = lua_gettop(L);
+
+  kaguya::PreparedCall<int(int, int)> add = state["add"];
+  TEST_CHECK(add.valid());
+  TEST_EQUAL(add(1, 2), 3);
+  TEST_EQUAL(add(-5, 2), -3);
+  TEST_EQUAL(lua_gettop(L), top);
+
+  using kaguya::standard::get;
+  kaguya::PreparedCall<kaguya::standard::tuple<std::string, int>(
+      const std::string &, const char *)>
+      concat = state["concat"];
+  kaguya::standard::tuple<std::string, int> res = concat("ab", "cde");
+  TEST_EQUAL(get<0>(res), "abcde");
+  TEST_EQUAL(get<1>(res), 5);
+
+  kaguya::PreparedCall<void()> increment = state["increment"];
+  increment();
+  increment();
+  TEST_EQUAL(state["counter"], 2);
+
+  kaguya::LuaFunction add_function = state["add"];
+  kaguya::PreparedCall<kaguya::FunctionResults(int, int)> add_results(
+      add_function);
+  TEST_EQUAL(add_results(3, 4).result_size(), 1u);
+  TEST_EQUAL(lua_gettop(L), top);
+
+  kaguya::PreparedCall<int(int, int)> copied = add;
+  TEST_EQUAL(copied(20, 22), 42);
+  TEST_CHECK(copied.function() == add.function());
+  state["add2"] = copied;
+  TEST_CHECK(state("assert(add2(1, 1) == 2)"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(prepared_call_error)(kaguya::State &state) {
+  state("fail = function(msg) error(msg) end");
+  kaguya::PreparedCall<void(const char *)> fail = state["fail"];
+  kaguya::PreparedCall<void()> nilfn = state["nothing"];
+  kaguya::PreparedCall<void()> empty;
+  TEST_CHECK(!nilfn.valid());
+  TEST_CHECK(!empty.valid());
+
+  int top = lua_gettop(state.state());
+
+  // handler registered after preparation is used
+  state.setErrorHandler(ignore_error_fun);
+  last_error_message = "";
+  fail("prepared failure");
+  TEST_CHECK(last_error_message.find("prepared failure") != std::string::npos);
+  nilfn();
+  empty();
+  TEST_EQUAL(lua_gettop(state.state()), top);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(call_each)(kaguya::State &state) {
+  state("total = 0 accumulate = function(v, scale) total = total + v * scale "
+        "end");
+  state("scaled = function(v, scale, offset) return v * scale + offset end");
+  kaguya::LuaFunction accumulate = state["accumulate"];
+  kaguya::LuaFunction scaled = state["scaled"];
+  lua_State *L = state.state();
+  int top = lua_gettop(L);
+
+  std::vector<int> values;
+  for (int i = 1; i <= 4; ++i) {
+    values.push_back(i);
+  }
+  TEST_EQUAL(accumulate.callEach(values.begin(), values.end(), 10), 4u);
+  TEST_EQUAL(state["total"], 100);
+  TEST_EQUAL(lua_gettop(L), top);
+
+  std::vector<double> results;
+  scaled.callEach<double>(values.begin(), values.end(),
+                          std::back_inserter(results), 2, 0.5);
+  TEST_EQUAL(results.size(), 4u);
+  TEST_EQUAL(results[0], 2.5);
+  TEST_EQUAL(results[3], 8.5);
+
+  int array_results[4] = {0, 0, 0, 0};
+  int *end = state["scaled"].callEach<int>(&values[0], &values[0] + 4,
+                                           array_results, 3, 0);
+  TEST_EQUAL(end - array_results, 4);
+  TEST_EQUAL(array_results[1], 6);
+  TEST_EQUAL(lua_gettop(L), top);
+
+  std::vector<int> empty;
+  TEST_EQUAL(accumulate.callEach(empty.begin(), empty.end(), 1), 0u);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(call_each_error)(kaguya::State &state) {
+  state("visited = 0 check = function(v) visited = visited + 1 "
+        "if v % 2 == 0 then error('even ' .. v) end return v end");
+  kaguya::LuaFunction check = state["check"];
+  lua_State *L = state.state();
+  int top = lua_gettop(L);
+  std::vector<int> values;
+  for (int i = 1; i <= 5; ++i) {
+    values.push_back(i);
+  }
+
+  kaguya::CallEachErrors errors;
+  std::vector<int> results;
+  check.callEach<int>(values.begin(), values.end(),
+                      std::back_inserter(results), errors);
+  TEST_EQUAL(results.size(), 3u);
+  TEST_EQUAL(results[2], 5);
+  TEST_EQUAL(errors.size(), 2u);
+  TEST_EQUAL(errors[0].index, 1u);
+  TEST_EQUAL(errors[1].index, 3u);
+  TEST_CHECK(errors[1].message.find("even 4") != std::string::npos);
+  TEST_EQUAL(errors[1].status, LUA_ERRRUN);
+  TEST_EQUAL(state["visited"], 5);
+
+  kaguya::CallEachErrors stop(true);
+  state("visited = 0");
+  TEST_EQUAL(check.callEach(values.begin(), values.end(), stop), 1u);
+  TEST_EQUAL(stop.size(), 1u);
+  TEST_EQUAL(state["visited"], 2);
+
+  state.setErrorHandler(ignore_error_fun);
+  state("visited = 0");
+  last_error_message = "";
+  TEST_EQUAL(check.callEach(values.begin(), values.end()), 1u);
+  TEST_CHECK(last_error_message.find("even 2") != std::string::npos);
+  TEST_EQUAL(state["visited"], 2);
+  TEST_EQUAL(lua_gettop(L), top);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(thread_pool)(kaguya::State &state) {
+  state("handler = function(v) local x = coroutine.yield(v * 2) "
+        "return x + v end");
+  kaguya::LuaFunction handler = state["handler"];
+  kaguya::ThreadPool pool(state.state(), 2);
+
+  kaguya::LuaThread first = pool.acquire(handler);
+  lua_State *first_thread = first.getthread();
+  TEST_EQUAL(first.resume<int>(5), 10);
+  TEST_EQUAL(first.resume<int>(1), 6);
+  TEST_CHECK(first.isThreadDead());
+  TEST_CHECK(pool.release(first));
+  TEST_CHECK(first.isNilref());
+  TEST_EQUAL(pool.idleCount(), 1u);
+
+  kaguya::LuaThread second = pool.acquire(handler);
+  TEST_CHECK(second.getthread() == first_thread);
+  TEST_EQUAL(second.resume<int>(3), 6);
+  TEST_EQUAL(second.resume<int>(1), 4);
+  TEST_EQUAL(pool.createdCount(), 1u);
+  TEST_EQUAL(pool.reusedCount(), 1u);
+  TEST_CHECK(pool.release(second));
+
+  // not started thread is reusable
+  kaguya::LuaThread unused = pool.acquire(handler);
+  TEST_CHECK(pool.release(unused));
+
+  kaguya::LuaThread suspended = pool.acquire(handler);
+  TEST_EQUAL(suspended.resume<int>(1), 2);
+#if LUA_VERSION_NUM >= 504
+  TEST_CHECK(pool.release(suspended));
+#else
+  TEST_CHECK(!pool.release(suspended));
+  TEST_EQUAL(pool.discardedCount(), 1u);
+#endif
+
+  kaguya::LuaThread a = pool.acquire();
+  kaguya::LuaThread b = pool.acquire();
+  kaguya::LuaThread c = pool.acquire();
+  TEST_CHECK(pool.release(a));
+  TEST_CHECK(pool.release(b));
+  TEST_CHECK(!pool.release(c)); // exceeds max idle
+  TEST_EQUAL(pool.idleCount(), 2u);
+  pool.clear();
+  TEST_EQUAL(pool.idleCount(), 0u);
+
+  kaguya::LuaThread nil_thread;
+  TEST_CHECK(!pool.release(nil_thread));
+}
+
 KAGUYA_TEST_FUNCTION_DEF(return_luastackref)(kaguya::State &state) {
   state("testfun = function() return 3232 end");
   kaguya::LuaRef testfunref = state["testfun"];
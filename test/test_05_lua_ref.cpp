@@ -658,4 +658,176 @@ KAGUYA_TEST_FUNCTION_DEF(typecheck_ref_error)(kaguya::State &state) {
   }
 }
 
+KAGUYA_TEST_FUNCTION_DEF(ref_store)(kaguya::State &state) {
+  using kaguya::Ref::RefStore;
+  lua_State *L = state.state();
+  RefStore *store = RefStore::get(L);
+  TEST_CHECK(store == RefStore::get(L));
+  RefStore::Stats base = RefStore::stats(L);
+
+  lua_pushnil(L);
+  TEST_EQUAL(store->acquire(L), LUA_REFNIL);
+
+  lua_pushinteger(L, 32);
+  int slot = store->acquire(L);
+  TEST_CHECK(slot > 0);
+  TEST_EQUAL(RefStore::stats(L).live_refs, base.live_refs + 1);
+  store->addref(slot);
+  TEST_EQUAL(RefStore::stats(L).live_refs, base.live_refs + 1);
+  TEST_EQUAL(RefStore::stats(L).live_handles, base.live_handles + 2);
+
+  store->push(L, slot);
+  TEST_EQUAL(lua_tointeger(L, -1), 32);
+  lua_pop(L, 1);
+
+  unsigned int generation = store->generation(slot);
+  store->release(L, slot);
+  TEST_EQUAL(store->generation(slot), generation);
+  store->release(L, slot);
+  TEST_CHECK(store->generation(slot) != generation);
+  TEST_EQUAL(RefStore::stats(L).live_refs, base.live_refs);
+  TEST_EQUAL(RefStore::stats(L).live_handles, base.live_handles);
+
+  lua_pushliteral(L, "reuse");
+  TEST_EQUAL(store->acquire(L), slot);
+  store->release(L, slot);
+
+#if KAGUYA_USE_REF_STORE
+  base = RefStore::stats(L);
+  {
+    kaguya::LuaRef ref(L, "value");
+    std::vector<kaguya::LuaRef> copies(10, ref);
+    TEST_EQUAL(RefStore::stats(L).live_refs, base.live_refs + 1);
+    TEST_EQUAL(RefStore::stats(L).live_handles, base.live_handles + 11);
+    TEST_EQUAL(copies[5], "value");
+  }
+  TEST_EQUAL(RefStore::stats(L).live_refs, base.live_refs);
+#endif
+}
+
+KAGUYA_TEST_FUNCTION_DEF(lua_table_pairs)(kaguya::State &state) {
+  lua_State *L = state.state();
+  state("t={a=1,b=2,c=3,[4]=4}");
+  kaguya::LuaTable t = state["t"];
+  int top = lua_gettop(L);
+  {
+    int sum = 0;
+    std::string keys;
+    kaguya::TablePairs<std::string, int> range = t.pairs<std::string, int>();
+    for (kaguya::TablePairs<std::string, int>::iterator it = range.begin();
+         it != range.end(); ++it) {
+      int loop_top = lua_gettop(L);
+      keys += (*it).first;
+      sum += (*it).second;
+      TEST_EQUAL(lua_gettop(L), loop_top);
+    }
+    TEST_EQUAL(sum, 10);
+    TEST_EQUAL(keys.size(), 4u);
+    TEST_CHECK(keys.find('4') != std::string::npos);
+  }
+  TEST_EQUAL(lua_gettop(L), top);
+
+  state("s={10,20,30,nil,50}");
+  {
+    size_t count = 0;
+    int sum = 0;
+    kaguya::TableIPairs<int> range = state["s"].ipairs<int>();
+    for (kaguya::TableIPairs<int>::iterator it = range.begin();
+         it != range.end(); ++it) {
+      count = (*it).first;
+      sum += (*it).second;
+    }
+    TEST_EQUAL(count, 3u);
+    TEST_EQUAL(sum, 60);
+  }
+  TEST_EQUAL(lua_gettop(L), top);
+
+  {
+    state.setErrorHandler(ignore_error_fun);
+    last_error_message = "";
+    kaguya::TableIPairs<int> range = state["nothing"].ipairs<int>();
+    TEST_CHECK(range.begin() == range.end());
+    TEST_EQUAL(last_error_message, "is not table");
+    kaguya::LuaTable empty = state.newTable();
+    kaguya::TablePairs<int, int> pairs = empty.pairs<int, int>();
+    TEST_CHECK(pairs.begin() == pairs.end());
+  }
+  TEST_EQUAL(lua_gettop(L), top);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(lua_path)(kaguya::State &state) {
+  state("config={net={timeout=30,host='localhost'},name='app'}");
+
+  kaguya::LuaPath timeout(state.globalTable(), "config.net.timeout");
+  TEST_EQUAL(timeout.depth(), 3u);
+  TEST_EQUAL(timeout.get<int>(), 30);
+  TEST_CHECK(!timeout.isNilref());
+
+  std::vector<std::string> keys;
+  keys.push_back("config");
+  keys.push_back("name");
+  kaguya::LuaPath name(state.globalTable(), keys);
+  TEST_EQUAL(name.get<std::string>(), "app");
+
+  TEST_CHECK(timeout.set(60));
+  TEST_CHECK(state("assert(config.net.timeout == 60)"));
+
+  kaguya::LuaPath missing(state.globalTable(), "config.nothing.timeout");
+  TEST_CHECK(missing.isNilref());
+  TEST_CHECK(!missing.set(1));
+
+  // metamethods are not used
+  state("setmetatable(config, {__index=function() return {timeout=1} end})");
+  TEST_CHECK(missing.isNilref());
+
+  state["path_value"] = timeout;
+  TEST_EQUAL(state["path_value"], 60);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(lua_path_replaced_table)(kaguya::State &state) {
+  state("config={net={timeout=30}}");
+  kaguya::LuaPath timeout(state.globalTable(), "config.net.timeout");
+  TEST_EQUAL(timeout.get<int>(), 30);
+  state("config.net.timeout = 40");
+  TEST_EQUAL(timeout.get<int>(), 40);
+
+  state("config={net={timeout=50}}");
+  TEST_EQUAL(timeout.get<int>(), 50);
+
+  state("config.net={timeout=70}");
+  TEST_EQUAL(timeout.get<int>(), 70);
+  TEST_CHECK(timeout.set(80));
+  TEST_CHECK(state("assert(config.net.timeout == 80)"));
+
+  state("config=nil");
+  TEST_CHECK(timeout.isNilref());
+}
+
+KAGUYA_TEST_FUNCTION_DEF(lua_path_deep)(kaguya::State &state) {
+  state("deep={} local t=deep for i=1,199 do t.k={} t=t.k end t.k=7");
+  std::vector<std::string> keys(1, "deep");
+  keys.resize(201, "k");
+  kaguya::LuaPath path(state.globalTable(), keys);
+  int top = lua_gettop(state.state());
+  TEST_EQUAL(path.get<int>(), 7);
+  TEST_CHECK(path.set(8));
+  TEST_EQUAL(path.get<int>(), 8);
+  TEST_EQUAL(path.push(), 1);
+  TEST_EQUAL(lua_tointeger(state.state(), -1), 8);
+  lua_pop(state.state(), 1);
+  TEST_EQUAL(lua_gettop(state.state()), top);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(lua_path_nostate)(kaguya::State &state) {
+  state.setErrorHandler(ignore_error_fun);
+  kaguya::LuaPath path;
+  TEST_CHECK(path.isNilref());
+  TEST_CHECK(!path.set(1));
+  TEST_EQUAL(path.push(), 0);
+  TEST_EQUAL(path.get<int>(), 0);
+  TEST_EQUAL(path.push(state.state()), 1);
+  TEST_CHECK(lua_isnil(state.state(), -1));
+  lua_pop(state.state(), 1);
+}
+
 KAGUYA_TEST_GROUP_END(test_05_lua_ref)
@@ -528,4 +528,39 @@ KAGUYA_TEST_FUNCTION_DEF(defailt_error_handler)(kaguya::State &) {
   kaguya::State state;
   state("a");
 }
+#if KAGUYA_USE_MAIN_THREAD_CACHE
+KAGUYA_TEST_FUNCTION_DEF(main_thread_cache)(kaguya::State &state) {
+  using kaguya::util::MainThreadCache;
+  lua_State *L = state.state();
+  lua_State *thread = lua_newthread(L);
+
+#if LUA_VERSION_NUM < 502
+  // added by State constructor
+  TEST_CHECK(MainThreadCache::find(thread) == L);
+#else
+  TEST_CHECK(MainThreadCache::find(thread) == 0);
+  TEST_CHECK(MainThreadCache::add(L));
+#endif
+  TEST_CHECK(!MainThreadCache::add(L));
+  TEST_CHECK(MainThreadCache::find(L) == L);
+  TEST_CHECK(MainThreadCache::find(thread) == L);
+  TEST_CHECK(kaguya::util::toMainThread(thread) == L);
+  {
+    kaguya::State other;
+    lua_State *other_thread = lua_newthread(other.state());
+    TEST_CHECK(MainThreadCache::find(other_thread) != L);
+    TEST_CHECK(kaguya::util::toMainThread(other_thread) == other.state());
+    lua_pop(other.state(), 1);
+  }
+  MainThreadCache::remove(L);
+  TEST_CHECK(MainThreadCache::find(thread) == 0);
+  TEST_CHECK(kaguya::util::toMainThread(thread) == L);
+#if LUA_VERSION_NUM < 502
+  // restore entry removed by ~State
+  TEST_CHECK(MainThreadCache::add(L));
+#endif
+  lua_pop(L, 1);
+}
+#endif
+
 KAGUYA_TEST_GROUP_END(test_06_state)
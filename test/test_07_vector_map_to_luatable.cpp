@@ -17,6 +17,47 @@ KAGUYA_TEST_FUNCTION_DEF(vector_from_table)(kaguya::State &state) {
   TEST_CHECK(state["arraytablefn"]().typeTest<std::vector<int> >());
 }
 
+KAGUYA_TEST_FUNCTION_DEF(vector_from_sequence_table)(kaguya::State &state) {
+  state("seq={} for i=1,1000 do seq[i]=i*2 end");
+  std::vector<int> v = state["seq"];
+  TEST_EQUAL(v.size(), 1000);
+  TEST_EQUAL(v[0], 2);
+  TEST_EQUAL(v[999], 2000);
+
+  // not sequence. all values are returned
+  state("holes={1,2,nil,4}");
+  std::vector<int> h = state["holes"];
+  TEST_EQUAL(h.size(), 3);
+  state("mixed={1,2,x=3}");
+  std::vector<int> m = state["mixed"];
+  TEST_EQUAL(m.size(), 3);
+  TEST_EQUAL(m[0], 1);
+  TEST_EQUAL(m[1], 2);
+  TEST_EQUAL(m[2], 3);
+  state("extra={1,2,3,4,5,6,7,8} extra.x=10");
+  std::vector<int> extra = state["extra"];
+  TEST_EQUAL(extra.size(), 9);
+  for (int i = 0; i < 8; ++i) {
+    TEST_EQUAL(extra[i], i + 1);
+  }
+  TEST_EQUAL(extra[8], 10);
+  std::deque<int> extra_deque = state["extra"];
+  TEST_EQUAL(extra_deque.size(), 9);
+  TEST_EQUAL(extra_deque.front(), 1);
+  TEST_EQUAL(extra_deque[7], 8);
+  // sequence keys in hash part are read in order
+  state("hashed={} for i=8,1,-1 do hashed[i]=i end");
+  std::vector<int> hashed = state["hashed"];
+  TEST_EQUAL(hashed.size(), 8);
+  for (int i = 0; i < 8; ++i) {
+    TEST_EQUAL(hashed[i], i + 1);
+  }
+
+  state("empty={}");
+  std::vector<int> e = state["empty"];
+  TEST_CHECK(e.empty());
+}
+
 KAGUYA_TEST_FUNCTION_DEF(vector_to_table)(kaguya::State &state) {
   std::vector<double> v;
   v.push_back(3);
@@ -144,4 +185,179 @@ KAGUYA_TEST_FUNCTION_DEF(testWrongClassUseWihMap)(kaguya::State &state) {
 
 #endif
 
+#ifndef KAGUYA_NO_STD_CONTAINER_TO_TABLE
+KAGUYA_TEST_FUNCTION_DEF(deque_table)(kaguya::State &state) {
+  state("seq={1,2,3}");
+  std::deque<int> d = state["seq"];
+  TEST_EQUAL(d.size(), 3);
+  TEST_EQUAL(d.back(), 3);
+  state("mixed={1,2,x=3}");
+  TEST_EQUAL(state["mixed"].get<std::deque<int> >().size(), 3);
+  TEST_CHECK(!state["mixed"].typeTest<std::deque<std::string> >());
+
+  d.push_front(0);
+  state["d"] = d;
+  TEST_CHECK(state("assert(#d == 4 and d[1] == 0 and d[4] == 3)"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(set_table)(kaguya::State &state) {
+  state("values={3,1,2,1}");
+  std::set<int> s = state["values"];
+  TEST_EQUAL(s.size(), 3);
+  TEST_EQUAL(*s.begin(), 1);
+  s.insert(10);
+  state["s"] = s;
+  TEST_CHECK(state("assert(#s == 4 and s[1] == 1 and s[4] == 10)"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(pair_table)(kaguya::State &state) {
+  state["p"] = std::make_pair(std::string("key"), 5);
+  TEST_CHECK(state("assert(p[1] == 'key' and p[2] == 5)"));
+  std::pair<std::string, int> p = state["p"];
+  TEST_EQUAL(p.first, "key");
+  TEST_EQUAL(p.second, 5);
+  TEST_CHECK((state["p"].typeTest<std::pair<std::string, int> >()));
+  TEST_CHECK(!(state["p"].typeTest<std::pair<int, int> >()));
+
+  state("pairs={{1,2},{3,4}}");
+  std::vector<std::pair<int, int> > pairs = state["pairs"];
+  TEST_EQUAL(pairs.size(), 2);
+  TEST_EQUAL(pairs[1].second, 4);
+}
+
+#if KAGUYA_USE_CPP11
+KAGUYA_TEST_FUNCTION_DEF(unordered_map_table)(kaguya::State &state) {
+  state("t={a=1,b=2,[3]=4}");
+  std::unordered_map<std::string, int> m = state["t"];
+  TEST_EQUAL(m.size(), 3);
+  TEST_EQUAL(m["b"], 2);
+  TEST_EQUAL(m["3"], 4);
+  // reserved by all keys, not by length of sequence part
+  lua_State *L = state.state();
+  state["t"].push(L);
+  TEST_EQUAL(kaguya::detail::table_entry_count(L, lua_gettop(L)), 3u);
+  lua_pop(L, 1);
+  TEST_CHECK(!(state["t"].typeTest<std::unordered_map<std::string,
+                                                       std::string> >()));
+
+  std::unordered_map<std::string, std::vector<int> > nested;
+  nested["x"] = std::vector<int>(3, 7);
+  state["nested"] = std::move(nested);
+  TEST_CHECK(state("assert(#nested.x == 3 and nested.x[3] == 7)"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(unordered_set_table)(kaguya::State &state) {
+  state("names={'a','b','a'}");
+  std::unordered_set<std::string> s = state["names"];
+  TEST_EQUAL(s.size(), 2);
+  TEST_CHECK(s.count("b") == 1);
+  state["s"] = s;
+  TEST_CHECK(state("assert(#s == 2)"));
+}
+#endif
+#endif
+
+#if KAGUYA_USE_CPP11 && !defined(KAGUYA_NO_STD_VECTOR_TO_TABLE) &&           \
+    !defined(KAGUYA_NO_STD_MAP_TO_TABLE)
+struct CopyCounted {
+  CopyCounted(int v = 0) : value(v) {}
+  CopyCounted(const CopyCounted &src) : value(src.value) { ++copies; }
+  CopyCounted(CopyCounted &&src) : value(src.value) {}
+  CopyCounted &operator=(const CopyCounted &src) {
+    value = src.value;
+    ++copies;
+    return *this;
+  }
+  int value;
+  static int copies;
+};
+int CopyCounted::copies = 0;
+
+KAGUYA_TEST_FUNCTION_DEF(move_nested_container_push)(kaguya::State &state) {
+  state["CopyCounted"].setClass(
+      kaguya::UserdataMetatable<CopyCounted>().addProperty(
+          "value", &CopyCounted::value));
+  std::map<std::string, std::vector<CopyCounted> > m;
+  m["a"].push_back(CopyCounted(1));
+  m["a"].push_back(CopyCounted(2));
+  m["b"].push_back(CopyCounted(3));
+  std::array<CopyCounted, 2> a = {{CopyCounted(4), CopyCounted(5)}};
+  std::vector<std::vector<CopyCounted> > vv(2, std::vector<CopyCounted>(3));
+
+  CopyCounted::copies = 0;
+  state["m"] = std::move(m);
+  state["a"] = std::move(a);
+  state["vv"] = std::move(vv);
+  TEST_EQUAL(CopyCounted::copies, 0);
+  TEST_CHECK(state("assert(#m.a == 2 and m.a[2].value == 2)"));
+  TEST_CHECK(state("assert(m.b[1].value == 3 and a[2].value == 5)"));
+  TEST_CHECK(state("assert(#vv == 2 and #vv[2] == 3)"));
+
+  // const reference push copies
+  std::map<int, CopyCounted> copied;
+  copied[1] = CopyCounted(1);
+  CopyCounted::copies = 0;
+  state["copied"] = copied;
+  TEST_EQUAL(CopyCounted::copies, 1);
+}
+#endif
+
+#if !defined(KAGUYA_NO_STD_VECTOR_TO_TABLE) &&                                 \
+    !defined(KAGUYA_NO_STD_MAP_TO_TABLE)
+int table_type_int_vector(const std::vector<int> &) { return 1; }
+int table_type_string_vector(const std::vector<std::string> &) { return 2; }
+
+KAGUYA_TEST_FUNCTION_DEF(table_type_check_policy)(kaguya::State &state) {
+  state("mixed={1,2,'x'}");
+  state("big={} for i=1,1000 do big[i]=i end big[1000]='x'");
+  state("map={a=1,b=2,c='x'}");
+  typedef std::vector<int> int_vector;
+  typedef std::map<std::string, int> int_map;
+
+  TEST_EQUAL(state.tableTypeCheck().policy, kaguya::TableTypeCheck::CHECK_ALL);
+  TEST_CHECK(!state["mixed"].isType<int_vector>());
+  TEST_CHECK(!state["big"].isType<int_vector>());
+  TEST_CHECK(!state["map"].isType<int_map>());
+
+  state.setTableTypeCheck(kaguya::TableTypeCheck::CHECK_FIRST, 2);
+  TEST_EQUAL(state.tableTypeCheck().limit, 2u);
+  TEST_CHECK(state["mixed"].isType<int_vector>());
+  TEST_CHECK(state["big"].isType<int_vector>());
+  TEST_CHECK(!state["mixed"].isType<std::vector<std::string> >());
+
+  state.setTableTypeCheck(kaguya::TableTypeCheck::CHECK_SAMPLE, 8);
+  TEST_CHECK(!state["big"].isType<int_vector>());
+  state("big[1000]=1000");
+  TEST_CHECK(state["big"].isType<int_vector>());
+  TEST_CHECK(!state["mixed"].isType<int_vector>());
+
+  state.setTableTypeCheck(kaguya::TableTypeCheck::CHECK_TABLE);
+  TEST_CHECK(state["mixed"].isType<int_vector>());
+  TEST_CHECK(state["map"].isType<int_map>());
+  TEST_CHECK(!state["mixed"][1].isType<int_vector>());
+
+  // unchecked element is reported on conversion
+  state["f"] = kaguya::overload(table_type_int_vector, table_type_string_vector);
+  try {
+    state("f({'a','b'})");
+    TEST_CHECK(false);
+  } catch (std::runtime_error &) {
+  }
+  state.setTableTypeCheck(kaguya::TableTypeCheck::CHECK_FIRST, 1);
+  TEST_CHECK(state("assert(f({'a','b'}) == 2)"));
+  TEST_CHECK(state("assert(f({1,2}) == 1)"));
+
+  // nothrow dispatch checks all elements regardless of policy
+  state["nothrow_f"] = kaguya::nothrow_function(table_type_int_vector);
+  TEST_CHECK(state("local ok, msg = pcall(nothrow_f, {1,'x'}) "
+                   "assert(not ok and msg:find('candidate'))"));
+  TEST_CHECK(state("assert(nothrow_f({1,2}) == 1)"));
+  TEST_EQUAL(state.tableTypeCheck().policy,
+             kaguya::TableTypeCheck::CHECK_FIRST);
+
+  state.setTableTypeCheck(kaguya::TableTypeCheck::CHECK_ALL);
+  TEST_CHECK(!state["mixed"].isType<int_vector>());
+}
+#endif
+
 KAGUYA_TEST_GROUP_END(test_07_vector_map_to_luatable)
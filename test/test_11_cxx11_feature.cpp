@@ -337,6 +337,61 @@ KAGUYA_TEST_FUNCTION_DEF(register_luafunction_from_coroutine)
   TEST_CHECK(func() == 123);
 }
 
+KAGUYA_TEST_FUNCTION_DEF(table_range_for)(kaguya::State &state) {
+  state("t={a=1,b=2} s={1,2,3}");
+  kaguya::LuaTable t = state["t"];
+  int top = lua_gettop(state.state());
+  std::map<std::string, int> m;
+  for (auto kv : t.pairs<std::string, int>()) {
+    m[kv.first] = kv.second;
+  }
+  TEST_EQUAL(m.size(), 2u);
+  TEST_EQUAL(m["b"], 2);
+
+  int sum = 0;
+  for (auto iv : state["s"].ipairs<int>()) {
+    sum += iv.second * static_cast<int>(iv.first);
+  }
+  TEST_EQUAL(sum, 14);
+  TEST_EQUAL(lua_gettop(state.state()), top);
+}
+
+#if __cplusplus >= 201703L && defined(__cpp_noexcept_function_type)
+int noexcept_add(int a, int b) noexcept { return a + b; }
+int throwing_add(int a, int b) { return a + b; }
+struct NoexceptAdder {
+  int add(int a) const noexcept { return a + 1; }
+};
+bool noexcept_store(const kaguya::SerializedValue &value) noexcept {
+  return !value.empty();
+}
+
+KAGUYA_TEST_FUNCTION_DEF(noexcept_function_dispatch)(kaguya::State &state) {
+  using kaguya::detail::is_noexcept_tuple;
+  TEST_CHECK((is_noexcept_tuple<std::tuple<decltype(&noexcept_add)> >::value));
+  TEST_CHECK((is_noexcept_tuple<
+              std::tuple<decltype(&NoexceptAdder::add)> >::value));
+  auto lambda = [](int a) noexcept { return a; };
+  TEST_CHECK((is_noexcept_tuple<std::tuple<decltype(lambda)> >::value));
+  TEST_CHECK((!is_noexcept_tuple<std::tuple<decltype(&noexcept_add),
+                                            decltype(&throwing_add)> >::value));
+
+  state["noexcept_add"] = kaguya::function(noexcept_add);
+  state["noexcept_overload"] = kaguya::overload(noexcept_add, lambda);
+  TEST_CHECK(state("assert(noexcept_add(1, 2) == 3)"));
+  TEST_CHECK(state("assert(noexcept_overload(1, 2) == 3)"));
+  TEST_CHECK(state("assert(noexcept_overload(4) == 4)"));
+  TEST_CHECK(state("local ok, msg = pcall(noexcept_add, 'x') "
+                   "assert(not ok and msg:find('candidate'))"));
+
+  // argument conversion throws though the check passed
+  state["noexcept_store"] = kaguya::function(noexcept_store);
+  TEST_CHECK(state("assert(noexcept_store({1, 2}))"));
+  TEST_CHECK(state("local ok = pcall(noexcept_store, {print}) "
+                   "assert(not ok)"));
+}
+#endif
+
 KAGUYA_TEST_GROUP_END(test_11_cxx11_feature)
 
 #endif
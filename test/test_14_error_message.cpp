@@ -45,4 +45,82 @@ KAGUYA_TEST_FUNCTION_DEF(defaultarguments)(kaguya::State &state) {
   }
 }
 
+int overloaded_int(int a) { return a; }
+int overloaded_int_string(int a, const std::string &) { return a; }
+
+KAGUYA_TEST_FUNCTION_DEF(candidate_message_repeat)(kaguya::State &state) {
+  state.setErrorHandler(error_fun);
+  state["fn"] = kaguya::overload(overloaded_int, overloaded_int_string);
+
+  TEST_CHECK(&kaguya::util::pretty_name<int>() ==
+             &kaguya::util::pretty_name<int>());
+  TEST_EQUAL(kaguya::util::pretty_name<int>(),
+             kaguya::util::pretty_name(typeid(int)));
+
+  state.dostring("fn({})");
+  std::string first = last_error_message;
+  TEST_CHECK_M(first.find("candidate is:") != std::string::npos, first);
+  TEST_CHECK_M(first.find(kaguya::util::pretty_name<std::string>()) !=
+                   std::string::npos,
+               first);
+  last_error_message = "";
+  state.dostring("fn({})");
+  TEST_EQUAL(last_error_message, first);
+  TEST_CHECK(state("assert(fn(3) == 3)"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(deferred_argument_error)(kaguya::State &state) {
+  state.setErrorHandler(error_fun);
+  state["fn"] = kaguya::overload(overloaded_int, overloaded_int_string);
+  state["nothrow_fn"] = kaguya::nothrow_function(overloaded_int);
+
+  TEST_CHECK(!state.isDeferredArgumentError());
+  TEST_CHECK(state("local ok, err = pcall(fn, {})\n"
+                   "assert(type(err) == 'string')"));
+
+  state.setDeferredArgumentError(true);
+  TEST_CHECK(state.isDeferredArgumentError());
+  TEST_CHECK(state("local ok, err = pcall(fn, {})\n"
+                   "assert(not ok and type(err) == 'userdata')\n"
+                   "local msg = tostring(err)\n"
+                   "assert(msg:find('candidate is:', 1, true))\n"
+                   "assert(msg:find('table', 1, true))\n"
+                   "assert(tostring(err) == msg)\n"
+                   "assert(type(getmetatable(err)) == 'string')\n"
+                   "local raw = debug.getmetatable(err).__tostring\n"
+                   "assert(not pcall(raw, {}))\n"
+                   "assert(not pcall(raw, io.stdout))"));
+  TEST_CHECK(state("local ok, err = pcall(nothrow_fn, 'str')\n"
+                   "assert(not ok and type(err) == 'userdata')\n"
+                   "assert(tostring(err):find('candidate is:', 1, true))"));
+
+  last_error_message = "";
+  state.dostring("fn({})");
+  TEST_CHECK_M(last_error_message.find("candidate is:") != std::string::npos,
+               last_error_message);
+  TEST_CHECK_M(last_error_message.find(
+                   kaguya::util::pretty_name<std::string>()) !=
+                   std::string::npos,
+               last_error_message);
+
+  state.setDeferredArgumentError(false);
+  TEST_CHECK(state("local ok, err = pcall(fn, {})\n"
+                   "assert(type(err) == 'string')"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(error_object_tostring)(kaguya::State &state) {
+  state.setErrorHandler(error_fun);
+  last_error_message = "";
+  state.dostring("error(setmetatable({}, {__tostring = function() "
+                 "return 'custom error' end}))");
+  TEST_EQUAL(last_error_message, "custom error");
+
+  // error in __tostring is caught, and does not panic
+  last_error_message = "";
+  state.dostring("error(setmetatable({}, {__tostring = function() "
+                 "error('x') end}))");
+  TEST_EQUAL(last_error_message, "unknown error");
+  TEST_CHECK(state("assert(true)"));
+}
+
 KAGUYA_TEST_GROUP_END(test_14_error_message)
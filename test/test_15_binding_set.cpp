@@ -0,0 +1,56 @@
+#include "kaguya/kaguya.hpp"
+#include "test_util.hpp"
+
+KAGUYA_TEST_GROUP_START(test_15_binding_set)
+using namespace kaguya_test_util;
+
+struct Point {
+  Point() : x(0), y(0) {}
+  Point(int ax, int ay) : x(ax), y(ay) {}
+  int x;
+  int y;
+  int sum() const { return x + y; }
+};
+struct Point3 : Point {
+  Point3() : z(0) {}
+  int z;
+};
+
+const kaguya::BindingSet &test_bindings() {
+  static const kaguya::BindingSet bindings =
+      kaguya::BindingSet()
+          .addClass("Point", kaguya::UserdataMetatable<Point>()
+                                 .setConstructors<Point(), Point(int, int)>()
+                                 .addFunction("sum", &Point::sum)
+                                 .addProperty("x", &Point::x)
+                                 .addProperty("y", &Point::y))
+          .addLazyClass("Point3", kaguya::UserdataMetatable<Point3, Point>()
+                                      .setConstructors<Point3()>()
+                                      .addProperty("z", &Point3::z));
+  return bindings;
+}
+
+KAGUYA_TEST_FUNCTION_DEF(install_to_global)(kaguya::State &state) {
+  kaguya::BindingSet::InstallStats stats =
+      test_bindings().install(state.state());
+  TEST_EQUAL(stats.class_count, 2u);
+  TEST_CHECK(stats.elapsed_seconds >= 0);
+
+  TEST_CHECK(state("p = Point.new(1,2) assert(p:sum() == 3)"));
+  TEST_CHECK(state("p.x = 5 assert(p.x == 5 and p:sum() == 7)"));
+  TEST_CHECK(state("p3 = Point3() p3.x = 1 p3.z = 2"));
+  TEST_CHECK(state("assert(p3:sum() == 1 and p3.z == 2)"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(install_to_many_states)(kaguya::State &) {
+  for (int i = 0; i < 10; ++i) {
+    kaguya::State state;
+    kaguya::LuaTable module = state.newTable();
+    state["mod"] = module;
+    test_bindings().install(module);
+    TEST_CHECK(state("assert(mod.Point.new(2,3):sum() == 5)"));
+    TEST_CHECK(state("assert(mod.Point3.new().z == 0)"));
+  }
+}
+
+KAGUYA_TEST_GROUP_END(test_15_binding_set)
@@ -0,0 +1,134 @@
+#include <limits>
+#include "kaguya/kaguya.hpp"
+#include "test_util.hpp"
+
+KAGUYA_TEST_GROUP_START(test_16_typed_array)
+using namespace kaguya_test_util;
+
+float span_sum(kaguya::span<float> values) {
+  float result = 0;
+  for (kaguya::span<float>::iterator it = values.begin(); it != values.end();
+       ++it) {
+    result += *it;
+  }
+  return result;
+}
+void span_double(kaguya::span<float> values) {
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] *= 2;
+  }
+}
+float span_front(kaguya::span<const float> values) {
+  return values.empty() ? 0 : values[0];
+}
+std::vector<float> shared_buffer(4, 1.5f);
+kaguya::span<float> get_shared_buffer() {
+  return kaguya::span<float>(shared_buffer);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(typed_array_lua_owned)(kaguya::State &state) {
+  state["FloatArray"] =
+      kaguya::luacfunction(&kaguya::TypedArray<float>::create);
+  TEST_CHECK(state("a = FloatArray(4)"));
+  TEST_CHECK(state("assert(#a == 4 and a[1] == 0 and a[5] == nil)"));
+  TEST_CHECK(state("a[1] = 1.5 a[4] = 3"));
+  TEST_CHECK(state("assert(a[1] == 1.5 and a[4] == 3)"));
+  TEST_CHECK(state("assert(a:fill(2):sum() == 8)"));
+  TEST_CHECK(state("assert(a:scale(0.5):max() == 1)"));
+  TEST_CHECK(state("b = FloatArray({1,2,3,4})"));
+  TEST_CHECK(state("assert(b:min() == 1 and b:max() == 4)"));
+  TEST_CHECK(state("a:axpy(2, b)"));
+  TEST_CHECK(state("assert(a[1] == 3 and a[4] == 9)"));
+  TEST_CHECK(state("a:copy({7,8}, 3)"));
+  TEST_CHECK(state("assert(a[2] == 5 and a[3] == 7 and a[4] == 8)"));
+  TEST_CHECK(state("a:copy(b)"));
+  TEST_CHECK(state("t = a:totable() assert(#t == 4 and t[4] == 4)"));
+  TEST_CHECK(state("assert(FloatArray(0):max() == nil)"));
+
+  kaguya::span<float> view = state["a"];
+  TEST_EQUAL(view.size(), 4u);
+  TEST_EQUAL(view[1], 2.0f);
+  view[1] = 10;
+  TEST_CHECK(state("assert(a[2] == 10)"));
+
+  state["span_sum"] = &span_sum;
+  state["span_double"] = &span_double;
+  TEST_CHECK(state("assert(span_sum(b) == 10)"));
+  TEST_CHECK(state("span_double(b) assert(b[4] == 8)"));
+  state["span_front"] = &span_front;
+  TEST_CHECK(state("assert(span_front(b) == 2)"));
+  kaguya::span<const float> const_view = state["b"];
+  TEST_EQUAL(const_view.size(), 4u);
+  state["const_view"] = const_view;
+  TEST_CHECK(state("assert(const_view[4] == 8)"));
+  TEST_CHECK(!state["t"].isType<kaguya::span<float> >());
+  TEST_CHECK(!state["a"].isType<kaguya::span<double> >());
+}
+
+KAGUYA_TEST_FUNCTION_DEF(typed_array_view)(kaguya::State &state) {
+  state["get_shared_buffer"] = &get_shared_buffer;
+  TEST_CHECK(state("v = get_shared_buffer()"));
+  TEST_CHECK(state("assert(#v == 4 and v[1] == 1.5)"));
+  TEST_CHECK(state("v:fill(3)"));
+  TEST_EQUAL(shared_buffer[3], 3.0f);
+
+  std::vector<int> ints(3, 1);
+  kaguya::TypedArray<int>::pushView(state.state(), &ints[0], ints.size());
+  kaguya::LuaRef iv(state.state(), kaguya::StackTop());
+  state["iv"] = iv;
+  TEST_CHECK(state("iv[2] = 5 assert(iv:sum() == 7)"));
+  TEST_EQUAL(ints[1], 5);
+}
+
+std::string last_error_message;
+void ignore_error_fun(int status, const char *message) {
+  KAGUYA_UNUSED(status);
+  last_error_message = message ? message : "";
+}
+
+KAGUYA_TEST_FUNCTION_DEF(typed_array_error)(kaguya::State &state) {
+  state.setErrorHandler(ignore_error_fun);
+  state["FloatArray"] =
+      kaguya::luacfunction(&kaguya::TypedArray<float>::create);
+  state["IntArray"] = kaguya::luacfunction(&kaguya::TypedArray<int>::create);
+  TEST_CHECK(state("a = FloatArray(2) i = IntArray(2)"));
+  TEST_CHECK(!state("a[3] = 1"));
+  TEST_CHECK(last_error_message.find("index out of range") !=
+             std::string::npos);
+  TEST_CHECK(!state("a[1] = 'x'"));
+  TEST_CHECK(!state("a:axpy(1, FloatArray(3))"));
+  TEST_CHECK(!state("a:axpy(1, i)"));
+  TEST_CHECK(!state("FloatArray(-1)"));
+  TEST_CHECK(!state("a.sum(i)"));
+  TEST_CHECK(!state("FloatArray({1, 'x'})"));
+  TEST_CHECK(last_error_message.find("#1") != std::string::npos);
+  TEST_CHECK(last_error_message.find("index 2") != std::string::npos);
+  TEST_CHECK(!state("a:copy({1, 'x'})"));
+  TEST_CHECK(last_error_message.find("#1") != std::string::npos);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(typed_array_integer_sum)(kaguya::State &state) {
+  state["IntArray"] = kaguya::luacfunction(&kaguya::TypedArray<int>::create);
+  TEST_CHECK(state("assert(IntArray({-3, 1, 5}):sum() == 3)"));
+  std::vector<lua_Integer> values(2,
+                                  (std::numeric_limits<lua_Integer>::max)());
+  kaguya::TypedArray<lua_Integer>::pushView(state.state(), &values[0],
+                                            values.size());
+  state["view"] = kaguya::LuaRef(state.state(), kaguya::StackTop());
+  // wraps around like Lua integer addition
+  TEST_CHECK(state("assert(view:sum() == -2)"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(typed_array_alignment)(kaguya::State &state) {
+  lua_State *L = state.state();
+  for (size_t size = 1; size < 4; ++size) {
+    kaguya::span<long double> a =
+        kaguya::TypedArray<long double>::push(L, size);
+    TEST_EQUAL(reinterpret_cast<size_t>(a.data()) %
+                   kaguya::standard::alignment_of<long double>::value,
+               0u);
+    a[size - 1] = 1.5L;
+    lua_pop(L, 1);
+  }
+}
+KAGUYA_TEST_GROUP_END(test_16_typed_array)
@@ -0,0 +1,114 @@
+#include "kaguya/kaguya.hpp"
+#include "test_util.hpp"
+
+KAGUYA_TEST_GROUP_START(test_17_byte_buffer)
+using namespace kaguya_test_util;
+
+size_t bytes_sum(kaguya::span<const unsigned char> bytes) {
+  size_t result = 0;
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    result += bytes[i];
+  }
+  return result;
+}
+
+KAGUYA_TEST_FUNCTION_DEF(byte_buffer_read_write)(kaguya::State &state) {
+  state["ByteBuffer"] = kaguya::luacfunction(&kaguya::ByteBuffer::create);
+  TEST_CHECK(state("b = ByteBuffer()"));
+  TEST_CHECK(state("assert(#b == 0 and b:size() == 0)"));
+  TEST_CHECK(state("b:writeU8(1):writeU16BE(0x0203):writeU16LE(0x0504)"));
+  TEST_CHECK(state("b:writeU32BE(0x06070809):writeI32LE(-2)"));
+  TEST_CHECK(state("assert(#b == 13)"));
+  TEST_CHECK(state("assert(b:tostring():sub(1, 5) == '\\1\\2\\3\\4\\5')"));
+  TEST_CHECK(
+      state("local v, n = b:readU16BE(2) assert(v == 0x0203 and n == 4)"));
+  TEST_CHECK(state("assert(b:readU32LE(6) == 0x09080706)"));
+  TEST_CHECK(state("assert(b:readI32LE(10) == -2 and b:readU8(10) == 0xfe)"));
+  TEST_CHECK(state("assert(b:readI8(13) == -1)"));
+  TEST_CHECK(state("b:writeF64BE(1.5):writeF32LE(-0.25)"));
+  TEST_CHECK(
+      state("assert(b:readF64BE(14) == 1.5 and b:readF32LE(22) == -0.25)"));
+  // write with position overwrites bytes
+  TEST_CHECK(state("b:writeU16BE(0xffff, 2) assert(#b == 25)"));
+  TEST_CHECK(state("assert(b:readI16BE(2) == -1)"));
+
+  TEST_CHECK(state("c = ByteBuffer('ab')"));
+  TEST_CHECK(state("c:append('cd', b:slice(1, 1), ByteBuffer('e'))"));
+  TEST_CHECK(state("assert(c:tostring() == 'abcd\\1e')"));
+  TEST_CHECK(state("c:append(c) assert(c:tostring() == 'abcd\\1eabcd\\1e')"));
+  TEST_CHECK(state("c:clear() assert(#c == 0) c:reserve(100):writeU8(7)"));
+  TEST_CHECK(state("assert(c:readU8() == 7)"));
+
+  lua_State *L = state.state();
+  kaguya::ByteBuffer::push(L, "xyz", 3);
+  kaguya::span<unsigned char> bytes = kaguya::ByteBuffer::get(L, -1);
+  TEST_EQUAL(bytes.size(), 3u);
+  TEST_EQUAL(bytes[1], 'y');
+  kaguya::LuaRef ref(L, kaguya::StackTop());
+  TEST_CHECK(ref.isType<kaguya::span<const unsigned char> >());
+  TEST_CHECK(
+      !state["ByteBuffer"].isType<kaguya::span<const unsigned char> >());
+}
+
+KAGUYA_TEST_FUNCTION_DEF(byte_buffer_slice)(kaguya::State &state) {
+  state["ByteBuffer"] = kaguya::luacfunction(&kaguya::ByteBuffer::create);
+  TEST_CHECK(state("b = ByteBuffer('header') s = b:slice(3, 2)"));
+  TEST_CHECK(state("assert(s:tostring() == 'ad' and #s == 2)"));
+  TEST_CHECK(state("s:writeU8(65, 1) assert(b:tostring() == 'heAder')"));
+  // slice follows the buffer after reallocation
+  TEST_CHECK(state("for i = 1, 1000 do b:writeU8(0) end"));
+  TEST_CHECK(state("assert(s:tostring() == 'Ad')"));
+  TEST_CHECK(state("b:clear() assert(#s == 0)"));
+  TEST_CHECK(state("b = nil collectgarbage() assert(#s == 0)"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(byte_buffer_argument)(kaguya::State &state) {
+  state["ByteBuffer"] = kaguya::luacfunction(&kaguya::ByteBuffer::create);
+  state["ByteArray"] =
+      kaguya::luacfunction(&kaguya::TypedArray<unsigned char>::create);
+  state["bytes_sum"] = &bytes_sum;
+  TEST_CHECK(state("assert(bytes_sum(ByteBuffer('\\1\\2\\3')) == 6)"));
+  TEST_CHECK(state("s = ByteBuffer('\\1\\2\\3'):slice(2)"));
+  TEST_CHECK(state("assert(bytes_sum(s) == 5)"));
+  TEST_CHECK(state("assert(bytes_sum('\\4\\5') == 9)"));
+  TEST_CHECK(state("assert(bytes_sum(ByteArray({1, 1})) == 2)"));
+
+  std::vector<unsigned char> data(2, 3);
+  state["data"] = kaguya::span<const unsigned char>(&data[0], data.size());
+  TEST_CHECK(state("assert(data == '\\3\\3')"));
+#if KAGUYA_USE_STRING_VIEW
+  state["view"] = std::string_view("abc");
+  TEST_CHECK(state("assert(view == 'abc')"));
+  TEST_CHECK(state["view"] == std::string_view("abc"));
+  TEST_CHECK(state("v = ByteBuffer('def')"));
+  TEST_CHECK(state["v"] == std::string_view("def"));
+#endif
+}
+
+std::string last_error_message;
+void ignore_error_fun(int status, const char *message) {
+  KAGUYA_UNUSED(status);
+  last_error_message = message ? message : "";
+}
+
+KAGUYA_TEST_FUNCTION_DEF(byte_buffer_error)(kaguya::State &state) {
+  state.setErrorHandler(ignore_error_fun);
+  state["ByteBuffer"] = kaguya::luacfunction(&kaguya::ByteBuffer::create);
+  state["bytes_sum"] = &bytes_sum;
+  TEST_CHECK(state("b = ByteBuffer('abc')"));
+  TEST_CHECK(!state("b:readU32LE(1)"));
+  TEST_CHECK(last_error_message.find("position out of range") !=
+             std::string::npos);
+  TEST_CHECK(!state("b:readU8(0)"));
+  TEST_CHECK(!state("b:writeU8(1, 5)"));
+  TEST_CHECK(!state("b:slice(2, 5)"));
+  TEST_CHECK(!state("b:slice(1, 2):writeU8(1)"));
+  TEST_CHECK(last_error_message.find("slice is not growable") !=
+             std::string::npos);
+  TEST_CHECK(!state("b:slice(1, 2):append('x')"));
+  TEST_CHECK(!state("b:append({})"));
+  TEST_CHECK(!state("ByteBuffer(-1)"));
+  TEST_CHECK(!state("b.size({})"));
+  TEST_CHECK(!state("bytes_sum({})"));
+}
+KAGUYA_TEST_GROUP_END(test_17_byte_buffer)
@@ -0,0 +1,155 @@
+#include "kaguya/kaguya.hpp"
+#include "kaguya/scheduler.hpp"
+#include "test_util.hpp"
+
+KAGUYA_TEST_GROUP_START(test_18_scheduler)
+using namespace kaguya_test_util;
+
+class ManualAwaitable : public kaguya::Awaitable {
+public:
+  ManualAwaitable(bool *ready, int value) : ready_(ready), value_(value) {}
+  virtual bool ready() { return *ready_; }
+  virtual int push(lua_State *state) {
+    lua_pushinteger(state, value_);
+    return 1;
+  }
+
+private:
+  bool *ready_;
+  int value_;
+};
+bool manual_ready = false;
+int wait_manual(lua_State *L) {
+  int value = static_cast<int>(luaL_checkinteger(L, 1));
+  return kaguya::Scheduler::await(L,
+                                  new ManualAwaitable(&manual_ready, value));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(scheduler_yield_and_sleep)(kaguya::State &state) {
+  kaguya::Scheduler scheduler(state.state());
+  state["task"] = kaguya::NewTable();
+  scheduler.openLibrary(state["task"]);
+  TEST_CHECK(state("log = {}"
+                   "function worker(name, n) for i = 1, n do "
+                   "log[#log + 1] = name .. i task.yield() end end "
+                   "function sleeper() task.sleep(100) "
+                   "log[#log + 1] = 'woke' .. math.floor(task.now()) end"));
+
+  TEST_CHECK(scheduler.spawn(state["worker"], "a", 2));
+  TEST_CHECK(scheduler.spawn(state["worker"], "b", 2));
+  TEST_CHECK(scheduler.spawn(state["sleeper"]));
+  TEST_EQUAL(scheduler.taskCount(), 3u);
+
+  TEST_EQUAL(scheduler.tick(0), 3u);
+  TEST_CHECK(state("assert(table.concat(log, ',') == 'a1,b1')"));
+  double wake = 0;
+  TEST_CHECK(scheduler.nextWakeTime(wake));
+  TEST_EQUAL(wake, 100.0);
+  TEST_EQUAL(scheduler.tick(10), 2u);
+  TEST_EQUAL(scheduler.tick(20), 2u); // workers return
+  TEST_EQUAL(scheduler.taskCount(), 1u);
+  TEST_EQUAL(scheduler.tick(50), 0u);
+  TEST_EQUAL(scheduler.tick(150), 1u);
+  TEST_CHECK(scheduler.empty());
+  TEST_CHECK(
+      state("assert(table.concat(log, ',') == 'a1,b1,a2,b2,woke150')"));
+  TEST_CHECK(!scheduler.nextWakeTime(wake));
+
+  // finished threads are recycled
+  TEST_CHECK(scheduler.spawn(state["worker"], "c", 1));
+  scheduler.tick(200);
+  scheduler.tick(200);
+  TEST_EQUAL(scheduler.threadPool().createdCount(), 3u);
+  TEST_EQUAL(scheduler.threadPool().reusedCount(), 1u);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(scheduler_timer_order)(kaguya::State &state) {
+  kaguya::Scheduler scheduler(state.state());
+  state["task"] = kaguya::NewTable();
+  scheduler.openLibrary(state["task"]);
+  TEST_CHECK(state("order = {}"
+                   "function sleeper(ms) task.sleep(ms) "
+                   "order[#order + 1] = ms end "
+                   "for i = 1000, 1, -1 do task.spawn(sleeper, i) end"));
+  TEST_EQUAL(scheduler.taskCount(), 1000u);
+  scheduler.tick(0);
+  scheduler.tick(500);
+  TEST_EQUAL(scheduler.taskCount(), 500u);
+  scheduler.tick(1000);
+  TEST_CHECK(scheduler.empty());
+  TEST_CHECK(state("for i = 1, 1000 do assert(order[i] == i) end"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(scheduler_event_and_await)(kaguya::State &state) {
+  kaguya::Scheduler scheduler(state.state());
+  state["task"] = kaguya::NewTable();
+  scheduler.openLibrary(state["task"]);
+  state["wait_manual"] = kaguya::luacfunction(&wait_manual);
+  TEST_CHECK(state("count = 0 result = 0 "
+                   "function waiter() task.wait('go') count = count + 1 end "
+                   "function awaiter() result = wait_manual(42) end"));
+  scheduler.spawn(state["waiter"]);
+  scheduler.spawn(state["waiter"]);
+  scheduler.spawn(state["awaiter"]);
+  TEST_EQUAL(scheduler.tick(0), 3u);
+  TEST_EQUAL(scheduler.tick(1), 0u);
+  TEST_EQUAL(scheduler.notify("none"), 0u);
+  TEST_EQUAL(scheduler.notify("go"), 2u);
+  TEST_EQUAL(scheduler.tick(2), 2u);
+  TEST_EQUAL(state["count"], 2);
+  TEST_EQUAL(scheduler.taskCount(), 1u);
+
+  manual_ready = true;
+  TEST_EQUAL(scheduler.tick(3), 1u);
+  TEST_EQUAL(state["result"], 42);
+  TEST_CHECK(scheduler.empty());
+  manual_ready = false;
+}
+
+#if KAGUYA_USE_CPP11
+std::promise<std::string> name_promise;
+int wait_name(lua_State *L) {
+  return kaguya::Scheduler::await(L, name_promise.get_future());
+}
+
+KAGUYA_TEST_FUNCTION_DEF(scheduler_await_future)(kaguya::State &state) {
+  kaguya::Scheduler scheduler(state.state());
+  state["wait_name"] = kaguya::luacfunction(&wait_name);
+  TEST_CHECK(state("function greet(greeting) "
+                   "message = greeting .. ' ' .. wait_name() end"));
+  name_promise = std::promise<std::string>();
+  scheduler.spawn(state["greet"], "hello");
+  TEST_EQUAL(scheduler.tick(0), 1u);
+  TEST_EQUAL(scheduler.tick(1), 0u);
+  name_promise.set_value("kaguya");
+  TEST_EQUAL(scheduler.tick(2), 1u);
+  TEST_EQUAL(state["message"], "hello kaguya");
+  TEST_CHECK(scheduler.empty());
+}
+#endif
+
+std::string last_error_message;
+void ignore_error_fun(int status, const char *message) {
+  KAGUYA_UNUSED(status);
+  last_error_message = message ? message : "";
+}
+
+KAGUYA_TEST_FUNCTION_DEF(scheduler_error)(kaguya::State &state) {
+  state.setErrorHandler(ignore_error_fun);
+  kaguya::Scheduler scheduler(state.state());
+  state["task"] = kaguya::NewTable();
+  scheduler.openLibrary(state["task"]);
+  TEST_CHECK(
+      state("function failing() task.yield() error('task failed') end"));
+  scheduler.spawn(state["failing"]);
+  scheduler.tick(0);
+  scheduler.tick(0);
+  TEST_CHECK(last_error_message.find("task failed") != std::string::npos);
+  TEST_CHECK(scheduler.empty());
+
+  // library functions can not be used outside of a task
+  TEST_CHECK(!state("task.sleep(1)"));
+  TEST_CHECK(last_error_message.find("scheduled task") != std::string::npos);
+  TEST_CHECK(!state("task.yield()"));
+}
+KAGUYA_TEST_GROUP_END(test_18_scheduler)
@@ -0,0 +1,247 @@
+#include "kaguya/kaguya.hpp"
+#include "test_util.hpp"
+
+#if KAGUYA_USE_CPP20_COROUTINE
+#include <map>
+
+KAGUYA_TEST_GROUP_START(test_19_cxx20_coroutine)
+using namespace kaguya_test_util;
+
+// single threaded event loop with virtual time
+class EventLoop {
+public:
+  struct Sleep {
+    EventLoop *loop;
+    int ticks;
+    bool await_ready() const { return ticks <= 0; }
+    void await_suspend(std::coroutine_handle<> handle) {
+      loop->timers_.insert(std::make_pair(loop->now_ + ticks, handle));
+    }
+    void await_resume() const {}
+  };
+  Sleep sleep(int ticks) {
+    Sleep s = {this, ticks};
+    return s;
+  }
+  int run() {
+    int resumed = 0;
+    while (!timers_.empty()) {
+      std::multimap<int, std::coroutine_handle<> >::iterator it =
+          timers_.begin();
+      now_ = it->first;
+      std::coroutine_handle<> handle = it->second;
+      timers_.erase(it);
+      handle.resume();
+      ++resumed;
+    }
+    return resumed;
+  }
+  int now() const { return now_; }
+
+private:
+  std::multimap<int, std::coroutine_handle<> > timers_;
+  int now_ = 0;
+};
+EventLoop loop;
+
+kaguya::Task<int> async_add(int a, int b) {
+  co_await loop.sleep(10);
+  co_return a + b;
+}
+kaguya::Task<int> chained_add(int a, int b) {
+  int v = co_await async_add(a, b);
+  co_await loop.sleep(5);
+  co_return v * 10;
+}
+kaguya::Task<int> immediate(int v) { co_return v * 2; }
+kaguya::Task<void> async_fail() {
+  co_await loop.sleep(1);
+  throw std::runtime_error("io failed");
+}
+
+KAGUYA_TEST_FUNCTION_DEF(task_from_lua_coroutine)(kaguya::State &state) {
+  state["async_add"] = kaguya::function(&async_add);
+  state["chained_add"] = kaguya::function(&chained_add);
+  TEST_CHECK(state("result = nil "
+                   "co = coroutine.create(function(a) "
+                   "local x = async_add(a, 1) "
+                   "result = chained_add(x, 2) end) "
+                   "assert(coroutine.resume(co, 5)) "
+                   "assert(coroutine.status(co) == 'suspended')"));
+  TEST_EQUAL(loop.run(), 3);
+  TEST_EQUAL(state["result"], 80);
+  TEST_CHECK(state("assert(coroutine.status(co) == 'dead')"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(task_finished_without_suspension)(
+    kaguya::State &state) {
+  state["immediate"] = kaguya::function(&immediate);
+  // can be called from main thread if the task does not suspend
+  TEST_CHECK(state("assert(immediate(21) == 42)"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(resume_async)(kaguya::State &state) {
+  state["async_add"] = kaguya::function(&async_add);
+  TEST_CHECK(state("function job(a) "
+                   "local x = async_add(a, 1) "
+                   "coroutine.yield(x) "
+                   "return x + async_add(x, 2) end"));
+  kaguya::LuaThread thread = state.newThread(state["job"]);
+  std::vector<int> results;
+  auto driver = [&]() -> kaguya::Task<void> {
+    results.push_back(co_await thread.resumeAsync<int>(5));
+    results.push_back(co_await thread.resumeAsync<int>());
+  };
+  kaguya::Task<void> task = driver();
+  task.resume();
+  TEST_CHECK(!task.done());
+  TEST_EQUAL(loop.run(), 2);
+  TEST_CHECK(task.done());
+  task.get();
+  TEST_EQUAL(results.size(), 2u);
+  TEST_EQUAL(results[0], 6);
+  TEST_EQUAL(results[1], 14);
+  TEST_CHECK(thread.isThreadDead());
+
+  // plain yield does not suspend awaiting coroutine
+  TEST_CHECK(state("function gen() coroutine.yield(1) return 2 end"));
+  kaguya::LuaThread gen = state.newThread(state["gen"]);
+  auto sum = [&]() -> kaguya::Task<int> {
+    int a = co_await gen.resumeAsync<int>();
+    int b = co_await gen.resumeAsync<int>();
+    co_return a + b;
+  };
+  kaguya::Task<int> sum_task = sum();
+  sum_task.resume();
+  TEST_CHECK(sum_task.done());
+  TEST_EQUAL(sum_task.get(), 3);
+}
+
+std::string last_error_message;
+void ignore_error_fun(int status, const char *message) {
+  KAGUYA_UNUSED(status);
+  last_error_message = message ? message : "";
+}
+
+KAGUYA_TEST_FUNCTION_DEF(task_error)(kaguya::State &state) {
+  state.setErrorHandler(ignore_error_fun);
+  state["async_add"] = kaguya::function(&async_add);
+  state["async_fail"] = kaguya::function(&async_fail);
+
+  // suspending task needs a coroutine
+  TEST_CHECK(!state("async_add(1, 2)"));
+  TEST_CHECK(last_error_message.find("outside a coroutine") !=
+             std::string::npos);
+  loop.run();
+
+#if LUA_VERSION_NUM >= 502
+  TEST_CHECK(state("function failing() async_fail() end "
+                   "function guarded() "
+                   "local ok, msg = pcall(async_fail) "
+                   "return not ok and msg:find('io failed') ~= nil end"));
+  kaguya::LuaThread guarded = state.newThread(state["guarded"]);
+  bool caught = false;
+  auto guarded_driver = [&]() -> kaguya::Task<void> {
+    caught = co_await guarded.resumeAsync<bool>();
+  };
+  kaguya::Task<void> guarded_task = guarded_driver();
+  guarded_task.resume();
+  loop.run();
+  TEST_CHECK(guarded_task.done());
+  TEST_CHECK(caught);
+#else
+  TEST_CHECK(state("function failing() local v, msg = async_fail() "
+                   "error(msg) end"));
+#endif
+
+  // error of resumed thread is reported to error handler like resume
+  last_error_message = "";
+  kaguya::LuaThread failing = state.newThread(state["failing"]);
+  auto driver = [&]() -> kaguya::Task<void> {
+    co_await failing.resumeAsync<void>();
+  };
+  kaguya::Task<void> task = driver();
+  task.resume();
+  TEST_CHECK(!task.done());
+  loop.run();
+  TEST_CHECK(task.done());
+  TEST_CHECK(last_error_message.find("io failed") != std::string::npos);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(task_across_c_call_boundary)(kaguya::State &state) {
+  state["async_add"] = kaguya::function(&async_add);
+  // Lua 5.1 can not yield across pcall. The failed yield must not leave the
+  // task registered to resume the thread later.
+  TEST_CHECK(state("pcall_done = nil "
+                   "co = coroutine.create(function() "
+                   "local ok, v = pcall(async_add, 1, 2) "
+                   "pcall_result = ok and v or 'failed' "
+                   "coroutine.yield() "
+                   "pcall_done = true end) "
+                   "assert(coroutine.resume(co))"));
+  loop.run();
+  TEST_CHECK(state("assert(coroutine.status(co) == 'suspended')"));
+  TEST_CHECK(state("assert(pcall_done == nil)"));
+#if LUA_VERSION_NUM >= 502
+  TEST_EQUAL(state["pcall_result"], 3);
+#else
+  TEST_EQUAL(state["pcall_result"], "failed");
+#endif
+
+  // no version can yield from a table.sort comparator
+  TEST_CHECK(state("sort_done = nil "
+                   "sorter = coroutine.create(function() "
+                   "local ok = pcall(table.sort, {1, 2}, function(a, b) "
+                   "return async_add(a, b) > 0 end) "
+                   "sort_failed = not ok "
+                   "coroutine.yield() "
+                   "sort_done = true end) "
+                   "assert(coroutine.resume(sorter))"));
+  loop.run();
+  TEST_EQUAL(state["sort_failed"], true);
+  TEST_CHECK(state("assert(coroutine.status(sorter) == 'suspended')"));
+  TEST_CHECK(state("assert(sort_done == nil)"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(task_in_scheduler)(kaguya::State &state) {
+  kaguya::Scheduler scheduler(state.state());
+  state["async_add"] = kaguya::function(&async_add);
+  state["async_fail"] = kaguya::function(&async_fail);
+  TEST_CHECK(state("function job() "
+                   "result = async_add(1, 2) "
+                   "result = result + async_add(result, 4) end"));
+  scheduler.spawn(state["job"]);
+  TEST_EQUAL(scheduler.tick(0), 1u);
+  // parked until the task finishes
+  TEST_EQUAL(scheduler.tick(1), 0u);
+  TEST_CHECK(state("assert(result == nil)"));
+  TEST_EQUAL(loop.run(), 1);
+  TEST_EQUAL(scheduler.tick(2), 1u);
+  TEST_EQUAL(state["result"], 3);
+  TEST_EQUAL(loop.run(), 1);
+  TEST_EQUAL(scheduler.tick(3), 1u);
+  TEST_EQUAL(state["result"], 10);
+  TEST_CHECK(scheduler.empty());
+
+#if LUA_VERSION_NUM >= 502
+  TEST_CHECK(state("function failing() "
+                   "local ok, msg = pcall(async_fail) "
+                   "failed = not ok and msg:find('io failed') ~= nil end"));
+  scheduler.spawn(state["failing"]);
+  scheduler.tick(4);
+  loop.run();
+  scheduler.tick(5);
+  TEST_CHECK(scheduler.empty());
+  TEST_EQUAL(state["failed"], true);
+#endif
+
+  // task dropped while waiting
+  scheduler.spawn(state["job"]);
+  scheduler.tick(6);
+  scheduler.clear();
+  TEST_EQUAL(loop.run(), 1);
+  TEST_CHECK(scheduler.empty());
+}
+
+KAGUYA_TEST_GROUP_END(test_19_cxx20_coroutine)
+#endif
@@ -0,0 +1,123 @@
+#include "kaguya/kaguya.hpp"
+#include "kaguya/worker_pool.hpp"
+#include "test_util.hpp"
+
+#if KAGUYA_USE_CPP11
+
+KAGUYA_TEST_GROUP_START(test_21_worker_pool)
+using namespace kaguya_test_util;
+
+std::promise<void> release_promise;
+std::shared_future<void> released;
+void block_worker() {
+  released.wait_for(std::chrono::seconds(10));
+}
+
+void setup_worker(kaguya::State &state) {
+  state["block"] = kaguya::function(&block_worker);
+  state("count = 0 "
+        "function add(a, b) return a + b end "
+        "function increment(n) count = count + n return count end "
+        "function concat(a, b) return a .. b end "
+        "function fail() error('job failed') end");
+}
+
+KAGUYA_TEST_FUNCTION_DEF(worker_pool_submit)(kaguya::State &) {
+  kaguya::WorkerPool pool(4, &setup_worker);
+  TEST_EQUAL(pool.size(), 4u);
+  std::vector<std::future<int> > results;
+  for (int i = 0; i < 100; ++i) {
+    results.push_back(pool.submit<int>("add", i, 1));
+  }
+  std::future<std::string> text =
+      pool.submit<std::string>("concat", "kaguya", std::string("!"));
+  std::future<void> nothing = pool.submit("add", 1, 2);
+  for (int i = 0; i < 100; ++i) {
+    TEST_EQUAL(results[i].get(), i + 1);
+  }
+  TEST_EQUAL(text.get(), "kaguya!");
+  nothing.get();
+
+  size_t executed = 0;
+  for (size_t i = 0; i < pool.size(); ++i) {
+    kaguya::WorkerStats stats = pool.stats(i);
+    executed += stats.executed;
+    TEST_CHECK(stats.utilization >= 0 && stats.utilization <= 1);
+  }
+  TEST_EQUAL(executed, 102u);
+  TEST_EQUAL(pool.queueDepth(), 0u);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(worker_pool_affinity)(kaguya::State &) {
+  kaguya::WorkerPool pool(3, &setup_worker);
+  std::future<int> last;
+  for (int i = 0; i < 50; ++i) {
+    last = pool.submitTo<int>(1, "increment", 2);
+  }
+  TEST_EQUAL(last.get(), 100);
+  TEST_EQUAL(pool.submitTo<int>(1, "increment", 0).get(), 100);
+  TEST_EQUAL(pool.submitTo<int>(0, "increment", 0).get(), 0);
+  TEST_EQUAL(pool.stats(1).stolen, 0u);
+  TEST_EQUAL(pool.stats(1).executed, 51u);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(worker_pool_steal)(kaguya::State &) {
+  release_promise = std::promise<void>();
+  released = release_promise.get_future().share();
+
+  kaguya::WorkerPool pool(2, &setup_worker);
+  std::future<void> blocked = pool.submitTo(0, "block");
+  // jobs are queued round robin, so half of them wait behind worker 0
+  std::vector<std::future<int> > results;
+  for (int i = 0; i < 10; ++i) {
+    results.push_back(pool.submit<int>("add", i, i));
+  }
+  for (int i = 0; i < 10; ++i) {
+    TEST_CHECK(results[i].wait_for(std::chrono::seconds(10)) ==
+               std::future_status::ready);
+    TEST_EQUAL(results[i].get(), i * 2);
+  }
+  TEST_EQUAL(pool.stealCount(), 5u);
+  TEST_EQUAL(pool.stats(1).stolen, 5u);
+  TEST_EQUAL(pool.stats(0).stolen, 0u);
+  release_promise.set_value();
+  blocked.get();
+}
+
+KAGUYA_TEST_FUNCTION_DEF(worker_pool_error)(kaguya::State &) {
+  kaguya::WorkerPool pool(2, &setup_worker);
+  std::future<void> failed = pool.submit("fail");
+  std::future<int> missing = pool.submit<int>("missing");
+  std::future<int> mismatch = pool.submit<int>("concat", "a", "b");
+  try {
+    failed.get();
+    TEST_CHECK(false);
+  } catch (const kaguya::LuaRuntimeError &e) {
+    TEST_CHECK(std::string(e.what()).find("job failed") != std::string::npos);
+  }
+  try {
+    missing.get();
+    TEST_CHECK(false);
+  } catch (const std::runtime_error &e) {
+    TEST_CHECK(std::string(e.what()).find("missing") != std::string::npos);
+  }
+  bool mismatch_thrown = false;
+  try {
+    mismatch.get();
+  } catch (const std::exception &) {
+    mismatch_thrown = true;
+  }
+  TEST_CHECK(mismatch_thrown);
+  // workers keep running after errors
+  TEST_EQUAL(pool.submit<int>("add", 1, 2).get(), 3);
+  bool out_of_range_thrown = false;
+  try {
+    pool.submitTo<int>(5, "add", 1, 2);
+  } catch (const std::out_of_range &) {
+    out_of_range_thrown = true;
+  }
+  TEST_CHECK(out_of_range_thrown);
+}
+
+KAGUYA_TEST_GROUP_END(test_21_worker_pool)
+#endif
@@ -0,0 +1,216 @@
+#include "kaguya/kaguya.hpp"
+#if KAGUYA_USE_CPP11
+#include "kaguya/worker_pool.hpp"
+#endif
+#include "test_util.hpp"
+
+KAGUYA_TEST_GROUP_START(test_22_serializer)
+using namespace kaguya_test_util;
+
+std::string last_error_message;
+void ignore_error_fun(int status, const char *message) {
+  KAGUYA_UNUSED(status);
+  last_error_message = message ? message : "";
+}
+
+void set_pack_functions(kaguya::State &state) {
+  state["pack"] = kaguya::luacfunction(&kaguya::Serializer::pack);
+  state["unpack"] = kaguya::luacfunction(&kaguya::Serializer::unpack);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(serializer_round_trip)(kaguya::State &state) {
+  set_pack_functions(state);
+  TEST_CHECK(state("function same(v) return unpack(pack(v)) == v end"));
+  TEST_CHECK(state("assert(unpack(pack(nil)) == nil)"));
+  TEST_CHECK(state("assert(same(true) and same(false))"));
+  TEST_CHECK(state("for _, v in ipairs({0, 1, 127, 128, 300, -1, -128, "
+                   "1.5, -0.25, 1e300, math.huge, -math.huge}) do "
+                   "assert(same(v), v) end"));
+  TEST_CHECK(state("assert(same(''))"));
+  TEST_CHECK(state("assert(same('kaguya'))"));
+  TEST_CHECK(state("assert(same('a\\0b'))"));
+  TEST_CHECK(state("assert(same(string.rep('x', 1000)))"));
+  TEST_CHECK(state("local nan = unpack(pack(0/0)) assert(nan ~= nan)"));
+#if LUA_VERSION_NUM >= 503
+  TEST_CHECK(state("for _, v in ipairs({math.maxinteger, math.mininteger, "
+                   "1.0, 2^53}) do "
+                   "local r = unpack(pack(v)) "
+                   "assert(r == v and math.type(r) == math.type(v)) end"));
+#endif
+  TEST_CHECK(state("local t = unpack(pack({1, 2, 3, nil, 5, "
+                   "name = 'kaguya', [10] = 'ten', [true] = false, "
+                   "nested = {x = {y = {z = 'deep'}}}})) "
+                   "assert(t[1] == 1 and t[2] == 2 and t[3] == 3) "
+                   "assert(t[4] == nil and t[5] == 5 and t[10] == 'ten') "
+                   "assert(t.name == 'kaguya' and t[true] == false) "
+                   "assert(t.nested.x.y.z == 'deep')"));
+  TEST_CHECK(state("local n = 0 "
+                   "for k, v in pairs(unpack(pack({a = 1, b = 2, 3}))) do "
+                   "n = n + 1 end assert(n == 3)"));
+  // small values are compact
+  TEST_CHECK(state("assert(#pack(5) == 3 and #pack(true) == 3)"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(serializer_shared_tables)(kaguya::State &state) {
+  set_pack_functions(state);
+  TEST_CHECK(state("local shared = {1} "
+                   "local t = {a = shared, b = shared, list = {shared}} "
+                   "t.self = t "
+                   "local r = unpack(pack(t)) "
+                   "assert(r ~= t and r.self == r) "
+                   "assert(r.a == r.b and r.a == r.list[1] and r.a[1] == 1)"));
+  // repeated keys are written once
+  TEST_CHECK(state("local records, single = {}, pack({{name = 1}}) "
+                   "for i = 1, 100 do records[i] = {name = i} end "
+                   "local data = pack(records) "
+                   "assert(#data < #single * 100 / 2) "
+                   "local r = unpack(data) "
+                   "assert(#r == 100 and r[100].name == 100)"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(serializer_transfer)(kaguya::State &state) {
+  kaguya::State other;
+  TEST_CHECK(state("data = {values = {1, 2, 3}, name = 'from', flag = true}"));
+  std::string bytes = kaguya::serialize(state["data"]);
+  TEST_CHECK(!bytes.empty());
+  other["data"] = kaguya::deserialize(other.state(), bytes);
+  TEST_CHECK(other("assert(data.name == 'from' and data.flag) "
+                   "assert(#data.values == 3 and data.values[3] == 3)"));
+
+  kaguya::SerializedValue value = state["data"];
+  TEST_EQUAL(value.data(), bytes);
+  other["copy"] = value;
+  TEST_CHECK(other("assert(copy ~= data and copy.values[2] == 2)"));
+  TEST_CHECK(value.get(other.state())["name"] == "from");
+  other["empty"] = kaguya::SerializedValue();
+  TEST_CHECK(other("assert(empty == nil)"));
+
+  lua_State *from = state.state();
+  lua_State *to = other.state();
+  lua_pushstring(from, "moved");
+  TEST_CHECK(kaguya::Serializer::transfer(from, -1, to));
+  TEST_EQUAL(std::string(lua_tostring(to, -1)), "moved");
+  lua_pop(from, 1);
+  lua_pop(to, 1);
+}
+
+struct Point {
+  Point(double x, double y) : x(x), y(y) {}
+  double x;
+  double y;
+};
+struct Opaque {};
+std::vector<double> point_serialize(const Point &p) {
+  std::vector<double> v;
+  v.push_back(p.x);
+  v.push_back(p.y);
+  return v;
+}
+Point point_deserialize(const std::vector<double> &v) {
+  return Point(v.at(0), v.at(1));
+}
+void register_point(kaguya::State &state) {
+  state["Point"].setClass(
+      kaguya::UserdataMetatable<Point>()
+          .setConstructors<Point(double, double)>()
+          .addProperty("x", &Point::x)
+          .addProperty("y", &Point::y)
+          .addStaticFunction("__serialize", &point_serialize)
+          .addStaticFunction("__deserialize", &point_deserialize));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(serializer_userdata)(kaguya::State &state) {
+  register_point(state);
+  set_pack_functions(state);
+  TEST_CHECK(state("p = Point.new(1.5, -2) "
+                   "local r = unpack(pack({p, p, other = Point.new(3, 4)})) "
+                   "assert(r[1] ~= p and r[1] == r[2]) "
+                   "assert(r[1].x == 1.5 and r[1].y == -2) "
+                   "assert(r.other.x == 3 and r.other.y == 4)"));
+
+  kaguya::State other;
+  register_point(other);
+  kaguya::SerializedValue value = state["p"];
+  other["p"] = value;
+  TEST_CHECK(other("assert(p.x == 1.5 and p.y == -2)"));
+
+  // metatable of __name must be registered in destination
+  kaguya::State unregistered;
+  unregistered.setErrorHandler(ignore_error_fun);
+  unregistered["p"] = value;
+  TEST_CHECK(last_error_message.find("not registered") != std::string::npos);
+  TEST_CHECK(unregistered("assert(p == nil)"));
+
+  // userdata without hooks is not serializable
+  state["Opaque"].setClass(
+      kaguya::UserdataMetatable<Opaque>().setConstructors<Opaque()>());
+  TEST_CHECK(state("local ok, msg = pcall(pack, Opaque.new()) "
+                   "assert(not ok and msg:find('not serializable'))"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(serializer_error)(kaguya::State &state) {
+  set_pack_functions(state);
+  TEST_CHECK(state("for _, v in ipairs({print, coroutine.create(print), "
+                   "{f = print}}) do "
+                   "local ok, msg = pcall(pack, v) "
+                   "assert(not ok and msg:find('not serializable')) end"));
+  TEST_CHECK(state("local deep = {} local t = deep "
+                   "for i = 1, 1000 do t.next = {} t = t.next end "
+                   "local ok, msg = pcall(pack, deep) "
+                   "assert(not ok and msg:find('too deep'))"));
+  TEST_CHECK(state("local data = pack({1, 2, 'three', {x = 4}}) "
+                   "for i = 0, #data - 1 do "
+                   "assert(not pcall(unpack, data:sub(1, i))) end "
+                   "assert(not pcall(unpack, data .. 'x'))"));
+  TEST_CHECK(state("assert(not pcall(unpack, 'not serialized'))"));
+
+  state.setErrorHandler(ignore_error_fun);
+  last_error_message = "";
+  std::string out = "keep";
+  TEST_CHECK(state("f = print"));
+  kaguya::LuaRef f = state["f"];
+  f.push();
+  TEST_CHECK(!kaguya::Serializer::encode(state.state(), -1, out));
+  lua_pop(state.state(), 1);
+  TEST_EQUAL(out, "keep");
+  TEST_CHECK(last_error_message.find("not serializable") != std::string::npos);
+  TEST_CHECK(kaguya::serialize(f).empty());
+
+  last_error_message = "";
+  int top = lua_gettop(state.state());
+  TEST_CHECK(!kaguya::Serializer::decode(state.state(), "K", 1));
+  TEST_CHECK(lua_isnil(state.state(), -1));
+  lua_pop(state.state(), 1);
+  TEST_EQUAL(top, lua_gettop(state.state()));
+  TEST_CHECK(last_error_message.find("not serialized") != std::string::npos);
+
+  bool thrown = false;
+  try {
+    kaguya::SerializedValue v = state["f"];
+  } catch (const kaguya::LuaTypeMismatch &e) {
+    thrown = std::string(e.what()).find("not serializable") !=
+             std::string::npos;
+  }
+  TEST_CHECK(thrown);
+}
+
+#if KAGUYA_USE_CPP11
+void setup_worker(kaguya::State &state) {
+  state("function scale(t, k) "
+        "local r = {} for i, v in ipairs(t.values) do r[i] = v * k end "
+        "return {values = r, name = t.name} end");
+}
+
+KAGUYA_TEST_FUNCTION_DEF(serializer_worker_message)(kaguya::State &state) {
+  kaguya::WorkerPool pool(2, &setup_worker);
+  TEST_CHECK(state("job = {values = {1, 2, 3}, name = 'job'}"));
+  kaguya::SerializedValue job = state["job"];
+  std::future<kaguya::SerializedValue> result =
+      pool.submit<kaguya::SerializedValue>("scale", job, 10);
+  state["result"] = result.get();
+  TEST_CHECK(state("assert(result.name == 'job' and #result.values == 3) "
+                   "assert(result.values[1] == 10 and result.values[3] == 30)"));
+}
+#endif
+
+KAGUYA_TEST_GROUP_END(test_22_serializer)
@@ -0,0 +1,193 @@
+#include "kaguya/kaguya.hpp"
+#include "kaguya/channel.hpp"
+#include "test_util.hpp"
+
+#if KAGUYA_USE_CPP11
+
+KAGUYA_TEST_GROUP_START(test_23_channel)
+using namespace kaguya_test_util;
+
+void register_channel(kaguya::State &state) {
+  state["Channel"].setClass(kaguya::Channel::metatable());
+}
+
+KAGUYA_TEST_FUNCTION_DEF(channel_lua_api)(kaguya::State &state) {
+  register_channel(state);
+  TEST_CHECK(state("ch = Channel.new(3) "
+                   "assert(ch:capacity() == 4 and ch:size() == 0) "
+                   "assert(Channel.new():capacity() == 1024)"));
+  // capacity out of range is an error, not an endless loop
+  TEST_CHECK(state("assert(not pcall(Channel.new, 0)) "
+                   "assert(not pcall(Channel.new, -1))"));
+  TEST_CHECK(state("local v, ok = ch:try_recv() assert(v == nil and not ok)"));
+  TEST_CHECK(state("assert(ch:send({1, 2, name = 'x'}) and ch:try_send(nil)) "
+                   "assert(ch:try_send('a') and ch:try_send(4)) "
+                   "assert(not ch:try_send(5) and ch:size() == 4)"));
+  TEST_CHECK(state("local t, ok = ch:recv() "
+                   "assert(ok and t[2] == 2 and t.name == 'x') "
+                   "local n, ok = ch:try_recv() assert(n == nil and ok)"));
+  // queued values are received after close
+  TEST_CHECK(state("ch:close() "
+                   "assert(ch:closed() and not ch:try_send(1)) "
+                   "assert(not ch:send(1)) "
+                   "assert(ch:recv() == 'a' and ch:try_recv() == 4) "
+                   "local v, ok = ch:recv() assert(v == nil and not ok)"));
+
+  TEST_CHECK(state("local ok, msg = pcall(ch.send, ch, print) "
+                   "assert(not ok and msg:find('not serializable'))"));
+  TEST_CHECK(state("local ok, msg = pcall(ch.recv, {}) "
+                   "assert(not ok and msg:find('Channel expected'))"));
+
+  kaguya::Channel channel = state["ch"];
+  TEST_CHECK(channel.closed());
+  TEST_EQUAL(channel.capacity(), 4u);
+}
+
+KAGUYA_TEST_FUNCTION_DEF(channel_between_states)(kaguya::State &) {
+  kaguya::Channel requests(8);
+  // replies are read after all requests are sent
+  kaguya::Channel replies(128);
+  std::thread worker([requests, replies]() {
+    kaguya::State state;
+    register_channel(state);
+    state["requests"] = requests;
+    state["replies"] = replies;
+    state("while true do "
+          "local t, ok = requests:recv() "
+          "if not ok then break end "
+          "replies:send({id = t.id, value = t.value * 2}) end "
+          "replies:close()");
+  });
+
+  kaguya::State state;
+  register_channel(state);
+  state["requests"] = requests;
+  state["replies"] = replies;
+  TEST_CHECK(state("for i = 1, 100 do "
+                   "requests:send({id = i, value = i}) end "
+                   "requests:close() "
+                   "local count, sum = 0, 0 "
+                   "while true do "
+                   "local t, ok = replies:recv() "
+                   "if not ok then break end "
+                   "count = count + 1 sum = sum + t.value end "
+                   "assert(count == 100 and sum == 10100)"));
+  worker.join();
+}
+
+KAGUYA_TEST_FUNCTION_DEF(channel_scheduler)(kaguya::State &state) {
+  register_channel(state);
+  kaguya::Scheduler scheduler(state.state());
+  kaguya::Channel channel(2);
+  state["ch"] = channel;
+  TEST_CHECK(state("received = {} "
+                   "function consumer() "
+                   "while true do "
+                   "local v, ok = ch:recv() "
+                   "if not ok then break end "
+                   "received[#received + 1] = v end end "
+                   "function producer() "
+                   "for i = 1, 3 do ch:send(i) end sent = true end"));
+
+  scheduler.spawn(state["consumer"]);
+  TEST_EQUAL(scheduler.tick(0), 1u);
+  TEST_EQUAL(scheduler.tick(1), 0u);
+  TEST_CHECK(state("greeting = 'hello'"));
+  kaguya::SerializedValue value = state["greeting"];
+  TEST_CHECK(channel.trySend(value));
+  TEST_EQUAL(scheduler.tick(2), 1u);
+  TEST_EQUAL(state["received"][1], "hello");
+
+  // producer parks when full, consumer is parked on empty
+  scheduler.clear();
+  TEST_CHECK(scheduler.empty());
+  scheduler.spawn(state["producer"]);
+  scheduler.tick(3);
+  TEST_CHECK(state("assert(not sent and ch:size() == 2)"));
+  scheduler.spawn(state["consumer"]);
+  for (int i = 0; i < 10 && !(state["sent"] == true); ++i) {
+    scheduler.tick(4 + i);
+  }
+  TEST_CHECK(state["sent"] == true);
+  channel.close();
+  scheduler.tick(20);
+  TEST_CHECK(scheduler.empty());
+  TEST_CHECK(state("assert(#received == 4 and received[4] == 3)"));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(channel_mpmc)(kaguya::State &) {
+  kaguya::BasicChannel<int> channel(16);
+  TEST_EQUAL(channel.capacity(), 16u);
+  const int producers = 4;
+  const int consumers = 4;
+  const int count = 10000;
+  std::atomic<long long> sum(0);
+  std::atomic<int> received(0);
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.push_back(std::thread([&channel]() {
+      for (int i = 1; i <= count; ++i) {
+        channel.send(i);
+      }
+    }));
+  }
+  for (int c = 0; c < consumers; ++c) {
+    threads.push_back(std::thread([&channel, &sum, &received]() {
+      int value;
+      while (channel.recv(value)) {
+        sum += value;
+        ++received;
+      }
+    }));
+  }
+  for (int p = 0; p < producers; ++p) {
+    threads[p].join();
+  }
+  channel.close();
+  for (size_t i = producers; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  TEST_EQUAL(received.load(), producers * count);
+  TEST_EQUAL(sum.load(), 1LL * producers * count * (count + 1) / 2);
+
+  kaguya::BasicChannel<int> copy = channel;
+  TEST_CHECK(copy == channel);
+  TEST_CHECK(copy != kaguya::BasicChannel<int>(2));
+  int value = 0;
+  TEST_CHECK(!copy.trySend(1) && !copy.tryRecv(value));
+}
+
+KAGUYA_TEST_FUNCTION_DEF(channel_close_race)(kaguya::State &) {
+  // every successful send is received, even if it races with close
+  for (int round = 0; round < 50; ++round) {
+    kaguya::BasicChannel<int> channel(4);
+    std::atomic<int> sent(0);
+    std::atomic<int> received(0);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < 2; ++p) {
+      threads.push_back(std::thread([&channel, &sent]() {
+        while (channel.send(1)) {
+          ++sent;
+        }
+      }));
+    }
+    for (int c = 0; c < 2; ++c) {
+      threads.push_back(std::thread([&channel, &received]() {
+        int value;
+        while (channel.recv(value)) {
+          ++received;
+        }
+      }));
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+    channel.close();
+    for (size_t i = 0; i < threads.size(); ++i) {
+      threads[i].join();
+    }
+    TEST_CHECK(channel.drained());
+    TEST_EQUAL(received.load(), sent.load());
+  }
+}
+
+KAGUYA_TEST_GROUP_END(test_23_channel)
+#endif